@@ -1406,6 +1406,16 @@ void dsp_recons_align(dsp_stream_p stream, dsp_stream_p matrix);
 */
 DLL_EXPORT dsp_stream_p* dsp_file_read_fits(const char* filename, int *channels, int stretch);
 
+/**
+* \brief Read a FITS file already loaded into memory and fill a dsp_stream_p with its content
+* \param buf the memory buffer containing the FITS file, not modified nor freed.
+* \param len the size in bytes of the FITS file.
+* \param channels will be filled with the number of components
+* \param stretch 1 if the buffer intensities have to be stretched
+* \return The new dsp_stream_p structure pointer
+*/
+DLL_EXPORT dsp_stream_p* dsp_file_read_fits_memory(void *buf, size_t len, int *channels, int stretch);
+
 /**
 * \brief Write the dsp_stream_p into a FITS file,
 * \param filename the file name.
@@ -1423,6 +1433,16 @@ DLL_EXPORT void dsp_file_write_fits(const char* filename, int bpp, dsp_stream_p
 */
 DLL_EXPORT void dsp_file_write_fits_composite(const char* filename, int components, int bpp, dsp_stream_p* stream);
 
+/**
+* \brief Write the components dsp_stream_p array into a FITS file in memory,
+* \param components the number of streams in the array to be used as components 1 or 3.
+* \param bpp the bit depth of the output FITS file [8,16,32,64,-32,-64].
+* \param stream the input stream to be saved
+* \param len will be filled with the size in bytes of the FITS file.
+* \return The memory buffer containing the FITS file, to be freed by the caller, NULL on failure
+*/
+DLL_EXPORT void* dsp_file_write_fits_composite_memory(int components, int bpp, dsp_stream_p* stream, size_t *len);
+
 /**
 * \brief Read a JPEG file and fill a array of dsp_stream_p with its content,
 * each color channel has its own stream in this array and an additional grayscale at end will be added
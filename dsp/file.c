@@ -24,26 +24,18 @@
 #include <jpeglib.h>
 #include <png.h>
 
-dsp_stream_p* dsp_file_read_fits(const char* filename, int *channels, int stretch)
+static dsp_stream_p* dsp_file_read_fits_fptr(fitsfile *fptr, int *channels, int stretch)
 {
-    fitsfile *fptr;
     int bpp = 16;
     int status = 0;
     char value[150];
     char comment[150];
     char error_status[64];
 
-    fits_open_file(&fptr, filename, READONLY, &status);
-
-    if (status)
-    {
-        goto fail;
-    }
-
     fits_movabs_hdu(fptr, 1, IMAGE_HDU, &status);
     if(status)
     {
-        goto fail;
+        goto fail_fptr;
     }
 
     int dims;
@@ -51,7 +43,7 @@ dsp_stream_p* dsp_file_read_fits(const char* filename, int *channels, int stretc
     fits_get_img_param(fptr, 3, &bpp, &dims, naxes, &status);
     if(status)
     {
-        goto fail;
+        goto fail_fptr;
     }
     bpp = fmax(16, bpp);
     int dim, nelements = 1;
@@ -112,7 +104,7 @@ dsp_stream_p* dsp_file_read_fits(const char* filename, int *channels, int stretc
     }
     free(array);
     if(status||anynul)
-        goto fail;
+        goto fail_fptr;
     int red = -1;
     ffgkey(fptr, "XBAYROFF", value, comment, &status);
     if (!status)
@@ -153,6 +145,14 @@ dsp_stream_p* dsp_file_read_fits(const char* filename, int *channels, int stretc
         }
         return stream;
     }
+    return NULL;
+fail_fptr:
+    if(status) {
+        fits_get_errstatus(status, error_status);
+        perr("FITS Error: %s\n", error_status);
+    }
+    status = 0;
+    fits_close_file(fptr, &status);
 fail:
     if(status) {
         fits_get_errstatus(status, error_status);
@@ -161,6 +161,42 @@ fail:
     return NULL;
 }
 
+dsp_stream_p* dsp_file_read_fits(const char* filename, int *channels, int stretch)
+{
+    fitsfile *fptr;
+    int status = 0;
+    char error_status[64];
+
+    fits_open_file(&fptr, filename, READONLY, &status);
+
+    if (status)
+    {
+        fits_get_errstatus(status, error_status);
+        perr("FITS Error: %s\n", error_status);
+        return NULL;
+    }
+
+    return dsp_file_read_fits_fptr(fptr, channels, stretch);
+}
+
+dsp_stream_p* dsp_file_read_fits_memory(void *buf, size_t len, int *channels, int stretch)
+{
+    fitsfile *fptr;
+    int status = 0;
+    char error_status[64];
+
+    fits_open_memfile(&fptr, "memory", READONLY, &buf, &len, 0, NULL, &status);
+
+    if (status)
+    {
+        fits_get_errstatus(status, error_status);
+        perr("FITS Error: %s\n", error_status);
+        return NULL;
+    }
+
+    return dsp_file_read_fits_fptr(fptr, channels, stretch);
+}
+
 void dsp_file_write_fits(const char* filename, int bpp, dsp_stream_p stream)
 {
     dsp_stream_p tmp = dsp_stream_copy(stream);
@@ -263,7 +299,7 @@ fail:
     free (buf);
 }
 
-void dsp_file_write_fits_composite(const char* filename, int components, int bpp, dsp_stream_p* stream)
+static int dsp_file_write_fits_composite_fptr(fitsfile *fptr, int components, int bpp, dsp_stream_p* stream)
 {
     int x;
     dsp_stream_p tmp = stream[components];
@@ -275,7 +311,6 @@ void dsp_file_write_fits_composite(const char* filename, int components, int bpp
     int naxis    = tmp->dims + 1;
     long *naxes = (long*)malloc(sizeof(long) * (size_t)(tmp->dims + 1));
     long nelements = tmp->len * components;
-    char error_status[64];
     int i;
     for (i = 0;  i < tmp->dims; i++)
         naxes[i] = tmp->sizes[i];
@@ -336,6 +371,31 @@ void dsp_file_write_fits_composite(const char* filename, int components, int bpp
         dsp_stream_free(tmp);
     }
 
+    fits_create_img(fptr, img_type, naxis, naxes, &status);
+
+    if (status)
+    {
+        goto fail_fptr;
+    }
+
+    fits_write_img(fptr, byte_type, 1, nelements, buf, &status);
+
+    if (status)
+    {
+        goto fail_fptr;
+    }
+
+fail_fptr:
+    free(naxes);
+    free (buf);
+    return status;
+}
+
+void dsp_file_write_fits_composite(const char* filename, int components, int bpp, dsp_stream_p* stream)
+{
+    int status = 0;
+    char error_status[64];
+
     unlink(filename);
     fitsfile *fptr;
     fits_create_file(&fptr, filename, &status);
@@ -345,29 +405,62 @@ void dsp_file_write_fits_composite(const char* filename, int components, int bpp
         goto fail_fptr;
     }
 
-    fits_create_img(fptr, img_type, naxis, naxes, &status);
-
+    status = dsp_file_write_fits_composite_fptr(fptr, components, bpp, stream);
     if (status)
     {
+        int close_status = 0;
+        fits_close_file(fptr, &close_status);
         goto fail_fptr;
     }
 
-    fits_write_img(fptr, byte_type, 1, nelements, buf, &status);
+    fits_close_file(fptr, &status);
+
+fail_fptr:
+    if(status) {
+        fits_get_errstatus(status, error_status);
+        perr("FITS Error: %s\n", error_status);
+    }
+}
+
+void* dsp_file_write_fits_composite_memory(int components, int bpp, dsp_stream_p* stream, size_t *len)
+{
+    int status = 0;
+    char error_status[64];
+    size_t memsize = 2880;
+    void *memptr = malloc(memsize);
+    fitsfile *fptr;
+    *len = 0;
+
+    fits_create_memfile(&fptr, &memptr, &memsize, 2880, realloc, &status);
 
     if (status)
     {
         goto fail_fptr;
     }
 
+    status = dsp_file_write_fits_composite_fptr(fptr, components, bpp, stream);
+    if (status)
+    {
+        int close_status = 0;
+        fits_close_file(fptr, &close_status);
+        goto fail_fptr;
+    }
+
     fits_close_file(fptr, &status);
+    if (status)
+    {
+        goto fail_fptr;
+    }
 
+    *len = memsize;
+    return memptr;
 fail_fptr:
     if(status) {
         fits_get_errstatus(status, error_status);
         perr("FITS Error: %s\n", error_status);
     }
-    free(naxes);
-    free (buf);
+    free(memptr);
+    return NULL;
 }
 
 
@@ -1,5 +1,276 @@
 #!/bin/bash
 
+# bash scripts/test.sh vdif
+# writes a two threads VDIF recording with a dropped frame and a corrupt header,
+# and a Mark5B recording with a dropped frame and a jump of seven seconds confirmed by its second frame,
+# reads them back and checks the nodes, the zero filled frames and the missing frames count
+if [ "$1" == "vdif" ]; then
+        tmp=$(mktemp -d)
+        trap "rm -rf $tmp" EXIT
+        python3 - $tmp/test.vdif $tmp/test.m5b <<'PY'
+import struct, sys
+threads, seconds, frames, payload = 2, 4, 4, 1024
+with open(sys.argv[1], "wb") as f:
+    def frame(second, number, thread, fill):
+        f.write(struct.pack("<8I", second, (40 << 24) | number, (32 + payload) // 8, (1 << 26) | (thread << 16), 0, 0, 0, 0))
+        f.write(bytes([(fill * 7 + i) & 0xff for i in range(payload)]))
+    for s in range(seconds):
+        for n in range(frames):
+            for t in range(threads):
+                if t == 1 and s == 1 and n == 2:
+                    continue
+                frame(1000 + s, n, t, s * frames + n + t)
+            if s == 2 and n == 1:
+                frame(900000, 0, 0, 0)
+def bcd(value, digits):
+    return sum(((value // 10 ** d) % 10) << (d * 4) for d in range(digits))
+with open(sys.argv[2], "wb") as f:
+    for s in [0, 1, 8, 9]:
+        for n in range(frames):
+            if (s == 1 and n == 1) or (s == 8 and n == 0):
+                continue
+            f.write(struct.pack("<4I", 0xABADDEED, n, (bcd(123, 3) << 20) | bcd(1000 + s, 5), 0))
+            f.write(bytes([(s * frames + n + i) & 0xff for i in range(10000)]))
+PY
+        c++ ${VLBI_CFLAGS:--I/usr/include/OpenVLBI} -x c++ - -x none -o $tmp/test_vdif ${VLBI_LIBS:--lopenvlbi -lopendsp} <<'CPP' || exit 1
+#include <vlbi.h>
+#include <cstdio>
+int main(int argc, char **argv)
+{
+    vlbi_context ctx = vlbi_init();
+    void *recording = vlbi_open_recording(ctx, argv[1], vlbi_recording_vdif, "test", NULL, 1, 0, 0, 0);
+    if(recording == NULL)
+        return 1;
+    long len = vlbi_read_recording(recording, 0);
+    long missing = vlbi_get_recording_missing_frames(recording);
+    vlbi_close_recording(recording);
+    int ok = (len == 16 * 4096 && missing == 1 && vlbi_has_node(ctx, "test_0_0") && vlbi_has_node(ctx, "test_1_0"));
+    for(int t = 0; ok && t < 2; t++)
+    {
+        dsp_stream_p node = vlbi_get_node(ctx, t ? "test_1_0" : "test_0_0");
+        ok = (node->len == len);
+        for(int s = 0; ok && s < node->len; s++)
+            ok = ((node->buf[s] == 0) == (t == 1 && s / 4096 == 6));
+    }
+    printf("vdif: %ld samples, %ld missing frames, %s\n", len, missing, ok ? "ok" : "failed");
+    if(!ok)
+        return 1;
+    recording = vlbi_open_recording(ctx, argv[2], vlbi_recording_mark5b, "m5b", NULL, 1, 0, 1, 2);
+    if(recording == NULL)
+        return 1;
+    len = vlbi_read_recording(recording, 0);
+    missing = vlbi_get_recording_missing_frames(recording);
+    vlbi_close_recording(recording);
+    ok = (len == 40 * 40000 && missing == 27 && vlbi_has_node(ctx, "m5b"));
+    dsp_stream_p node = (ok ? vlbi_get_node(ctx, "m5b") : NULL);
+    ok = ok && node->len == len;
+    for(int s = 0; ok && s < node->len; s++)
+        ok = ((node->buf[s] == 0) == (s / 40000 == 5 || (s / 40000 >= 8 && s / 40000 <= 33)));
+    printf("mark5b: %ld samples, %ld missing frames, %s\n", len, missing, ok ? "ok" : "failed");
+    return !ok;
+}
+CPP
+        $tmp/test_vdif $tmp/test.vdif $tmp/test.m5b
+        exit $?
+fi
+
+# bash scripts/test.sh idi
+# FX correlates three nodes into a FITS-IDI file, with more rows per baseline than a writer batch holds,
+# reads it back with CFITSIO and checks the UV_DATA matrix keywords, the time-baseline row order and each row against the correlated baselines
+if [ "$1" == "idi" ]; then
+        tmp=$(mktemp -d)
+        trap "rm -rf $tmp" EXIT
+        c++ ${VLBI_CFLAGS:--I/usr/include/OpenVLBI} -x c++ - -x none -o $tmp/test_idi ${VLBI_LIBS:--lopenvlbi -lopendsp -lcfitsio} <<'CPP' || exit 1
+#include <vlbi.h>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <vector>
+int main(int argc, char **argv)
+{
+    int channels = 16384, integrations = 100, len = integrations * channels * 2;
+    const char *names[3] = { "idi0", "idi1", "idi2" };
+    vlbi_context ctx = vlbi_init();
+    srand(1);
+    for(int n = 0; n < 3; n++)
+    {
+        dsp_stream_p s = dsp_stream_new();
+        dsp_stream_add_dim(s, len);
+        dsp_stream_alloc_buffer(s, len);
+        for(int i = 0; i < len; i++)
+            s->buf[i] = rand() % 256 - 128.0;
+        s->location[0].geographic.lat = 40 + n;
+        s->location[0].geographic.lon = 10 + n;
+        s->location[0].geographic.el = 100;
+        s->starttimeutc = vlbi_time_string_to_timespec("2020-01-01T00:00:00");
+        s->samplerate = 1000000;
+        vlbi_add_node(ctx, s, names[n], 1);
+    }
+    double target[3] = { 18.5, 38.6, DBL_MAX };
+    long rows = vlbi_get_fx_correlation_to_fitsidi(ctx, argv[1], channels, 0, target, 1.4e9, 1, NULL);
+    fitsfile *f;
+    int status = 0, maxis = 0, naxis = 0, nchan = 0, flux = 0, baseline = 0, time = 0;
+    long nrows = 0, naxes[6] = { 0 }, expected[6] = { 2, 1, channels, 1, 1, 1 };
+    fits_open_file(&f, argv[1], READONLY, &status);
+    fits_movnam_hdu(f, BINARY_TBL, (char*)"UV_DATA", 0, &status);
+    fits_get_num_rows(f, &nrows, &status);
+    fits_read_key(f, TINT, "NO_CHAN", &nchan, NULL, &status);
+    fits_read_key(f, TINT, "MAXIS", &maxis, NULL, &status);
+    fits_get_colnum(f, CASEINSEN, (char*)"FLUX", &flux, &status);
+    fits_get_colnum(f, CASEINSEN, (char*)"BASELINE", &baseline, &status);
+    fits_get_colnum(f, CASEINSEN, (char*)"TIME", &time, &status);
+    fits_read_tdim(f, flux, 6, &naxis, naxes, &status);
+    int ok = (status == 0 && rows == 3 * integrations && nrows == rows && nchan == channels && maxis == 6 && naxis == 6);
+    for(int axis = 0; ok && axis < 6; axis++)
+    {
+        char keyword[16];
+        int length = 0;
+        sprintf(keyword, "MAXIS%d", axis + 1);
+        fits_read_key(f, TINT, keyword, &length, NULL, &status);
+        ok = (status == 0 && length == expected[axis] && naxes[axis] == expected[axis]);
+    }
+    std::vector<int> baselines(ok ? nrows : 0);
+    std::vector<double> times(ok ? nrows : 0);
+    std::vector<float> visibilities(ok ? nrows * channels * 2 : 0);
+    if(ok)
+    {
+        fits_read_col(f, TINT, baseline, 1, 1, nrows, NULL, baselines.data(), NULL, &status);
+        fits_read_col(f, TDOUBLE, time, 1, 1, nrows, NULL, times.data(), NULL, &status);
+        fits_read_col(f, TFLOAT, flux, 1, 1, nrows * channels * 2, NULL, visibilities.data(), NULL, &status);
+        ok = (status == 0);
+    }
+    fits_close_file(f, &status);
+    std::map<int, int> count;
+    std::map<int, double> last;
+    std::map<int, float> sign;
+    for(long r = 0; ok && r < nrows; r++)
+    {
+        int k = count[baselines[r]]++;
+        const char *pair[2] = { names[baselines[r] / 256 - 1], names[baselines[r] % 256 - 1] };
+        dsp_stream_p stream = vlbi_get_baseline_stream(ctx, pair);
+        ok = (stream != NULL && k < integrations && (k == 0 || times[r] > last[baselines[r]]));
+        // rows are sorted by time, then by baseline, across the whole table
+        ok = ok && (r == 0 || times[r] > times[r - 1] || (times[r] == times[r - 1] && baselines[r] > baselines[r - 1]));
+        last[baselines[r]] = times[r];
+        float *row = &visibilities[r * channels * 2];
+        // a baseline correlated in the opposite station order is written conjugated, channel 0 is real
+        if(ok && k == 0)
+            sign[baselines[r]] = (row[3] == (float)stream->dft.pairs[1][1] ? 1.0f : -1.0f);
+        for(int c = 0; ok && c < channels * 2; c++)
+            ok = (row[c] == (c % 2 ? sign[baselines[r]] : 1.0f) * (float)stream->dft.pairs[k * channels + c / 2][c % 2]);
+    }
+    ok = ok && count.size() == 3;
+    printf("idi: %ld rows written, %ld read, %s\n", rows, nrows, ok ? "ok" : "failed");
+    return !ok;
+}
+CPP
+        $tmp/test_idi $tmp/test.fits || exit 1
+        if command -v fitsverify > /dev/null; then
+                fitsverify -q -e $tmp/test.fits | tee /dev/stderr | grep -q "verification OK" || exit 1
+        fi
+        exit 0
+fi
+
+# bash scripts/test.sh sdfits
+# writes a three rows SDFITS table with an 8x8 DATA column and a single row one with CFITSIO,
+# adds their nodes from the files and from memory and checks the node names, shapes, metadata and samples
+if [ "$1" == "sdfits" ]; then
+        tmp=$(mktemp -d)
+        trap "rm -rf $tmp" EXIT
+        c++ ${VLBI_CFLAGS:--I/usr/include/OpenVLBI} -x c++ - -x none -o $tmp/test_sdfits ${VLBI_LIBS:--lopenvlbi -lopendsp -lcfitsio} <<'CPP' || exit 1
+#include <vlbi.h>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+static int write_sdfits(const char *filename, int nrows)
+{
+    char *ttype[] = { (char*)"OBJCTRA", (char*)"OBJCTDEC", (char*)"OBSFREQ", (char*)"SITELAT", (char*)"SITELONG", (char*)"SITEELEV", (char*)"DATE-OBS", (char*)"EXPOSURE", (char*)"TIME", (char*)"DATA" };
+    char *tform[] = { (char*)"16A", (char*)"16A", (char*)"1D", (char*)"1D", (char*)"1D", (char*)"1D", (char*)"19A", (char*)"1D", (char*)"1D", (char*)"64E" };
+    fitsfile *f;
+    int status = 0;
+    long naxes[2] = { 8, 8 };
+    fits_create_file(&f, filename, &status);
+    fits_create_tbl(f, BINARY_TBL, 0, 10, ttype, tform, NULL, "SINGLE DISH", &status);
+    fits_write_tdim(f, 10, 2, naxes, &status);
+    for(int r = 0; r < nrows; r++)
+    {
+        char ra[] = "12:30:00", dec[] = "45:00:00", date[] = "2020-01-01T00:00:00";
+        char *strings[3] = { ra, dec, date };
+        double freq = 1.4e9, lat = 40 + r, lon = 10 + r, el = 100, exposure = 2, time = 3600 + r;
+        float data[64];
+        for(int i = 0; i < 64; i++)
+            data[i] = r * 64 + i;
+        fits_write_col(f, TSTRING, 1, r + 1, 1, 1, &strings[0], &status);
+        fits_write_col(f, TSTRING, 2, r + 1, 1, 1, &strings[1], &status);
+        fits_write_col(f, TDOUBLE, 3, r + 1, 1, 1, &freq, &status);
+        fits_write_col(f, TDOUBLE, 4, r + 1, 1, 1, &lat, &status);
+        fits_write_col(f, TDOUBLE, 5, r + 1, 1, 1, &lon, &status);
+        fits_write_col(f, TDOUBLE, 6, r + 1, 1, 1, &el, &status);
+        fits_write_col(f, TSTRING, 7, r + 1, 1, 1, &strings[2], &status);
+        fits_write_col(f, TDOUBLE, 8, r + 1, 1, 1, &exposure, &status);
+        fits_write_col(f, TDOUBLE, 9, r + 1, 1, 1, &time, &status);
+        fits_write_col(f, TFLOAT, 10, r + 1, 1, 64, data, &status);
+    }
+    fits_close_file(f, &status);
+    return status;
+}
+static std::vector<char> read_file(const char *filename)
+{
+    std::vector<char> buf;
+    FILE *f = fopen(filename, "rb");
+    if(f == NULL)
+        return buf;
+    fseek(f, 0, SEEK_END);
+    buf.resize(ftell(f));
+    fseek(f, 0, SEEK_SET);
+    buf.resize(fread(buf.data(), 1, buf.size(), f));
+    fclose(f);
+    return buf;
+}
+static int check_node(vlbi_context ctx, const char *name, int r)
+{
+    dsp_stream_p node = vlbi_has_node(ctx, name) ? vlbi_get_node(ctx, name) : NULL;
+    int ok = (node != NULL && node->dims == 2 && node->sizes[0] == 8 && node->sizes[1] == 8 && node->len == 64);
+    ok = ok && node->samplerate == 32 && node->location[0].geographic.lat == 40 + r && node->location[0].geographic.lon == 10 + r;
+    ok = ok && node->starttimeutc.tv_sec == vlbi_time_string_to_timespec("2020-01-01T01:00:00").tv_sec + r - 1;
+    for(int i = 0; ok && i < 64; i++)
+        ok = (node->buf[i] == r * 64 + i);
+    return ok;
+}
+int main(int argc, char **argv)
+{
+    char rows[256], single[256], name[32];
+    snprintf(rows, sizeof(rows), "%s/rows.fits", argv[1]);
+    snprintf(single, sizeof(single), "%s/single.fits", argv[1]);
+    if(write_sdfits(rows, 3) || write_sdfits(single, 1))
+        return 1;
+    std::vector<char> rows_buf = read_file(rows);
+    std::vector<char> single_buf = read_file(single);
+    vlbi_context ctx = vlbi_init();
+    vlbi_add_nodes_from_sdfits(ctx, rows, "file", 1);
+    vlbi_add_nodes_from_sdfits_memory(ctx, rows_buf.data(), rows_buf.size(), "memory", 1);
+    vlbi_add_nodes_from_sdfits(ctx, single, "single_file", 1);
+    vlbi_add_nodes_from_sdfits_memory(ctx, single_buf.data(), single_buf.size(), "single_memory", 1);
+    vlbi_node *nodes = NULL;
+    int count = vlbi_get_nodes(ctx, &nodes);
+    free(nodes);
+    int ok = (count == 8 && !vlbi_has_node(ctx, "file") && !vlbi_has_node(ctx, "memory"));
+    for(int r = 0; ok && r < 3; r++)
+    {
+        snprintf(name, sizeof(name), "file_%d", r);
+        ok = check_node(ctx, name, r);
+        snprintf(name, sizeof(name), "memory_%d", r);
+        ok = ok && check_node(ctx, name, r);
+    }
+    ok = ok && check_node(ctx, "single_file", 0) && check_node(ctx, "single_memory", 0);
+    printf("sdfits: %d nodes, %s\n", count, ok ? "ok" : "failed");
+    return !ok;
+}
+CPP
+        $tmp/test_sdfits $tmp
+        exit $?
+fi
+
 num_nodes=4
 freq=142000000
 sr=1
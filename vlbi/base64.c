@@ -36,9 +36,187 @@
 
 #include <ctype.h>
 #include <stdint.h>
+#include <string.h>
 #include "base64.h"
 #include "base64_luts.h"
 #include <stdio.h>
+#include <pthread.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BASE64_X86
+#include <immintrin.h>
+#endif
+
+/* SIMD kernels, they convert whole blocks only and return how many input bytes (encoders)
+ * or quads (decoders) they consumed, the scalar code converts the rest.
+ * The decoders stop at the first block holding anything else than base64 digits,
+ * so newlines, padding and invalid characters always go through the scalar lookup tables
+ * and the output is the same of the scalar codec.
+ * The decoders store a few bytes past the block: they leave at least 3 quads to the scalar code.
+ */
+static int encode_generic(unsigned char *out, const unsigned char *in, int inlen)
+{
+    (void)out;
+    (void)in;
+    (void)inlen;
+    return 0;
+}
+
+static int decode_generic(char *out, const char *in, int quads)
+{
+    (void)out;
+    (void)in;
+    (void)quads;
+    return 0;
+}
+
+#ifdef BASE64_X86
+
+__attribute__((target("ssse3")))
+static inline __m128i encode_ssse3_block(__m128i in)
+{
+    const __m128i shift_lut = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                            '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    __m128i indices;
+    __m128i result;
+    in = _mm_shuffle_epi8(in, _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+    indices = _mm_or_si128(_mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040)),
+                           _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010)));
+    result = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+    result = _mm_or_si128(result, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), indices), _mm_set1_epi8(13)));
+    return _mm_add_epi8(_mm_shuffle_epi8(shift_lut, result), indices);
+}
+
+__attribute__((target("ssse3")))
+static int encode_ssse3(unsigned char *out, const unsigned char *in, int inlen)
+{
+    int i = 0;
+    for(; i + 16 <= inlen; i += 12, out += 16)
+        _mm_storeu_si128((__m128i*)out, encode_ssse3_block(_mm_loadu_si128((const __m128i*)&in[i])));
+    return i;
+}
+
+__attribute__((target("ssse3")))
+static inline int decode_ssse3_block(char *out, __m128i in)
+{
+    const __m128i lut_lo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+    const __m128i lut_hi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m128i lut_roll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i mask_2f = _mm_set1_epi8(0x2f);
+    __m128i hi_nibbles = _mm_and_si128(_mm_srli_epi32(in, 4), mask_2f);
+    __m128i lo_nibbles = _mm_and_si128(in, mask_2f);
+    __m128i invalid = _mm_and_si128(_mm_shuffle_epi8(lut_lo, lo_nibbles), _mm_shuffle_epi8(lut_hi, hi_nibbles));
+    if(_mm_movemask_epi8(_mm_cmpgt_epi8(invalid, _mm_setzero_si128())))
+        return 0;
+    in = _mm_add_epi8(in, _mm_shuffle_epi8(lut_roll, _mm_add_epi8(_mm_cmpeq_epi8(in, mask_2f), hi_nibbles)));
+    in = _mm_madd_epi16(_mm_maddubs_epi16(in, _mm_set1_epi32(0x01400140)), _mm_set1_epi32(0x00011000));
+    in = _mm_shuffle_epi8(in, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+    _mm_storeu_si128((__m128i*)out, in);
+    return 1;
+}
+
+__attribute__((target("ssse3")))
+static int decode_ssse3(char *out, const char *in, int quads)
+{
+    int q = 0;
+    for(; q + 4 + 3 <= quads; q += 4, in += 16, out += 12)
+    {
+        if(!decode_ssse3_block(out, _mm_loadu_si128((const __m128i*)in)))
+            break;
+    }
+    return q;
+}
+
+__attribute__((target("avx2")))
+static int encode_avx2(unsigned char *out, const unsigned char *in, int inlen)
+{
+    int i = 0;
+    for(; i + 28 <= inlen; i += 24, out += 32)
+    {
+        __m256i block = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)&in[i])),
+                                                _mm_loadu_si128((const __m128i*)&in[i + 12]), 1);
+        const __m256i shift_lut = _mm256_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                  '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+                                  'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                  '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+        __m256i indices;
+        __m256i result;
+        block = _mm256_shuffle_epi8(block, _mm256_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+                                    1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+        indices = _mm256_or_si256(_mm256_mulhi_epu16(_mm256_and_si256(block, _mm256_set1_epi32(0x0fc0fc00)), _mm256_set1_epi32(0x04000040)),
+                                  _mm256_mullo_epi16(_mm256_and_si256(block, _mm256_set1_epi32(0x003f03f0)), _mm256_set1_epi32(0x01000010)));
+        result = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+        result = _mm256_or_si256(result, _mm256_and_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices), _mm256_set1_epi8(13)));
+        _mm256_storeu_si256((__m256i*)out, _mm256_add_epi8(_mm256_shuffle_epi8(shift_lut, result), indices));
+    }
+    return i + encode_ssse3(out, &in[i], inlen - i);
+}
+
+__attribute__((target("avx2")))
+static int decode_avx2(char *out, const char *in, int quads)
+{
+    const __m256i lut_lo = _mm256_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a,
+                                            0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+    const __m256i lut_hi = _mm256_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+                                            0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m256i lut_roll = _mm256_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+                             0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i mask_2f = _mm256_set1_epi8(0x2f);
+    int q = 0;
+    for(; q + 8 + 3 <= quads; q += 8, in += 32, out += 24)
+    {
+        __m256i block = _mm256_loadu_si256((const __m256i*)in);
+        __m256i hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(block, 4), mask_2f);
+        __m256i lo_nibbles = _mm256_and_si256(block, mask_2f);
+        __m256i invalid = _mm256_and_si256(_mm256_shuffle_epi8(lut_lo, lo_nibbles), _mm256_shuffle_epi8(lut_hi, hi_nibbles));
+        if(_mm256_movemask_epi8(_mm256_cmpgt_epi8(invalid, _mm256_setzero_si256())))
+            break;
+        block = _mm256_add_epi8(block, _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(_mm256_cmpeq_epi8(block, mask_2f), hi_nibbles)));
+        block = _mm256_madd_epi16(_mm256_maddubs_epi16(block, _mm256_set1_epi32(0x01400140)), _mm256_set1_epi32(0x00011000));
+        block = _mm256_shuffle_epi8(block, _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                    2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+        _mm256_storeu_si256((__m256i*)out, _mm256_permutevar8x32_epi32(block, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7)));
+    }
+    return q + decode_ssse3(out, in, quads - q);
+}
+
+#endif
+
+static int (*encode_kernel)(unsigned char *out, const unsigned char *in, int inlen) = NULL;
+static int (*decode_kernel)(char *out, const char *in, int quads) = NULL;
+static const char *base64_isa = NULL;
+static pthread_once_t kernels_once = PTHREAD_ONCE_INIT;
+
+static void select_kernels(void)
+{
+    int (*encode)(unsigned char *out, const unsigned char *in, int inlen) = encode_generic;
+    int (*decode)(char *out, const char *in, int quads) = decode_generic;
+    const char *isa = "generic";
+#ifdef BASE64_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))
+    {
+        encode = encode_avx2;
+        decode = decode_avx2;
+        isa = "avx2";
+    }
+    else if(__builtin_cpu_supports("ssse3"))
+    {
+        encode = encode_ssse3;
+        decode = decode_ssse3;
+        isa = "ssse3";
+    }
+#endif
+    encode_kernel = encode;
+    decode_kernel = decode;
+    base64_isa = isa;
+}
+
+const char *base64_kernels_isa(void)
+{
+    pthread_once(&kernels_once, select_kernels);
+    return base64_isa;
+}
 
 /* convert inlen raw bytes at in to base64 string (NUL-terminated) at out. 
  * out size should be at least 4*inlen/3 + 4.
@@ -48,7 +226,15 @@ int to64frombits(unsigned char *out, const unsigned char *in, int inlen)
 {
     uint16_t *b64lut = (uint16_t *)base64lut;
     int dlen         = ((inlen + 2) / 3) * 4; /* 4/3, rounded up */
-    uint16_t *wbuf   = (uint16_t *)out;
+    uint16_t *wbuf;
+    int done;
+
+    pthread_once(&kernels_once, select_kernels);
+    done = encode_kernel(out, in, inlen);
+    out += done / 3 * 4;
+    in += done;
+    inlen -= done;
+    wbuf = (uint16_t *)out;
 
     for (; inlen > 2; inlen -= 3)
     {
@@ -98,9 +284,18 @@ int from64tobits_fast(char *out, char *in, int inlen)
     int j;
     int n         = (inlen / 4) - 1;
     uint16_t *inp = (uint16_t *)in;
+    char *end     = in + inlen;
 
+    pthread_once(&kernels_once, select_kernels);
     for (j = 0; j < n; j++)
     {
+        int quads = (int)((end - in) / 4);
+        quads = decode_kernel(out, in, quads < n - j ? quads : n - j);
+        in += quads * 4;
+        out += quads * 3;
+        j += quads;
+        if (j >= n)
+            break;
         if (in[0] == '\n')
             in++;
         inp = (uint16_t *)in;
@@ -158,6 +353,89 @@ int from64tobits_fast(char *out, char *in, int inlen)
     return outlen;
 }
 
+void base64_stream_init(base64_stream *stream)
+{
+    memset(stream, 0, sizeof(base64_stream));
+}
+
+/* encode a chunk, the bytes not making a whole group of 3 are kept for the next chunk.
+ * out size should be at least 4*(inlen+2)/3 + 4.
+ */
+int to64frombits_stream(base64_stream *stream, unsigned char *out, const unsigned char *in, int inlen)
+{
+    int outlen = 0;
+    int full;
+    while (stream->len > 0 && stream->len < 3 && inlen > 0)
+    {
+        stream->buf[stream->len++] = *in++;
+        inlen--;
+    }
+    if (stream->len == 3)
+    {
+        outlen += to64frombits(out, stream->buf, 3);
+        stream->len = 0;
+    }
+    full = inlen - inlen % 3;
+    if (full > 0)
+        outlen += to64frombits(&out[outlen], in, full);
+    memcpy(stream->buf, &in[full], (size_t)(inlen - full));
+    stream->len += inlen - full;
+    out[outlen] = 0;
+    return outlen;
+}
+
+int to64frombits_stream_end(base64_stream *stream, unsigned char *out)
+{
+    int outlen = to64frombits(out, stream->buf, stream->len);
+    stream->len = 0;
+    return outlen;
+}
+
+/* decode a chunk, newlines are skipped and the characters not making a whole quad are kept for the next chunk.
+ * out size should be at least 3*(inlen+3)/4 + 3.
+ */
+int from64tobits_stream(base64_stream *stream, char *out, const char *in, int inlen)
+{
+    int outlen = 0;
+    while (inlen > 0)
+    {
+        const char *nl;
+        int len, full;
+        if (stream->len > 0)
+        {
+            if (*in != '\n')
+                stream->buf[stream->len++] = *in;
+            in++;
+            inlen--;
+            if (stream->len == 4)
+            {
+                outlen += from64tobits_fast(&out[outlen], (char *)stream->buf, 4);
+                stream->len = 0;
+            }
+            continue;
+        }
+        nl   = (const char *)memchr(in, '\n', (size_t)inlen);
+        len  = (nl != NULL ? (int)(nl - in) : inlen);
+        full = len & ~3;
+        if (full > 0)
+            outlen += from64tobits_fast(&out[outlen], (char *)in, full);
+        memcpy(stream->buf, &in[full], (size_t)(len - full));
+        stream->len = len - full;
+        if (nl != NULL)
+            len++;
+        in += len;
+        inlen -= len;
+    }
+    return outlen;
+}
+
+int from64tobits_stream_end(base64_stream *stream)
+{
+    int left = stream->len;
+    stream->len = 0;
+    return (left > 0 ? -1 : 0);
+}
+
 #ifdef BASE64_PROGRAM
 /* standalone program that converts to/from base64.
  * cc -o base64 -DBASE64_PROGRAM base64.c
@@ -290,3 +568,76 @@ int main(int ac, char *av[])
     return (0);
 }
 #endif
+
+#ifdef BASE64_BENCHMARK
+/* standalone throughput benchmark of the base64 kernels, the output of each kernel is compared
+ * with the scalar one.
+ * cc -O2 -pthread -o base64_benchmark -DBASE64_BENCHMARK base64.c
+ */
+
+#include <stdlib.h>
+#include <time.h>
+
+static double elapsed(struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) + (double)(now.tv_nsec - start->tv_nsec) / 1000000000.0;
+}
+
+int main(int ac, char *av[])
+{
+    int size = (ac > 1 ? atoi(av[1]) : 64) * 1024 * 1024;
+    int loops = (ac > 2 ? atoi(av[2]) : 10);
+    const char *names[] = { "generic", "ssse3", "avx2" };
+    int (*encoders[])(unsigned char *out, const unsigned char *in, int inlen) = { encode_generic,
+#ifdef BASE64_X86
+        encode_ssse3, encode_avx2
+#endif
+    };
+    int (*decoders[])(char *out, const char *in, int quads) = { decode_generic,
+#ifdef BASE64_X86
+        decode_ssse3, decode_avx2
+#endif
+    };
+    int nkernels = (int)(sizeof(encoders) / sizeof(encoders[0]));
+    unsigned char *raw = malloc((size_t)size);
+    unsigned char *ref = malloc((size_t)size / 3 * 4 + 8);
+    unsigned char *b64 = malloc((size_t)size / 3 * 4 + 8);
+    char *back = malloc((size_t)size + 8);
+    int k, i, nb64 = 0, nback = 0;
+    struct timespec start;
+
+    srand(1);
+    for (i = 0; i < size; i++)
+        raw[i] = (unsigned char)rand();
+    printf("detected: %s\n", base64_kernels_isa());
+    encode_kernel = encode_generic;
+    to64frombits(ref, raw, size);
+
+    for (k = 0; k < nkernels; k++)
+    {
+#ifdef BASE64_X86
+        if ((k == 1 && !__builtin_cpu_supports("ssse3")) || (k == 2 && !__builtin_cpu_supports("avx2")))
+            continue;
+#endif
+        encode_kernel = encoders[k];
+        decode_kernel = decoders[k];
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (i = 0; i < loops; i++)
+            nb64 = to64frombits(b64, raw, size);
+        double encode = (double)size * loops / elapsed(&start) / 1048576.0;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (i = 0; i < loops; i++)
+            nback = from64tobits_fast(back, (char *)b64, nb64);
+        double decode = (double)size * loops / elapsed(&start) / 1048576.0;
+        printf("%-8s encode %8.1f MB/s decode %8.1f MB/s %s\n", names[k], encode, decode,
+               (memcmp(b64, ref, (size_t)nb64 + 1) || nback != size || memcmp(back, raw, (size_t)size)) ? "MISMATCH" : "ok");
+    }
+    free(raw);
+    free(ref);
+    free(b64);
+    free(back);
+    return 0;
+}
+#endif
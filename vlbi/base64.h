@@ -51,6 +51,55 @@ extern int to64frombits(unsigned char *out, const unsigned char *in, int inlen);
 extern int from64tobits(char *out, char *in);
 extern int from64tobits_fast(char *out, char *in, int inlen);
 
+/** \brief State of a chunked base64 conversion, holding the bytes or characters left from the previous chunk.
+ */
+typedef struct base64_stream
+{
+    unsigned char buf[4];
+    int len;
+} base64_stream;
+
+/** \brief Initialize the state of a chunked base64 conversion.
+    \param stream the conversion state
+ */
+extern void base64_stream_init(base64_stream *stream);
+
+/** \brief Convert a chunk of a bytes array to base64, the concatenated output of all the chunks is the same of to64frombits.
+    \param stream the conversion state
+    \param out output buffer in base64. The buffer size must be at least (4 * (inlen + 2) / 3 + 4) bytes long.
+    \param in input binary chunk
+    \param inlen number of bytes to convert
+    \return number of base64 characters written.
+ */
+extern int to64frombits_stream(base64_stream *stream, unsigned char *out, const unsigned char *in, int inlen);
+
+/** \brief Convert the bytes left by the last chunk to base64 and add the padding.
+    \param stream the conversion state
+    \param out output buffer in base64, at least 5 bytes long.
+    \return number of base64 characters written.
+ */
+extern int to64frombits_stream_end(base64_stream *stream, unsigned char *out);
+
+/** \brief Convert a chunk of base64 to bytes array, chunks can be split anywhere and newlines are skipped.
+    \param stream the conversion state
+    \param out output buffer in bytes. The buffer size must be at least (3 * (inlen + 3) / 4 + 3) bytes long.
+    \param in input base64 chunk
+    \param inlen base64 chunk lenght
+    \return number of bytes written.
+ */
+extern int from64tobits_stream(base64_stream *stream, char *out, const char *in, int inlen);
+
+/** \brief Terminate a chunked conversion from base64.
+    \param stream the conversion state
+    \return 0 on success, -1 if the input ended with an incomplete quad.
+ */
+extern int from64tobits_stream_end(base64_stream *stream);
+
+/** \brief Name of the instruction set used by the base64 conversion kernels.
+    \return "avx2", "ssse3" or "generic".
+ */
+extern const char *base64_kernels_isa(void);
+
 /*@}*/
 
 #ifdef __cplusplus
@@ -17,6 +17,23 @@
 */
 
 #include "baseline.h"
+#include <vector>
+
+/**
+* Per-thread scratch of the Correlate overloads, so the plotting jobs
+* don't hit the allocator for each sample or chunk they correlate.
+*/
+struct correlation_scratch
+{
+    std::vector<int> index;
+    std::vector<int> indexes;
+    std::vector<double> values;
+    std::vector<double*> inputs;
+    std::vector<double*> present;
+    std::vector<unsigned char> missing;
+};
+
+static thread_local correlation_scratch scratch;
 
 VLBIBaseline::VLBIBaseline(VLBINode **nodes, int num_nodes)
 {
@@ -69,43 +86,132 @@ double VLBIBaseline::Correlate(double time)
 
 double VLBIBaseline::Correlate(double time1, double time2)
 {
-    int idx1 = (time1 - getStartTime()) / getSampleRate();
-    int idx2 = (time2 - getStartTime()) / getSampleRate();
-    if(idx1 >= 0 && idx2 >= 0 && idx1 < getNode(0)->getStream()->len && idx2 < getNode(1)->getStream()->len)
-        return dsp_correlation_delegate(getNode(0)->getStream()->buf[idx1], getNode(1)->getStream()->buf[idx2]);
+    double starttime = getStartTime();
+    int idx1 = (time1 - starttime) / getSampleRate();
+    int idx2 = (time2 - starttime) / getSampleRate();
+    if(idx1 >= 0 && idx2 >= 0 && idx1 < getNode(0)->getLength() && idx2 < getNode(1)->getLength())
+        return dsp_correlation_delegate(getNode(0)->getSample(idx1), getNode(1)->getSample(idx2));
     return 0.0;
 }
 
 double VLBIBaseline::Correlate(int idx1, int idx2)
 {
-    if(idx1 > 0 && idx2 > 0 && idx1 < getNode(0)->getStream()->len && idx2 < getNode(1)->getStream()->len)
-        return dsp_correlation_delegate(getNode(0)->getStream()->buf[idx1], getNode(1)->getStream()->buf[idx2]);
+    if(idx1 > 0 && idx2 > 0 && idx1 < getNode(0)->getLength() && idx2 < getNode(1)->getLength())
+        return dsp_correlation_delegate(getNode(0)->getSample(idx1), getNode(1)->getSample(idx2));
     return 0.0;
 }
 
 double VLBIBaseline::Correlate(double *times)
 {
-    int *indexes = (int*)malloc(sizeof(int)*nodes_count);
+    std::vector<int> *indexes = &scratch.index;
+    indexes->resize(nodes_count);
+    double starttime = getStartTime();
     for(int i = 0; i < nodes_count; i++)
-        indexes[i] = (times[i] - getStartTime()) / getSampleRate();
-    double val = Correlate(indexes);
-    free(indexes);
-    return val;
+        indexes->at(i) = (times[i] - starttime) / getSampleRate();
+    return Correlate(indexes->data());
 }
 
 double VLBIBaseline::Correlate(int *indexes)
 {
     double val = 0.0;
     int i = 0;
-    if(indexes[i] >= 0 && indexes[i] < getNode(i)->getStream()->len) {
-        val = getNode(i)->getStream()->buf[indexes[i]];
+    if(indexes[i] >= 0 && indexes[i] < getNode(i)->getLength()) {
+        val = getNode(i)->getSample(indexes[i]);
         for(i = 1; i < nodes_count; i++)
-            if(indexes[i] >= 0 && indexes[i] < getNode(i)->getStream()->len)
-                val = dsp_correlation_delegate(val, getNode(i)->getStream()->buf[indexes[i]]);
+            if(indexes[i] >= 0 && indexes[i] < getNode(i)->getLength())
+                val = dsp_correlation_delegate(val, getNode(i)->getSample(indexes[i]));
     }
     return val;
 }
 
+void VLBIBaseline::Correlate(double *times, int len, double *output)
+{
+    int count = Locked() ? 1 : nodes_count;
+    std::vector<int> *indexes = &scratch.indexes;
+    indexes->resize((size_t)len * nodes_count);
+    int *idx = indexes->data();
+    double starttime = getStartTime();
+    double samplerate = getSampleRate();
+    for(int x = 0; x < len; x++)
+    {
+        for(int i = 0; i < count; i++)
+            idx[x * nodes_count + i] = (times[x * count + i] - starttime) / samplerate;
+    }
+    Correlate(idx, len, output);
+}
+
+void VLBIBaseline::Correlate(int *indexes, int len, double *output)
+{
+    if(len < 1)
+        return;
+    if(dsp_correlation_block_delegate == nullptr)
+    {
+        if(Locked())
+        {
+            dsp_stream_p stream = getStream();
+            for(int x = 0; x < len; x++)
+            {
+                int idx = indexes[x * nodes_count];
+                output[x] = (idx >= 0 && idx < stream->len) ? dsp_correlation_delegate(stream->dft.pairs[idx][0],
+                            stream->dft.pairs[idx][1]) : 0.0;
+            }
+        }
+        else
+        {
+            for(int x = 0; x < len; x++)
+                output[x] = Correlate(&indexes[x * nodes_count]);
+        }
+        return;
+    }
+    int count = Locked() ? 2 : nodes_count;
+    scratch.values.resize((size_t)len * count);
+    scratch.inputs.resize(count);
+    scratch.missing.assign(len, 0);
+    double **inputs = scratch.inputs.data();
+    unsigned char *missing = scratch.missing.data();
+    for(int i = 0; i < count; i++)
+        inputs[i] = &scratch.values[(size_t)len * i];
+    if(Locked())
+    {
+        dsp_stream_p stream = getStream();
+        for(int x = 0; x < len; x++)
+        {
+            int idx = indexes[x * nodes_count];
+            missing[x] = (idx < 0 || idx >= stream->len);
+            inputs[0][x] = missing[x] ? 0.0 : stream->dft.pairs[idx][0];
+            inputs[1][x] = missing[x] ? 0.0 : stream->dft.pairs[idx][1];
+        }
+    }
+    else
+    {
+        for(int i = 0; i < count; i++)
+            getNode(i)->getSamples(&indexes[i], nodes_count, len, inputs[i], missing);
+    }
+    dsp_correlation_block_delegate(inputs, count, output, len);
+    scratch.present.resize(count);
+    double **present = scratch.present.data();
+    for(int x = 0; x < len; x++)
+    {
+        if(!missing[x])
+            continue;
+        output[x] = 0.0;
+        int *idx = &indexes[x * nodes_count];
+        if(Locked() || idx[0] < 0 || idx[0] >= getNode(0)->getLength())
+            continue;
+        // like Correlate(int*), skip the missing nodes and correlate the others
+        int n = 0;
+        for(int i = 0; i < count; i++)
+        {
+            if(idx[i] >= 0 && idx[i] < getNode(i)->getLength())
+                present[n++] = &inputs[i][x];
+        }
+        if(n > 1)
+            dsp_correlation_block_delegate(present, n, &output[x], 1);
+        else
+            output[x] = inputs[0][x];
+    }
+}
+
 double VLBIBaseline::getStartTime()
 {
     double starttime = DBL_MIN;
@@ -117,26 +223,27 @@ double VLBIBaseline::getStartTime()
 double VLBIBaseline::getEndTime()
 {
     double tau = 1.0 / getSampleRate();
+    double starttime = getStartTime();
     double endtime = DBL_MAX;
     for(int i = 0; i < nodes_count; i++)
-        endtime = getStartTime() + fmin(endtime, getNode(i)->getStream()->len) * tau;
+        endtime = starttime + fmin(endtime, getNode(i)->getLength()) * tau;
     return endtime;
 }
 
-double *VLBIBaseline::getBaseline()
+double *VLBIBaseline::getBaseline(double **locations)
 {
     double *b;
     dsp_location baseline;
     if (!isRelative())
     {
-        baseline.geographic.lat = getNode(0)->getGeographicLocation()[0];
-        baseline.geographic.lon = getNode(0)->getGeographicLocation()[1];
-        baseline.geographic.el = getNode(0)->getGeographicLocation()[2];
+        baseline.geographic.lat = getLocation(0, locations)[0];
+        baseline.geographic.lon = getLocation(0, locations)[1];
+        baseline.geographic.el = getLocation(0, locations)[2];
         for(int i = 1; i < nodes_count; i++)
         {
-            double lat = getNode(i)->getGeographicLocation()[0];
-            double lon = getNode(i)->getGeographicLocation()[1];
-            double el = getNode(i)->getGeographicLocation()[2];
+            double lat = getLocation(i, locations)[0];
+            double lon = getLocation(i, locations)[1];
+            double el = getLocation(i, locations)[2];
             baseline.geographic.lat = (lat - baseline.geographic.lat);
             baseline.geographic.lon = (lon - baseline.geographic.lon);
             baseline.geographic.el = (el - baseline.geographic.el);
@@ -150,14 +257,14 @@ double *VLBIBaseline::getBaseline()
     else
     {
         b = (double*)malloc(sizeof(double)*3);
-        baseline.xyz.x = getNode(0)->getLocation()[0];
-        baseline.xyz.y = getNode(0)->getLocation()[1];
-        baseline.xyz.z = getNode(0)->getLocation()[2];
+        baseline.xyz.x = getLocation(0, locations)[0];
+        baseline.xyz.y = getLocation(0, locations)[1];
+        baseline.xyz.z = getLocation(0, locations)[2];
         for(int i = 1; i < nodes_count; i++)
         {
-            double x = getNode(i)->getLocation()[0];
-            double y = getNode(i)->getLocation()[1];
-            double z = getNode(i)->getLocation()[2];
+            double x = getLocation(i, locations)[0];
+            double y = getLocation(i, locations)[1];
+            double z = getLocation(i, locations)[2];
             baseline.xyz.x = (x - baseline.xyz.x);
             baseline.xyz.y = (y - baseline.xyz.y);
             baseline.xyz.z = (z - baseline.xyz.z);
@@ -180,9 +287,29 @@ void VLBIBaseline::getProjection()
     free (proj);
 }
 
+void VLBIBaseline::getProjection(double time, double *uvw, double **locations)
+{
+    double target[3];
+    getAltAz(time, &target[1], &target[0], locations);
+    target[2] = Dist;
+    double *b = getBaseline(locations);
+    double *tmp = vlbi_matrix_calc_parametric_projection(target, b);
+    free (b);
+    double *proj = vlbi_matrix_calc_uv_coordinates(tmp, getWaveLength());
+    free (tmp);
+    memcpy(uvw, proj, sizeof(double)*3);
+    free (proj);
+}
+
 void VLBIBaseline::setTime(double time)
 {
     double Alt, Az;
+    getAltAz(time, &Alt, &Az);
+    setTarget(Az, Alt, Dist);
+}
+
+void VLBIBaseline::getAltAz(double time, double *Alt, double *Az, double **locations)
+{
     if(!isRelative())
     {
         dsp_location center;
@@ -190,9 +317,9 @@ void VLBIBaseline::setTime(double time)
         center.geographic.lon = 0.0;
         center.geographic.el = 0.0;
         for(int i = 0; i < nodes_count; i ++) {
-            center.geographic.lat += getNode(i)->getGeographicLocation()[0];
-            center.geographic.el += getNode(i)->getGeographicLocation()[2];
-            double lon = getNode(i)->getGeographicLocation()[1];
+            center.geographic.lat += getLocation(i, locations)[0];
+            center.geographic.el += getLocation(i, locations)[2];
+            double lon = getLocation(i, locations)[1];
             if(fabs(center.geographic.lon - lon) >= 180.0)
             {
                 if(lon < 180.0)
@@ -204,12 +331,11 @@ void VLBIBaseline::setTime(double time)
         center.geographic.lon /= nodes_count;
         center.geographic.el /= nodes_count;
         fmod(center.geographic.lon, 360.0);
-        vlbi_astro_alt_az_from_ra_dec(time, Ra, Dec, center.geographic.lat, center.geographic.lon, &Alt, &Az);
+        vlbi_astro_alt_az_from_ra_dec(time, Ra, Dec, center.geographic.lat, center.geographic.lon, Alt, Az);
     }
     else
     {
-        vlbi_astro_alt_az_from_ra_dec(time, Ra, Dec, stationLocation()->geographic.lat, stationLocation()->geographic.lon, &Alt,
-                                      &Az);
+        vlbi_astro_alt_az_from_ra_dec(time, Ra, Dec, stationLocation()->geographic.lat, stationLocation()->geographic.lon, Alt,
+                                      Az);
     }
-    setTarget(Az, Alt, Dist);
 }
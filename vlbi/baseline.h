@@ -39,11 +39,14 @@ public:
     double Correlate(int idx1, int idx2);
     double Correlate(double *times);
     double Correlate(int *indexes);
+    void Correlate(double *times, int len, double *output);
+    void Correlate(int *indexes, int len, double *output);
     double getStartTime();
     double getEndTime();
 
-    double *getBaseline();
+    double *getBaseline(double **locations = nullptr);
     void getProjection();
+    void getProjection(double time, double *uvw, double **locations = nullptr);
 
     inline double getX() { return baseline[0]; }
     inline double getY() { return baseline[1]; }
@@ -51,6 +54,10 @@ public:
     inline double getU() { return u; }
     inline double getV() { return v; }
     inline double getDelay() { return delay; }
+    inline void setFringe(double delay, double rate, double snr) { fringe_delay = delay; fringe_rate = rate; fringe_snr = snr; }
+    inline double getFringeDelay() { return fringe_delay; }
+    inline double getFringeRate() { return fringe_rate; }
+    inline double getFringeSNR() { return fringe_snr; }
     void setTime(double time);
 
     inline double getRa() { return Ra; }
@@ -69,6 +76,8 @@ public:
     inline void setSampleRate(double samplerate) { SampleRate = samplerate; getStream()->samplerate = samplerate; for(int i = 0; i < nodes_count; i++) getNode(i)->setSampleRate(SampleRate); }
 
     inline VLBINode* getNode(int index) { return Nodes[index]; }
+    inline VLBINode** getNodes() { return Nodes; }
+    inline int getNodesCount() { return nodes_count; }
     inline dsp_stream_p getStream() { return Stream; }
     inline void setStream(dsp_stream_p stream)
     {
@@ -89,6 +98,8 @@ public:
         dsp_stream_free(getStream());
     }
     inline void setDelegate(vlbi_func2_t delegate) { dsp_correlation_delegate = delegate; }
+    inline void setBlockDelegate(vlbi_func_block_t delegate) { dsp_correlation_block_delegate = delegate; }
+    inline vlbi_func_block_t getBlockDelegate() { return dsp_correlation_block_delegate; }
 
     inline bool Locked() { return locked; }
     inline void Lock() { locked = true; }
@@ -98,6 +109,8 @@ public:
     inline dsp_location* stationLocation() { return &station; }
     inline complex_t *getBufferData();
 private:
+    void getAltAz(double time, double *Alt, double *Az, double **locations = nullptr);
+    inline double *getLocation(int index, double **locations) { return locations != nullptr ? locations[index] : getNode(index)->getLocation(); }
     complex_t* dft;
     dsp_location station;
     bool relative { false };
@@ -110,12 +123,16 @@ private:
     double u { 0 };
     double v { 0 };
     double delay { 0 };
+    double fringe_delay { 0 };
+    double fringe_rate { 0 };
+    double fringe_snr { 0 };
     double WaveLength { 0 };
     double SampleRate { 0 };
     int max_threads { 0 };
     VLBINode** Nodes;
     int nodes_count;
     vlbi_func2_t dsp_correlation_delegate;
+    vlbi_func_block_t dsp_correlation_block_delegate { nullptr };
     char *Name;
     dsp_stream_p Stream;
 };
@@ -224,3 +224,11 @@ void BaselineCollection::setDelegate(vlbi_func2_t delegate)
         at(i)->setDelegate(delegate);
     }
 }
+
+void BaselineCollection::setBlockDelegate(vlbi_func_block_t delegate)
+{
+    for(int i = 0; i < count(); i++)
+    {
+        at(i)->setBlockDelegate(delegate);
+    }
+}
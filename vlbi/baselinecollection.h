@@ -56,6 +56,7 @@ class BaselineCollection : public VLBICollection
         void setFrequency(double frequency);
         void setSampleRate(double samplerate);
         void setDelegate(vlbi_func2_t delegate);
+        void setBlockDelegate(vlbi_func_block_t delegate);
         void setRelative(bool rel);
         inline void setStream(dsp_stream_p stream)
         {
@@ -0,0 +1,146 @@
+/*  OpenVLBI - Open Source Very Long Baseline Interferometry
+*   Copyright © 2017-2023  Ilia Platone
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 2 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along
+*   with this program; if not, write to the Free Software Foundation, Inc.,
+*   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "clean.h"
+#include "threadpool.h"
+
+static const long parallel_size = 65536;
+
+VLBIClean::VLBIClean(VLBIThreadPool *pool)
+{
+    Pool = pool;
+}
+
+VLBIClean::~VLBIClean()
+{
+}
+
+void *VLBIClean::searchStripe(void *arg)
+{
+    stripe *s = (stripe*)arg;
+    int peak = vlbi_block_find_peak(&s->buf[s->start], (int)(s->end - s->start));
+    s->peak = (peak < 0 ? -1 : s->start + peak);
+    return nullptr;
+}
+
+void *VLBIClean::subtractStripe(void *arg)
+{
+    stripe *s = (stripe*)arg;
+    for(long y = s->start; y < s->end; y++)
+    {
+        dsp_t *row = &s->buf[y * s->u];
+        dsp_t *psf = &s->psf[(y + s->dy) * s->pu + s->dx];
+        for(int x = s->x0; x <= s->x1; x++)
+            row[x] -= s->amount * psf[x];
+    }
+    return nullptr;
+}
+
+long VLBIClean::findPeak(dsp_t *buf, long len)
+{
+    int nstripes = (len < parallel_size ? 1 : Max(1, Pool->getThreads()));
+    std::vector<stripe> stripes((size_t)nstripes);
+    std::atomic<int> pending(0);
+    for(int s = 0; s < nstripes; s++)
+    {
+        stripes[s].buf = buf;
+        stripes[s].start = len * s / nstripes;
+        stripes[s].end = len * (s + 1) / nstripes;
+        if(nstripes > 1)
+            Pool->push(searchStripe, &stripes[s], &pending);
+        else
+            searchStripe(&stripes[s]);
+    }
+    if(nstripes > 1)
+        Pool->wait(&pending);
+    long peak = -1;
+    for(int s = 0; s < nstripes; s++)
+    {
+        if(stripes[s].peak < 0)
+            continue;
+        if(peak < 0 || fabs(buf[stripes[s].peak]) > fabs(buf[peak]))
+            peak = stripes[s].peak;
+    }
+    return peak;
+}
+
+void VLBIClean::subtract(dsp_t *residual, int u, int v, dsp_t *psf, int pu, int pv, int px, int py, int x, int y, double amount)
+{
+    int i0 = Max(-x, -px);
+    int i1 = Min(u - 1 - x, pu - 1 - px);
+    int j0 = Max(-y, -py);
+    int j1 = Min(v - 1 - y, pv - 1 - py);
+    if(window > 0)
+    {
+        i0 = Max(i0, -window);
+        i1 = Min(i1, window);
+        j0 = Max(j0, -window);
+        j1 = Min(j1, window);
+    }
+    if(i0 > i1 || j0 > j1)
+        return;
+    long rows = j1 - j0 + 1;
+    int nstripes = ((long)(i1 - i0 + 1) * rows < parallel_size ? 1 : (int)Min((long)Pool->getThreads(), rows));
+    std::vector<stripe> stripes((size_t)nstripes);
+    std::atomic<int> pending(0);
+    for(int s = 0; s < nstripes; s++)
+    {
+        stripes[s].buf = residual;
+        stripes[s].start = y + j0 + rows * s / nstripes;
+        stripes[s].end = y + j0 + rows * (s + 1) / nstripes;
+        stripes[s].psf = psf;
+        stripes[s].u = u;
+        stripes[s].pu = pu;
+        stripes[s].x0 = x + i0;
+        stripes[s].x1 = x + i1;
+        stripes[s].dx = px - x;
+        stripes[s].dy = py - y;
+        stripes[s].amount = amount;
+        if(nstripes > 1)
+            Pool->push(subtractStripe, &stripes[s], &pending);
+        else
+            subtractStripe(&stripes[s]);
+    }
+    if(nstripes > 1)
+        Pool->wait(&pending);
+}
+
+int VLBIClean::hogbom(dsp_t *residual, int u, int v, dsp_t *psf, int pu, int pv, dsp_t *components, int *interrupt)
+{
+    pfunc;
+    long center = findPeak(psf, (long)pu * pv);
+    if(center < 0 || psf[center] == 0.0)
+        return 0;
+    int px = (int)(center % pu);
+    int py = (int)(center / pu);
+    double pmax = psf[center];
+    int n;
+    for(n = 0; n < iterations; n++)
+    {
+        if(interrupt != nullptr && *interrupt)
+            break;
+        long peak = findPeak(residual, (long)u * v);
+        if(peak < 0 || fabs(residual[peak]) <= threshold)
+            break;
+        double amount = gain * residual[peak] / pmax;
+        components[peak] += amount;
+        subtract(residual, u, v, psf, pu, pv, px, py, (int)(peak % u), (int)(peak / u), amount);
+    }
+    pgarb("%d CLEAN components found\n", n);
+    return n;
+}
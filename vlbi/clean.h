@@ -0,0 +1,71 @@
+/*  OpenVLBI - Open Source Very Long Baseline Interferometry
+*   Copyright © 2017-2023  Ilia Platone
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 2 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along
+*   with this program; if not, write to the Free Software Foundation, Inc.,
+*   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#ifndef _CLEAN_H
+#define _CLEAN_H
+
+#include <vlbi.h>
+#include <vector>
+
+class VLBIThreadPool;
+
+/**
+* Högbom CLEAN of an image with its point spread function.
+* The peak search is split into stripes searched in parallel with vlbi_block_find_peak,
+* the PSF is subtracted only within a window around each component, by stripes of rows in parallel.
+*/
+class VLBIClean
+{
+    public:
+        VLBIClean(VLBIThreadPool *pool);
+        ~VLBIClean();
+        int hogbom(dsp_t *residual, int u, int v, dsp_t *psf, int pu, int pv, dsp_t *components, int *interrupt);
+        inline void setGain(double value) { gain = value; }
+        inline void setThreshold(double value) { threshold = value; }
+        inline void setIterations(int value) { iterations = value; }
+        inline void setWindow(int value) { window = value; }
+
+    private:
+        struct stripe
+        {
+            dsp_t *buf;
+            long start;
+            long end;
+            long peak;
+            dsp_t *psf;
+            int u;
+            int pu;
+            int x0;
+            int x1;
+            int dx;
+            int dy;
+            double amount;
+        };
+        static void *searchStripe(void *arg);
+        static void *subtractStripe(void *arg);
+        long findPeak(dsp_t *buf, long len);
+        void subtract(dsp_t *residual, int u, int v, dsp_t *psf, int pu, int pv, int px, int py, int x, int y, double amount);
+
+        VLBIThreadPool *Pool;
+        double gain { 0.1 };
+        double threshold { 0.0 };
+        int iterations { 1000 };
+        int window { 0 };
+};
+
+#endif //_CLEAN_H
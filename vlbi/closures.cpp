@@ -0,0 +1,202 @@
+/*  OpenVLBI - Open Source Very Long Baseline Interferometry
+*   Copyright © 2017-2023  Ilia Platone
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 2 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along
+*   with this program; if not, write to the Free Software Foundation, Inc.,
+*   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "closures.h"
+#include "threadpool.h"
+#include "visibilitytable.h"
+#include <algorithm>
+
+VLBIClosures::VLBIClosures()
+{
+}
+
+VLBIClosures::~VLBIClosures()
+{
+    clear();
+}
+
+void VLBIClosures::clear()
+{
+    stations = 0;
+    edges.clear();
+    phase.clear();
+    amplitude.clear();
+    times.clear();
+    triangles.clear();
+    phases.clear();
+    quadrangles.clear();
+    amplitudes.clear();
+}
+
+void *VLBIClosures::closePhases(void *arg)
+{
+    block *b = (block*)arg;
+    VLBIClosures *c = b->closures;
+    long len = (long)c->times.size();
+    for(int n = b->start; n < b->end; n++)
+    {
+        int *t = &c->triangles[n * 3];
+        int ij = c->getEdge(t[0], t[1]);
+        int jk = c->getEdge(t[1], t[2]);
+        int ik = c->getEdge(t[0], t[2]);
+        double sij = (ij > 0 ? 1.0 : -1.0);
+        double sjk = (jk > 0 ? 1.0 : -1.0);
+        double sik = (ik > 0 ? 1.0 : -1.0);
+        double *a = &c->phase[(abs(ij) - 1) * len];
+        double *d = &c->phase[(abs(jk) - 1) * len];
+        double *e = &c->phase[(abs(ik) - 1) * len];
+        double *out = &c->phases[n * len];
+        for(long x = 0; x < len; x++)
+        {
+            double phi = sij * a[x] + sjk * d[x] - sik * e[x];
+            out[x] = phi - 2.0 * PI * floor(phi / (2.0 * PI) + 0.5);
+        }
+    }
+    return nullptr;
+}
+
+void *VLBIClosures::closeAmplitudes(void *arg)
+{
+    block *b = (block*)arg;
+    VLBIClosures *c = b->closures;
+    long len = (long)c->times.size();
+    for(int n = b->start; n < b->end; n++)
+    {
+        int *q = &c->quadrangles[n * 4];
+        double *ab = &c->amplitude[(abs(c->getEdge(q[0], q[1])) - 1) * len];
+        double *cd = &c->amplitude[(abs(c->getEdge(q[2], q[3])) - 1) * len];
+        double *ac = &c->amplitude[(abs(c->getEdge(q[0], q[2])) - 1) * len];
+        double *bd = &c->amplitude[(abs(c->getEdge(q[1], q[3])) - 1) * len];
+        double *out = &c->amplitudes[n * len];
+        for(long x = 0; x < len; x++)
+            out[x] = ab[x] * cd[x] / (ac[x] * bd[x]);
+    }
+    return nullptr;
+}
+
+void VLBIClosures::run(void *(*func)(void*), int count, VLBIThreadPool *pool)
+{
+    if(count < 1)
+        return;
+    int nblocks = Min(count, Max(1, pool->getThreads() * 4));
+    std::vector<block> blocks((size_t)nblocks);
+    std::atomic<int> pending(0);
+    for(int n = 0; n < nblocks; n++)
+    {
+        blocks[n].closures = this;
+        blocks[n].start = (int)((long)count * n / nblocks);
+        blocks[n].end = (int)((long)count * (n + 1) / nblocks);
+        pool->push(func, &blocks[n], &pending);
+    }
+    pool->wait(&pending);
+}
+
+int VLBIClosures::compute(VLBIVisibilityTable *table, double interval, VLBIThreadPool *pool)
+{
+    pfunc;
+    clear();
+    stations = table->getStationsCount();
+    int nbaselines = table->getBaselinesCount();
+    if(stations < 3)
+        return 0;
+    edges.assign((size_t)stations * stations, 0);
+    for(int id = 0; id < nbaselines; id++)
+    {
+        int p = table->getFirstStation(id);
+        int q = table->getSecondStation(id);
+        if(p < 0 || q < 0 || p == q)
+            continue;
+        edges[p * stations + q] = id + 1;
+        edges[q * stations + p] = -(id + 1);
+    }
+    if(interval <= 0.0)
+        interval = table->getIntegrationTime();
+    if(interval <= 0.0)
+    {
+        perr("no snapshot interval and no integration time into the visibility table\n");
+        return 0;
+    }
+    double tmin = DBL_MAX;
+    for(int r = 0; r < table->count(); r++)
+    {
+        if(table->getFlags()[r])continue;
+        tmin = fmin(tmin, table->getTime()[r]);
+    }
+    if(tmin == DBL_MAX)
+        return 0;
+    std::vector<long> bins;
+    for(int r = 0; r < table->count(); r++)
+    {
+        if(table->getFlags()[r])continue;
+        bins.push_back((long)floor((table->getTime()[r] - tmin) / interval));
+    }
+    std::sort(bins.begin(), bins.end());
+    bins.erase(std::unique(bins.begin(), bins.end()), bins.end());
+    for(size_t n = 0; n < bins.size(); n++)
+        times.push_back(tmin + (bins[n] + 0.5) * interval);
+    long len = (long)times.size();
+    std::vector<double> sums((size_t)nbaselines * len * 3, 0.0);
+    for(int r = 0; r < table->count(); r++)
+    {
+        if(table->getFlags()[r])continue;
+        long bin = (long)floor((table->getTime()[r] - tmin) / interval);
+        long x = std::lower_bound(bins.begin(), bins.end(), bin) - bins.begin();
+        double *s = &sums[((long)table->getBaseline()[r] * len + x) * 3];
+        double wt = table->getWeight()[r];
+        s[0] += wt * table->getVisibility()[r][0];
+        s[1] += wt * table->getVisibility()[r][1];
+        s[2] += wt;
+    }
+    phase.resize((size_t)nbaselines * len);
+    amplitude.resize((size_t)nbaselines * len);
+    for(long x = 0; x < nbaselines * len; x++)
+    {
+        double *s = &sums[x * 3];
+        phase[x] = (s[2] > 0.0 ? atan2(s[1], s[0]) : NAN);
+        amplitude[x] = (s[2] > 0.0 ? sqrt(s[0] * s[0] + s[1] * s[1]) / s[2] : NAN);
+    }
+    for(int i = 0; i < stations; i++)
+    {
+        for(int j = i + 1; j < stations; j++)
+        {
+            if(!getEdge(i, j))continue;
+            for(int k = j + 1; k < stations; k++)
+            {
+                if(getEdge(j, k) && getEdge(i, k))
+                {
+                    triangles.push_back(i);
+                    triangles.push_back(j);
+                    triangles.push_back(k);
+                }
+                for(int l = k + 1; l < stations; l++)
+                {
+                    if(!getEdge(i, k) || !getEdge(i, l) || !getEdge(j, k) || !getEdge(j, l) || !getEdge(k, l))
+                        continue;
+                    int quadrangle[8] = { i, j, k, l, i, l, k, j };
+                    quadrangles.insert(quadrangles.end(), quadrangle, quadrangle + 8);
+                }
+            }
+        }
+    }
+    phases.resize((size_t)getTrianglesCount() * len);
+    amplitudes.resize((size_t)getQuadranglesCount() * len);
+    run(closePhases, getTrianglesCount(), pool);
+    run(closeAmplitudes, getQuadranglesCount(), pool);
+    pgarb("%d closure phases and %d closure amplitudes over %ld snapshots\n", getTrianglesCount(), getQuadranglesCount(), len);
+    return (int)len;
+}
@@ -0,0 +1,75 @@
+/*  OpenVLBI - Open Source Very Long Baseline Interferometry
+*   Copyright © 2017-2023  Ilia Platone
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 2 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along
+*   with this program; if not, write to the Free Software Foundation, Inc.,
+*   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+#ifndef _CLOSURES_H
+#define _CLOSURES_H
+
+#include <vlbi.h>
+#include <vector>
+
+class VLBIThreadPool;
+class VLBIVisibilityTable;
+
+/**
+* Closure phases and closure amplitudes of the order-2 baselines of a visibility table.
+* The visibilities of each baseline are averaged once into snapshots, only the snapshots holding at least one
+* unflagged visibility are kept, so sparse tables do not allocate their empty time bins. Their phases and amplitudes are kept
+* as one contiguous array per baseline, so each triangle or quadrangle is a single pass over a few of those arrays.
+* The triangles and the quadrangles are split into blocks closed in parallel.
+*/
+class VLBIClosures
+{
+    public:
+        VLBIClosures();
+        ~VLBIClosures();
+        int compute(VLBIVisibilityTable *table, double interval, VLBIThreadPool *pool);
+        void clear();
+        inline int getSnapshotsCount() { return (int)times.size(); }
+        inline double *getTimes() { return times.data(); }
+        inline int getTrianglesCount() { return (int)triangles.size() / 3; }
+        inline int *getTriangles() { return triangles.data(); }
+        inline double *getPhases() { return phases.data(); }
+        inline int getQuadranglesCount() { return (int)quadrangles.size() / 4; }
+        inline int *getQuadrangles() { return quadrangles.data(); }
+        inline double *getAmplitudes() { return amplitudes.data(); }
+
+    private:
+        struct block
+        {
+            VLBIClosures *closures;
+            int start;
+            int end;
+        };
+        static void *closePhases(void *arg);
+        static void *closeAmplitudes(void *arg);
+        void run(void *(*func)(void*), int count, VLBIThreadPool *pool);
+        inline int getEdge(int p, int q) { return edges[p * stations + q]; }
+
+        int stations { 0 };
+        std::vector<int> edges;
+        std::vector<double> phase;
+        std::vector<double> amplitude;
+        std::vector<double> times;
+        std::vector<int> triangles;
+        std::vector<double> phases;
+        std::vector<int> quadrangles;
+        std::vector<double> amplitudes;
+};
+
+#endif //_CLOSURES_H
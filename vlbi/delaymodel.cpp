@@ -0,0 +1,264 @@
+/*  OpenVLBI - Open Source Very Long Baseline Interferometry
+*   Copyright © 2017-2023  Ilia Platone
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 2 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along
+*   with this program; if not, write to the Free Software Foundation, Inc.,
+*   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "delaymodel.h"
+#include "nodecollection.h"
+#include "baseline.h"
+
+VLBIDelayModel::VLBIDelayModel(NodeCollection *nodes)
+{
+    Nodes = nodes;
+}
+
+VLBIDelayModel::~VLBIDelayModel()
+{
+    clear();
+}
+
+void VLBIDelayModel::clear()
+{
+    for(int i = 0; i < stations && references != nullptr; i++)
+    {
+        if(references[i] == nullptr)
+            continue;
+        free(references[i]->getNodes());
+        delete references[i];
+    }
+    free(references);
+    free(nodes);
+    free(locations);
+    free(coefficients);
+    references = nullptr;
+    nodes = nullptr;
+    locations = nullptr;
+    coefficients = nullptr;
+    stations = 0;
+    intervals = 0;
+    station_residuals.clear();
+    valid = false;
+}
+
+void VLBIDelayModel::invalidate()
+{
+    valid = false;
+}
+
+int VLBIDelayModel::indexOf(VLBINode *node)
+{
+    for(int i = 0; i < stations; i++)
+    {
+        if(nodes[i] == node)
+            return i;
+    }
+    return -1;
+}
+
+bool VLBIDelayModel::isValid(double ra, double dec, double distance, double starttime, double endtime)
+{
+    if(!valid)
+        return false;
+    if(ra != Ra || dec != Dec || distance != Dist)
+        return false;
+    if(starttime < Start || endtime > End)
+        return false;
+    if(relative != Nodes->isRelative() || memcmp(&station, Nodes->stationLocation(), sizeof(dsp_location)))
+        return false;
+    if(stations != Nodes->count())
+        return false;
+    for(int i = 0; i < stations; i++)
+    {
+        if(nodes[i] != Nodes->at(i))
+            return false;
+        if(memcmp(&locations[i * 3], Nodes->at(i)->getLocation(), sizeof(double) * 3))
+            return false;
+    }
+    return true;
+}
+
+double VLBIDelayModel::getExactDelay(int index, double time, int sample)
+{
+    double uvw[3];
+    if(references[index] == nullptr)
+        return getResidual(index, time);
+    if(sample < 0)
+    {
+        references[index]->getProjection(time, uvw);
+    }
+    else
+    {
+        double *pair[2] = { nodes[0]->getLocation(sample), nodes[index]->getLocation(sample) };
+        references[index]->getProjection(time, uvw, pair);
+    }
+    return uvw[2] + getResidual(index, time);
+}
+
+double VLBIDelayModel::getResidual(int index, double time)
+{
+    if(station_residuals.empty())
+        return 0.0;
+    residual *r = &station_residuals[index];
+    return r->delay + r->rate * (time - r->epoch);
+}
+
+void VLBIDelayModel::addResidual(const char *node, double delay, double rate, double epoch)
+{
+    std::map<std::string, residual>::iterator it = residuals.find(node);
+    if(it != residuals.end())
+    {
+        delay += it->second.delay + it->second.rate * (epoch - it->second.epoch);
+        rate += it->second.rate;
+    }
+    residual r = { delay, rate, epoch };
+    residuals[node] = r;
+    invalidate();
+}
+
+void VLBIDelayModel::clearResiduals()
+{
+    residuals.clear();
+    invalidate();
+}
+
+void VLBIDelayModel::copyResiduals(VLBIDelayModel *model)
+{
+    residuals = model->residuals;
+    invalidate();
+}
+
+void VLBIDelayModel::update(double ra, double dec, double distance, double starttime, double endtime)
+{
+    if(isValid(ra, dec, distance, starttime, endtime))
+        return;
+    clear();
+    Ra = ra;
+    Dec = dec;
+    Dist = distance;
+    Start = starttime;
+    relative = Nodes->isRelative();
+    memcpy(&station, Nodes->stationLocation(), sizeof(dsp_location));
+    stations = (int)Nodes->count();
+    if(stations < 1)
+        return;
+    intervals = (int)Max(1.0, ceil((endtime - starttime) / interval));
+    End = Start + intervals * interval;
+    nodes = (VLBINode**)malloc(sizeof(VLBINode*) * (size_t)stations);
+    locations = (double*)malloc(sizeof(double) * 3 * (size_t)stations);
+    references = (VLBIBaseline**)malloc(sizeof(VLBIBaseline*) * (size_t)stations);
+    coefficients = (double*)malloc(sizeof(double) * 4 * (size_t)(stations * intervals));
+    for(int i = 0; i < stations; i++)
+    {
+        nodes[i] = Nodes->at(i);
+        memcpy(&locations[i * 3], nodes[i]->getLocation(), sizeof(double) * 3);
+        references[i] = nullptr;
+        if(!residuals.empty())
+        {
+            residual zero = { 0.0, 0.0, 0.0 };
+            std::map<std::string, residual>::iterator it = residuals.find(nodes[i]->getName());
+            station_residuals.push_back(it == residuals.end() ? zero : it->second);
+        }
+        if(i == 0)
+            continue;
+        VLBINode **pair = (VLBINode**)malloc(sizeof(VLBINode*) * 2);
+        pair[0] = Nodes->at(0);
+        pair[1] = Nodes->at(i);
+        references[i] = new VLBIBaseline(pair, 2);
+        references[i]->setRelative(relative);
+        memcpy(references[i]->stationLocation(), &station, sizeof(dsp_location));
+        references[i]->setRa(Ra);
+        references[i]->setDec(Dec);
+        references[i]->setDistance(Dist);
+    }
+    double h = interval / 100.0;
+    double *delay = (double*)malloc(sizeof(double) * (size_t)(intervals + 1));
+    double *rate = (double*)malloc(sizeof(double) * (size_t)(intervals + 1));
+    for(int i = 0; i < stations; i++)
+    {
+        for(int k = 0; k <= intervals; k++)
+        {
+            double t = Start + k * interval;
+            delay[k] = getExactDelay(i, t);
+            rate[k] = (getExactDelay(i, t + h) - getExactDelay(i, t - h)) / (2.0 * h);
+        }
+        for(int k = 0; k < intervals; k++)
+        {
+            double *c = &coefficients[(i * intervals + k) * 4];
+            double p0 = delay[k];
+            double p1 = delay[k + 1];
+            double m0 = rate[k] * interval;
+            double m1 = rate[k + 1] * interval;
+            c[0] = p0;
+            c[1] = m0;
+            c[2] = 3.0 * (p1 - p0) - 2.0 * m0 - m1;
+            c[3] = 2.0 * (p0 - p1) + m0 + m1;
+        }
+    }
+    free(delay);
+    free(rate);
+    valid = true;
+    pgarb("delay model: %d stations, %d intervals of %lf seconds\n", stations, intervals, interval);
+}
+
+double *VLBIDelayModel::getCoefficients(int index, double time, double *x)
+{
+    int k = (int)floor((time - Start) / interval);
+    k = Max(0, Min(intervals - 1, k));
+    *x = (time - Start) / interval - k;
+    return &coefficients[(index * intervals + k) * 4];
+}
+
+double VLBIDelayModel::getDelay(int index, double time)
+{
+    if(index < 0 || index >= stations || intervals < 1)
+        return 0.0;
+    double x;
+    double *c = getCoefficients(index, time, &x);
+    return ((c[3] * x + c[2]) * x + c[1]) * x + c[0];
+}
+
+double VLBIDelayModel::getDelayRate(int index, double time)
+{
+    if(index < 0 || index >= stations || intervals < 1)
+        return 0.0;
+    double x;
+    double *c = getCoefficients(index, time, &x);
+    return ((3.0 * c[3] * x + 2.0 * c[2]) * x + c[1]) / interval;
+}
+
+void VLBIDelayModel::getOffsets(double time, double *offsets)
+{
+    double max_delay = -DBL_MAX;
+    for(int i = 0; i < stations; i++)
+    {
+        offsets[i] = getDelay(i, time);
+        max_delay = fmax(max_delay, offsets[i]);
+    }
+    for(int i = 0; i < stations; i++)
+        offsets[i] = max_delay - offsets[i];
+}
+
+void VLBIDelayModel::getExactOffsets(double time, double *offsets, int sample)
+{
+    double max_delay = -DBL_MAX;
+    for(int i = 0; i < stations; i++)
+    {
+        offsets[i] = getExactDelay(i, time, sample);
+        max_delay = fmax(max_delay, offsets[i]);
+    }
+    for(int i = 0; i < stations; i++)
+        offsets[i] = max_delay - offsets[i];
+}
@@ -0,0 +1,90 @@
+/*  OpenVLBI - Open Source Very Long Baseline Interferometry
+*   Copyright © 2017-2023  Ilia Platone
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 2 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along
+*   with this program; if not, write to the Free Software Foundation, Inc.,
+*   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#ifndef _DELAYMODEL_H
+#define _DELAYMODEL_H
+
+#include <vlbi.h>
+#include <map>
+#include <string>
+#include <vector>
+
+class NodeCollection;
+class VLBINode;
+class VLBIBaseline;
+
+/**
+* Per-station geometric delay polynomials, fitted on a coarse time grid.
+* Each interval holds a cubic that matches the exact delay and delay rate of the station
+* at both its ends, the delay of a station is referred to the first node of the collection.
+* A residual delay and delay rate, found by fringe fitting, can be added to each station by node name,
+* residuals are kept across updates of the polynomials.
+*/
+class VLBIDelayModel
+{
+    public:
+        VLBIDelayModel(NodeCollection *nodes);
+        ~VLBIDelayModel();
+        void invalidate();
+        void update(double ra, double dec, double distance, double starttime, double endtime);
+        int indexOf(VLBINode *node);
+        double getDelay(int index, double time);
+        double getDelayRate(int index, double time);
+        void getOffsets(double time, double *offsets);
+        void getExactOffsets(double time, double *offsets, int sample = -1);
+        inline int count() { return stations; }
+        inline double getInterval() { return interval; }
+        inline void setInterval(double seconds) { interval = seconds; invalidate(); }
+        void addResidual(const char *node, double delay, double rate, double epoch);
+        void clearResiduals();
+        void copyResiduals(VLBIDelayModel *model);
+
+    private:
+        struct residual
+        {
+            double delay;
+            double rate;
+            double epoch;
+        };
+        double getResidual(int index, double time);
+        bool isValid(double ra, double dec, double distance, double starttime, double endtime);
+        double getExactDelay(int index, double time, int sample = -1);
+        double *getCoefficients(int index, double time, double *x);
+        void clear();
+
+        NodeCollection *Nodes;
+        VLBINode **nodes { nullptr };
+        VLBIBaseline **references { nullptr };
+        double *locations { nullptr };
+        double *coefficients { nullptr };
+        int stations { 0 };
+        int intervals { 0 };
+        double interval { 60.0 };
+        double Ra { 0 };
+        double Dec { 0 };
+        double Dist { 0 };
+        double Start { 0 };
+        double End { 0 };
+        bool relative { false };
+        dsp_location station;
+        bool valid { false };
+        std::map<std::string, residual> residuals;
+        std::vector<residual> station_residuals;
+};
+
+#endif //_DELAYMODEL_H
@@ -64,117 +64,342 @@ static int f_scansexa(const char *str0, /* input string */
     return (0);
 }
 
-dsp_stream_p * vlbi_file_read_sdfits(char * filename, long *n)
+enum
 {
-    long nrows = 0;
-    long dim;
-    long dims, *sizes;
-    int typecode = 0;
+    sdfits_ra = 0,
+    sdfits_dec,
+    sdfits_freq,
+    sdfits_lat,
+    sdfits_lon,
+    sdfits_el,
+    sdfits_date,
+    sdfits_exposure,
+    sdfits_time,
+    sdfits_data,
+    sdfits_ncolumns,
+    sdfits_max_dims = 5,
+};
+
+static const long sdfits_batch_rows = 1024;
+
+struct vlbi_sdfits_file
+{
+    fitsfile *fptr;
+    long nrows;
+    long next;
+    int columns[sdfits_ncolumns];
+    long widths[sdfits_ncolumns];
+    int typecode;
+    long repeat;
+    int dims;
+    long sizes[sdfits_max_dims];
+    void *membuf;
+    size_t memsize;
+};
+
+struct vlbi_sdfits_batch
+{
+    dsp_stream_p *stream;
+    long start;
+    long end;
+    int complex;
+    long repeat;
+    char **strings[sdfits_ncolumns];
+    double *values[sdfits_ncolumns];
+    double *data;
+};
+
+static void *decode_sdfits_rows(void *arg)
+{
+    struct vlbi_sdfits_batch *batch = (struct vlbi_sdfits_batch*)arg;
+    long r;
+    for(r = batch->start; r < batch->end; r++)
+    {
+        dsp_stream_p stream = batch->stream[r];
+        char date[32];
+        if(batch->strings[sdfits_ra] != NULL)
+            f_scansexa(batch->strings[sdfits_ra][r], &stream->target[0]);
+        if(batch->strings[sdfits_dec] != NULL)
+            f_scansexa(batch->strings[sdfits_dec][r], &stream->target[1]);
+        if(batch->values[sdfits_freq] != NULL)
+            stream->wavelength = vlbi_astro_mean_speed(0) / batch->values[sdfits_freq][r];
+        if(batch->values[sdfits_lat] != NULL)
+            stream->location[0].geographic.lat = batch->values[sdfits_lat][r];
+        if(batch->values[sdfits_lon] != NULL)
+            stream->location[0].geographic.lon = batch->values[sdfits_lon][r];
+        if(batch->values[sdfits_el] != NULL)
+            stream->location[0].geographic.el = batch->values[sdfits_el][r];
+        if(batch->strings[sdfits_date] != NULL)
+        {
+            strcpy(date, "0000-01-01T00:00:00");
+            memcpy(date, batch->strings[sdfits_date][r], Min(strlen(batch->strings[sdfits_date][r]), sizeof(date) - 1));
+            stream->starttimeutc = vlbi_time_string_to_timespec(date);
+        }
+        double exposure = (batch->values[sdfits_exposure] != NULL ? batch->values[sdfits_exposure][r] : 0.0);
+        if(batch->values[sdfits_time] != NULL)
+        {
+            double time = batch->values[sdfits_time][r] - exposure / 2.0;
+            double nsec = stream->starttimeutc.tv_nsec + (time - floor(time)) * 1000000000.0;
+            stream->starttimeutc.tv_sec += (time_t)floor(time) + (time_t)floor(nsec / 1000000000.0);
+            stream->starttimeutc.tv_nsec = (long)fmod(nsec, 1000000000.0);
+        }
+        if(exposure > 0.0)
+            stream->samplerate = stream->len / exposure;
+        if(batch->complex)
+            dsp_buffer_copy((&batch->data[r * batch->repeat * 2]), stream->dft.buf, stream->len * 2);
+        else
+            dsp_buffer_copy((&batch->data[r * batch->repeat]), stream->buf, stream->len);
+    }
+    return NULL;
+}
+
+static void *vlbi_file_init_sdfits(struct vlbi_sdfits_file *sdfits, long *n)
+{
+    const char *names[sdfits_ncolumns] =
+    {
+        SDFITS_COLUMN_OBJCTRA.name,
+        SDFITS_COLUMN_OBJCTDEC.name,
+        SDFITS_COLUMN_OBSFREQ.name,
+        SDFITS_COLUMN_SITELAT.name,
+        SDFITS_COLUMN_SITELONG.name,
+        SDFITS_COLUMN_SITEELEV.name,
+        SDFITS_COLUMN_DATE_OBS.name,
+        SDFITS_COLUMN_EXPOSURE.name,
+        SDFITS_COLUMN_TIME.name,
+        SDFITS_COLUMN_DATA.name,
+    };
+    int status = 0;
+    int c;
     long width = 0;
-    long repeat = 0;
-    int r = 0;
-    dsp_fits_row *rows = dsp_fits_read_sdfits(filename, &nrows, &dims, &sizes);
-    dsp_stream_p *stream = (dsp_stream_p*)malloc(sizeof(dsp_stream_p) * (size_t)nrows);
-    for(r = 0; r < nrows; r++)
+    char error_status[64];
+
+    fits_movnam_hdu(sdfits->fptr, BINARY_TBL, FITS_TABLE_SDFITS, 0, &status);
+    if(status)
     {
-        stream[r] = dsp_stream_new();
-        int k = 0;
-        dsp_fits_row row = rows[r];
-        char * ra_str = SDFITS_COLUMN_OBJCTRA.name;
-        char * dec_str = SDFITS_COLUMN_OBJCTDEC.name;
-        char * freq_str = SDFITS_COLUMN_OBSFREQ.name;
-        char * lat_str = SDFITS_COLUMN_SITELAT.name;
-        char * lon_str = SDFITS_COLUMN_SITELONG.name;
-        char * el_str = SDFITS_COLUMN_SITEELEV.name;
-        char * date_str = SDFITS_COLUMN_DATE_OBS.name;
-        char * exposure_str = SDFITS_COLUMN_EXPOSURE.name;
-        char * time_str = SDFITS_COLUMN_TIME.name;
-        char * data_str = SDFITS_COLUMN_DATA.name;
-        for(k = 0; strcmp(ra_str, row.columns[k].name); k++);
-        f_scansexa(row.columns[k].value, &stream[r]->target[0]);
-        for(k = 0; strcmp(dec_str, row.columns[k].name); k++);
-        f_scansexa(row.columns[k].value, &stream[r]->target[1]);
-        for(k = 0; strcmp(freq_str, row.columns[k].name); k++);
-        stream[r]->wavelength = *((double*)row.columns[k].value);
-        stream[r]->wavelength = vlbi_astro_mean_speed(0) / stream[r]->wavelength;
-        for(k = 0; strcmp(lat_str, row.columns[k].name); k++);
-        stream[r]->location[0].geographic.lat = *((double*)row.columns[k].value);
-        for(k = 0; strcmp(lon_str, row.columns[k].name); k++);
-        stream[r]->location[0].geographic.lon = *((double*)row.columns[k].value);
-        for(k = 0; strcmp(el_str, row.columns[k].name); k++);
-        stream[r]->location[0].geographic.el = *((double*)row.columns[k].value);
-        for(k = 0; strcmp(date_str, row.columns[k].name); k++);
-        stream[r]->starttimeutc = vlbi_time_string_to_timespec(row.columns[k].value);
-        for(k = 0; strcmp(exposure_str, row.columns[k].name); k++);
-        stream[r]->samplerate = *((double*)row.columns[k].value);
-        for(k = 0; strcmp(time_str, row.columns[k].name); k++);
-        double time = (long) * ((double*)row.columns[k].value);
-        time -= stream[r]->samplerate / 2.0;
-        stream[r]->starttimeutc.tv_sec += (long)time;
-        stream[r]->starttimeutc.tv_nsec += (long)((time - stream[r]->starttimeutc.tv_sec) * 1000000000);
-
-        for(k = 0; strcmp(data_str, row.columns[k].name); k++);
-
-        dsp_fits_read_typecode(row.columns[k].format, &typecode, &width, &repeat);
-        dsp_stream_add_dim(stream[r], (int)width);
-        dsp_stream_add_dim(stream[r], (int)repeat);
-        for(dim = 0; dim < dims; dim++)
+        goto fail_fptr;
+    }
+
+    fits_get_num_rows(sdfits->fptr, &sdfits->nrows, &status);
+    if(status)
+    {
+        goto fail_fptr;
+    }
+
+    for(c = 0; c < sdfits_ncolumns; c++)
+    {
+        int typecode = 0;
+        long repeat = 0;
+        fits_get_colnum(sdfits->fptr, CASEINSEN, (char*)names[c], &sdfits->columns[c], &status);
+        if(status)
         {
-            dsp_stream_add_dim(stream[r], (int)sizes[dim]);
+            sdfits->columns[c] = 0;
+            status = 0;
+            continue;
         }
-        dsp_stream_alloc_buffer(stream[r], stream[r]->len);
+        fits_get_coltype(sdfits->fptr, sdfits->columns[c], &typecode, &repeat, &width, &status);
+        sdfits->widths[c] = repeat;
+    }
+    if(status || sdfits->columns[sdfits_data] == 0)
+    {
+        goto fail_fptr;
+    }
+
+    fits_get_eqcoltype(sdfits->fptr, sdfits->columns[sdfits_data], &sdfits->typecode, &sdfits->repeat, &width, &status);
+    if(status || sdfits->typecode < 0 || sdfits->typecode == TSTRING || sdfits->repeat < 1)
+    {
+        goto fail_fptr;
+    }
+
+    fits_read_tdim(sdfits->fptr, sdfits->columns[sdfits_data], sdfits_max_dims, &sdfits->dims, sdfits->sizes, &status);
+    if(status || sdfits->dims < 1)
+    {
+        status = 0;
+        sdfits->dims = 1;
+        sdfits->sizes[0] = sdfits->repeat;
+    }
+
+    *n = sdfits->nrows;
+    return sdfits;
+fail_fptr:
+    if(status)
+    {
+        fits_get_errstatus(status, error_status);
+        perr("FITS Error: %s\n", error_status);
+    }
+    status = 0;
+    fits_close_file(sdfits->fptr, &status);
+    free(sdfits);
+    *n = 0;
+    return NULL;
+}
+
+void *vlbi_file_open_sdfits(char *filename, long *n)
+{
+    struct vlbi_sdfits_file *sdfits = (struct vlbi_sdfits_file*)malloc(sizeof(struct vlbi_sdfits_file));
+    int status = 0;
+    char error_status[64];
+    memset(sdfits, 0, sizeof(struct vlbi_sdfits_file));
+
+    fits_open_file(&sdfits->fptr, filename, READONLY, &status);
+    if(status)
+    {
+        fits_get_errstatus(status, error_status);
+        perr("FITS Error: %s\n", error_status);
+        free(sdfits);
+        *n = 0;
+        return NULL;
+    }
+    return vlbi_file_init_sdfits(sdfits, n);
+}
+
+void *vlbi_file_open_sdfits_memory(void *buf, size_t len, long *n)
+{
+    struct vlbi_sdfits_file *sdfits = (struct vlbi_sdfits_file*)malloc(sizeof(struct vlbi_sdfits_file));
+    int status = 0;
+    char error_status[64];
+    memset(sdfits, 0, sizeof(struct vlbi_sdfits_file));
+    sdfits->membuf = buf;
+    sdfits->memsize = len;
 
-        stream[r]->samplerate /= stream[r]->len;
-        stream[r]->samplerate = 1.0 / stream[r]->samplerate;
-        switch(typecode)
+    fits_open_memfile(&sdfits->fptr, "memory", READONLY, &sdfits->membuf, &sdfits->memsize, 0, NULL, &status);
+    if(status)
+    {
+        fits_get_errstatus(status, error_status);
+        perr("FITS Error: %s\n", error_status);
+        free(sdfits);
+        *n = 0;
+        return NULL;
+    }
+    return vlbi_file_init_sdfits(sdfits, n);
+}
+
+dsp_stream_p *vlbi_file_read_sdfits_rows(void *sdfits_file, long max, long *n)
+{
+    struct vlbi_sdfits_file *sdfits = (struct vlbi_sdfits_file*)sdfits_file;
+    struct vlbi_sdfits_batch batch;
+    int status = 0;
+    int anynul = 0;
+    int c, t, dim;
+    long r;
+    char error_status[64];
+    *n = 0;
+    if(sdfits == NULL)
+        return NULL;
+    long nrows = Min(max, sdfits->nrows - sdfits->next);
+    if(nrows < 1)
+        return NULL;
+    long first = sdfits->next + 1;
+    memset(&batch, 0, sizeof(struct vlbi_sdfits_batch));
+    batch.complex = (sdfits->typecode == TCOMPLEX || sdfits->typecode == TDBLCOMPLEX);
+    batch.repeat = sdfits->repeat;
+    for(c = 0; c < sdfits_data; c++)
+    {
+        if(sdfits->columns[c] == 0)
+            continue;
+        if(c == sdfits_ra || c == sdfits_dec || c == sdfits_date)
+        {
+            batch.strings[c] = (char**)malloc(sizeof(char*) * (size_t)nrows);
+            batch.strings[c][0] = (char*)malloc((size_t)(sdfits->widths[c] + 1) * (size_t)nrows);
+            for(r = 1; r < nrows; r++)
+                batch.strings[c][r] = batch.strings[c][0] + r * (sdfits->widths[c] + 1);
+            fits_read_col(sdfits->fptr, TSTRING, sdfits->columns[c], first, 1, nrows, NULL, batch.strings[c], &anynul, &status);
+        }
+        else
+        {
+            batch.values[c] = (double*)malloc(sizeof(double) * (size_t)nrows);
+            fits_read_col(sdfits->fptr, TDOUBLE, sdfits->columns[c], first, 1, nrows, NULL, batch.values[c], &anynul, &status);
+        }
+    }
+    batch.data = (double*)malloc(sizeof(double) * (size_t)(nrows * sdfits->repeat * (batch.complex ? 2 : 1)));
+    fits_read_col(sdfits->fptr, (batch.complex ? TDBLCOMPLEX : TDOUBLE), sdfits->columns[sdfits_data], first, 1, nrows * sdfits->repeat, NULL, batch.data, &anynul, &status);
+    if(status)
+    {
+        fits_get_errstatus(status, error_status);
+        perr("FITS Error: %s\n", error_status);
+        nrows = 0;
+        goto end;
+    }
+    sdfits->next += nrows;
+
+    batch.stream = (dsp_stream_p*)malloc(sizeof(dsp_stream_p) * (size_t)nrows);
+    for(r = 0; r < nrows; r++)
+    {
+        batch.stream[r] = dsp_stream_new();
+        for(dim = 0; dim < sdfits->dims; dim++)
+            dsp_stream_add_dim(batch.stream[r], (int)sdfits->sizes[dim]);
+        dsp_stream_alloc_buffer(batch.stream[r], batch.stream[r]->len);
+    }
+    int nthreads = (int)Max(1, Min((long)vlbi_max_threads(0), nrows / 16));
+    pthread_t *th = (pthread_t*)malloc(sizeof(pthread_t) * (size_t)nthreads);
+    struct vlbi_sdfits_batch *stripes = (struct vlbi_sdfits_batch*)malloc(sizeof(struct vlbi_sdfits_batch) * (size_t)nthreads);
+    for(t = 0; t < nthreads; t++)
+    {
+        stripes[t] = batch;
+        stripes[t].start = nrows * t / nthreads;
+        stripes[t].end = nrows * (t + 1) / nthreads;
+        if(nthreads > 1)
+            pthread_create(&th[t], NULL, decode_sdfits_rows, &stripes[t]);
+        else
+            decode_sdfits_rows(&stripes[t]);
+    }
+    if(nthreads > 1)
+    {
+        for(t = 0; t < nthreads; t++)
+            pthread_join(th[t], NULL);
+    }
+    free(th);
+    free(stripes);
+end:
+    for(c = 0; c < sdfits_data; c++)
+    {
+        if(batch.strings[c] != NULL)
         {
-            case TBYTE:
-            case TSBYTE:
-            case TLOGICAL:
-                dsp_buffer_copy(((unsigned char*)row.columns[k].value), stream[r]->buf, stream[r]->len);
-                break;
-            case TSHORT:
-                dsp_buffer_copy(((short*)row.columns[k].value), stream[r]->buf, stream[r]->len);
-                break;
-            case TUSHORT:
-                dsp_buffer_copy(((unsigned short*)row.columns[k].value), stream[r]->buf, stream[r]->len);
-                break;
-            case TINT:
-                dsp_buffer_copy(((int*)row.columns[k].value), stream[r]->buf, stream[r]->len);
-                break;
-            case TUINT:
-                dsp_buffer_copy(((unsigned int*)row.columns[k].value), stream[r]->buf, stream[r]->len);
-                break;
-            case TLONG:
-                dsp_buffer_copy(((long*)row.columns[k].value), stream[r]->buf, stream[r]->len);
-                break;
-            case TULONG:
-                dsp_buffer_copy(((unsigned long*)row.columns[k].value), stream[r]->buf, stream[r]->len);
-                break;
-            case TFLOAT:
-                dsp_buffer_copy(((float*)row.columns[k].value), stream[r]->buf, stream[r]->len);
-                break;
-            case TDOUBLE:
-                dsp_buffer_copy(((double*)row.columns[k].value), stream[r]->buf, stream[r]->len);
-                break;
-            case TCOMPLEX:
-                dsp_buffer_copy(((float*)row.columns[k].value), stream[r]->dft.buf, stream[r]->len * 2);
-                break;
-            case TDBLCOMPLEX:
-                dsp_buffer_copy(((double*)row.columns[k].value), stream[r]->dft.buf, stream[r]->len * 2);
-                break;
-            default:
-                break;
+            free(batch.strings[c][0]);
+            free(batch.strings[c]);
         }
+        free(batch.values[c]);
     }
+    free(batch.data);
     *n = nrows;
+    return batch.stream;
+}
+
+void vlbi_file_close_sdfits(void *sdfits_file)
+{
+    struct vlbi_sdfits_file *sdfits = (struct vlbi_sdfits_file*)sdfits_file;
+    int status = 0;
+    if(sdfits == NULL)
+        return;
+    fits_close_file(sdfits->fptr, &status);
+    free(sdfits);
+}
+
+dsp_stream_p * vlbi_file_read_sdfits(char * filename, long *n)
+{
+    long nrows = 0;
+    long r = 0;
+    *n = 0;
+    void *sdfits = vlbi_file_open_sdfits(filename, &nrows);
+    if(sdfits == NULL)
+        return NULL;
+    dsp_stream_p *stream = (dsp_stream_p*)malloc(sizeof(dsp_stream_p) * (size_t)Max(1, nrows));
+    while(r < nrows)
+    {
+        long len = 0;
+        dsp_stream_p *rows = vlbi_file_read_sdfits_rows(sdfits, sdfits_batch_rows, &len);
+        if(rows == NULL || len < 1)
+            break;
+        memcpy(&stream[r], rows, sizeof(dsp_stream_p) * (size_t)len);
+        free(rows);
+        r += len;
+    }
+    vlbi_file_close_sdfits(sdfits);
+    *n = r;
     return stream;
 }
 
-dsp_stream_p vlbi_file_read_fits(char *filename)
+static dsp_stream_p vlbi_file_read_fits_fptr(fitsfile *fptr)
 {
-    fitsfile *fptr = (fitsfile*)malloc(sizeof(fitsfile));
-    memset(fptr, 0, sizeof(fitsfile));
     int bpp = 16;
     int status = 0;
     char value[150];
@@ -187,23 +412,16 @@ dsp_stream_p vlbi_file_read_fits(char *filename)
     int anynul = 0;
     void *array = NULL;
 
-    fits_open_file(&fptr, filename, READONLY, &status);
-
-    if (status)
-    {
-        goto fail;
-    }
-
     fits_movabs_hdu(fptr, 1, IMAGE_HDU, &status);
     if(status)
     {
-        goto fail;
+        goto fail_fptr;
     }
 
     fits_get_img_param(fptr, 3, &bpp, &dims, naxes, &status);
     if(status)
     {
-        goto fail;
+        goto fail_fptr;
     }
 
     for(dim = 0; dim < dims; dim++)
@@ -251,7 +469,7 @@ dsp_stream_p vlbi_file_read_fits(char *filename)
     }
     free(array);
     if(status || anynul)
-        goto fail;
+        goto fail_fptr;
 
     ffgkey(fptr, "EPOCH", value, comment, &status);
     if (!status)
@@ -317,11 +535,53 @@ dsp_stream_p vlbi_file_read_fits(char *filename)
     if(status)
         goto fail;
     return stream;
+fail_fptr:
+    if(status)
+    {
+        fits_get_errstatus(status, error_status);
+        perr("FITS Error: %s\n", error_status);
+    }
+    status = 0;
+    fits_close_file(fptr, &status);
 fail:
     if(status)
     {
         fits_get_errstatus(status, error_status);
         perr("FITS Error: %s\n", error_status);
     }
+    dsp_stream_free_buffer(stream);
+    dsp_stream_free(stream);
     return NULL;
 }
+
+dsp_stream_p vlbi_file_read_fits(char *filename)
+{
+    fitsfile *fptr = NULL;
+    int status = 0;
+    char error_status[64];
+
+    fits_open_file(&fptr, filename, READONLY, &status);
+    if(status)
+    {
+        fits_get_errstatus(status, error_status);
+        perr("FITS Error: %s\n", error_status);
+        return NULL;
+    }
+    return vlbi_file_read_fits_fptr(fptr);
+}
+
+dsp_stream_p vlbi_file_read_fits_memory(void *buf, size_t len)
+{
+    fitsfile *fptr = NULL;
+    int status = 0;
+    char error_status[64];
+
+    fits_open_memfile(&fptr, "memory", READONLY, &buf, &len, 0, NULL, &status);
+    if(status)
+    {
+        fits_get_errstatus(status, error_status);
+        perr("FITS Error: %s\n", error_status);
+        return NULL;
+    }
+    return vlbi_file_read_fits_fptr(fptr);
+}
@@ -0,0 +1,249 @@
+/*  OpenVLBI - Open Source Very Long Baseline Interferometry
+*   Copyright © 2017-2023  Ilia Platone
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 2 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along
+*   with this program; if not, write to the Free Software Foundation, Inc.,
+*   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "fringe.h"
+#include "threadpool.h"
+#include "nodecollection.h"
+#include "baselinecollection.h"
+#include "delaymodel.h"
+#include "baseline.h"
+#include <map>
+
+VLBIFringeSearch::VLBIFringeSearch(VLBIThreadPool *pool)
+{
+    Pool = pool;
+}
+
+VLBIFringeSearch::~VLBIFringeSearch()
+{
+}
+
+double VLBIFringeSearch::interpolate(double before, double peak, double after)
+{
+    double den = before - 2.0 * peak + after;
+    if(den >= 0.0)
+        return 0.0;
+    return Max(-0.5, Min(0.5, 0.5 * (before - after) / den));
+}
+
+void *VLBIFringeSearch::searchBaseline(void *arg)
+{
+    fringe *f = (fringe*)arg;
+    VLBIBaseline *b = f->b;
+    dsp_stream_p stream = b->getStream();
+    int nc = stream->sizes[0];
+    int nt = stream->sizes[1];
+    int channels = f->channels;
+    int integrations = f->integrations;
+    long len = (long)channels * integrations;
+    fftw_complex *buf = fftw_alloc_complex((size_t)len);
+    double *mag = (double*)malloc(sizeof(double) * (size_t)len);
+    for(long x = 0; x < len; x++)
+    {
+        buf[x][0] = 0.0;
+        buf[x][1] = 0.0;
+    }
+    for(int t = 0; t < nt; t++)
+    {
+        for(int c = 0; c < nc; c++)
+        {
+            buf[(long)t * channels + c][0] = stream->dft.pairs[t * nc + c][0];
+            buf[(long)t * channels + c][1] = stream->dft.pairs[t * nc + c][1];
+        }
+    }
+    fftw_execute_dft(f->plan, buf, buf);
+    double sum = 0.0;
+    for(long x = 0; x < len; x++)
+    {
+        mag[x] = sqrt(buf[x][0] * buf[x][0] + buf[x][1] * buf[x][1]);
+        sum += mag[x] * mag[x];
+    }
+    fftw_free(buf);
+    int peak = vlbi_block_find_peak(mag, (int)len);
+    if(peak < 0 || *f->stop)
+    {
+        free(mag);
+        b->setFringe(0.0, 0.0, 0.0);
+        return nullptr;
+    }
+    int kc = peak % channels;
+    int kt = peak / channels;
+    double *row = &mag[(long)kt * channels];
+    double dc = interpolate(row[(kc + channels - 1) % channels], row[kc], row[(kc + 1) % channels]);
+    double dt = interpolate(mag[(long)((kt + integrations - 1) % integrations) * channels + kc], row[kc],
+                            mag[(long)((kt + 1) % integrations) * channels + kc]);
+    double rms = sqrt(sum / len);
+    double snr = (rms > 0.0 ? row[kc] / rms : 0.0);
+    free(mag);
+    double c = kc + dc;
+    double t = kt + dt;
+    if(c > channels / 2)
+        c -= channels;
+    if(t > integrations / 2)
+        t -= integrations;
+    double bandwidth = b->getNode(0)->getSampleRate() / 2.0;
+    double delay = c / (channels * bandwidth / nc);
+    double rate = t * stream->samplerate / integrations;
+    b->setFringe(delay, (f->freq > 0.0 ? rate / f->freq : 0.0), snr);
+    pgarb("%s: residual delay %lf s, rate %lf s/s, SNR %lf\n", b->getName(), b->getFringeDelay(), b->getFringeRate(), snr);
+    return nullptr;
+}
+
+int VLBIFringeSearch::search(NodeCollection *nodes, double freq, int *interrupt)
+{
+    pfunc;
+    BaselineCollection *baselines = nodes->getBaselines();
+    int stop = 0;
+    std::map<std::pair<int, int>, fftw_plan> plans;
+    std::vector<fringe> jobs;
+    for(int i = 0; i < baselines->count(); i++)
+    {
+        VLBIBaseline *b = baselines->at(i);
+        b->setFringe(0.0, 0.0, 0.0);
+        dsp_stream_p stream = b->getStream();
+        if(b->getNodesCount() != 2 || stream->dims < 2 || stream->dft.pairs == nullptr)
+            continue;
+        if(stream->samplerate <= 0.0 || b->getNode(0)->getSampleRate() <= 0.0)
+            continue;
+        fringe f;
+        f.b = b;
+        f.channels = stream->sizes[0] * oversampling;
+        f.integrations = stream->sizes[1] * oversampling;
+        f.freq = freq;
+        f.stop = (interrupt != nullptr ? interrupt : &stop);
+        std::pair<int, int> size(f.integrations, f.channels);
+        if(plans.find(size) == plans.end())
+        {
+            fftw_complex *buf = fftw_alloc_complex((size_t)f.channels * f.integrations);
+            plans[size] = fftw_plan_dft_2d(f.integrations, f.channels, buf, buf, FFTW_FORWARD, FFTW_ESTIMATE);
+            fftw_free(buf);
+        }
+        f.plan = plans[size];
+        jobs.push_back(f);
+    }
+    std::atomic<int> pending(0);
+    for(size_t j = 0; j < jobs.size(); j++)
+        Pool->push(searchBaseline, &jobs[j], &pending);
+    Pool->wait(&pending);
+    for(std::map<std::pair<int, int>, fftw_plan>::iterator it = plans.begin(); it != plans.end(); it++)
+        fftw_destroy_plan(it->second);
+    return (int)jobs.size();
+}
+
+void VLBIFringeSearch::solve(NodeCollection *nodes, double snr)
+{
+    pfunc;
+    BaselineCollection *baselines = nodes->getBaselines();
+    int n = nodes->count() - 1;
+    if(n < 1)
+        return;
+    std::vector<double> a((size_t)n * n, 0.0);
+    std::vector<double> d((size_t)n, 0.0);
+    std::vector<double> r((size_t)n, 0.0);
+    double epoch = 0.0;
+    double wsum = 0.0;
+    for(int i = 0; i < baselines->count(); i++)
+    {
+        VLBIBaseline *b = baselines->at(i);
+        if(b->getNodesCount() != 2 || b->getFringeSNR() <= 0.0 || b->getFringeSNR() < snr)
+            continue;
+        int p = -1;
+        int q = -1;
+        for(int x = 0; x < nodes->count(); x++)
+        {
+            if(nodes->at(x) == b->getNode(0))
+                p = x - 1;
+            if(nodes->at(x) == b->getNode(1))
+                q = x - 1;
+        }
+        if(p == q)
+            continue;
+        double w = b->getFringeSNR() * b->getFringeSNR();
+        if(p >= 0)
+        {
+            a[p * n + p] += w;
+            d[p] += w * b->getFringeDelay();
+            r[p] += w * b->getFringeRate();
+        }
+        if(q >= 0)
+        {
+            a[q * n + q] += w;
+            d[q] -= w * b->getFringeDelay();
+            r[q] -= w * b->getFringeRate();
+        }
+        if(p >= 0 && q >= 0)
+        {
+            a[p * n + q] -= w;
+            a[q * n + p] -= w;
+        }
+        epoch += w * (b->getStartTime() + b->getStream()->sizes[1] / b->getStream()->samplerate / 2.0);
+        wsum += w;
+    }
+    if(wsum <= 0.0)
+        return;
+    epoch /= wsum;
+    for(int k = 0; k < n; k++)
+    {
+        int pivot = k;
+        for(int i = k + 1; i < n; i++)
+        {
+            if(fabs(a[i * n + k]) > fabs(a[pivot * n + k]))
+                pivot = i;
+        }
+        if(fabs(a[pivot * n + k]) <= 0.0)
+            continue;
+        if(pivot != k)
+        {
+            for(int j = 0; j < n; j++)
+                std::swap(a[k * n + j], a[pivot * n + j]);
+            std::swap(d[k], d[pivot]);
+            std::swap(r[k], r[pivot]);
+        }
+        for(int i = k + 1; i < n; i++)
+        {
+            double f = a[i * n + k] / a[k * n + k];
+            if(f == 0.0)
+                continue;
+            for(int j = k; j < n; j++)
+                a[i * n + j] -= f * a[k * n + j];
+            d[i] -= f * d[k];
+            r[i] -= f * r[k];
+        }
+    }
+    for(int k = n - 1; k >= 0; k--)
+    {
+        if(fabs(a[k * n + k]) <= 0.0)
+        {
+            d[k] = 0.0;
+            r[k] = 0.0;
+            continue;
+        }
+        for(int j = k + 1; j < n; j++)
+        {
+            d[k] -= a[k * n + j] * d[j];
+            r[k] -= a[k * n + j] * r[j];
+        }
+        d[k] /= a[k * n + k];
+        r[k] /= a[k * n + k];
+    }
+    for(int k = 0; k < n; k++)
+    {
+        if(d[k] != 0.0 || r[k] != 0.0)
+            nodes->getDelayModel()->addResidual(nodes->at(k + 1)->getName(), d[k], r[k], epoch);
+    }
+}
@@ -0,0 +1,64 @@
+/*  OpenVLBI - Open Source Very Long Baseline Interferometry
+*   Copyright © 2017-2023  Ilia Platone
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 2 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along
+*   with this program; if not, write to the Free Software Foundation, Inc.,
+*   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+#ifndef _FRINGE_H
+#define _FRINGE_H
+
+#include <vlbi.h>
+#include <fftw3.h>
+#include <vector>
+
+class VLBIThreadPool;
+class VLBIBaseline;
+class NodeCollection;
+
+/**
+* Fringe search of the channelized visibilities left by the FX correlator into each baseline stream.
+* The channels by integrations plane of each baseline is zero padded and transformed in two dimensions,
+* the peak of the delay by fringe rate plane is refined by parabolic interpolation along both axes.
+* All baselines are searched in parallel, then the station residuals are solved by weighted least squares
+* referred to the first node and added to the delay model.
+*/
+class VLBIFringeSearch
+{
+    public:
+        VLBIFringeSearch(VLBIThreadPool *pool);
+        ~VLBIFringeSearch();
+        int search(NodeCollection *nodes, double freq, int *interrupt);
+        void solve(NodeCollection *nodes, double snr);
+        inline void setOversampling(int value) { oversampling = Max(1, value); }
+
+    private:
+        struct fringe
+        {
+            VLBIBaseline *b;
+            fftw_plan plan;
+            int channels;
+            int integrations;
+            double freq;
+            int *stop;
+        };
+        static void *searchBaseline(void *arg);
+        static double interpolate(double before, double peak, double after);
+
+        VLBIThreadPool *Pool;
+        int oversampling { 2 };
+};
+
+#endif //_FRINGE_H
@@ -0,0 +1,491 @@
+/*  OpenVLBI - Open Source Very Long Baseline Interferometry
+*   Copyright © 2017-2023  Ilia Platone
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 2 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along
+*   with this program; if not, write to the Free Software Foundation, Inc.,
+*   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "gridder.h"
+#include "threadpool.h"
+
+static double bessel_i0(double x)
+{
+    double sum = 1.0;
+    double term = 1.0;
+    double y = x * x / 4.0;
+    for(int k = 1; k < 500 && term > sum * 1E-16; k++)
+    {
+        term *= y / ((double)k * k);
+        sum += term;
+    }
+    return sum;
+}
+
+static double spheroidal(double nu)
+{
+    static const double p[2][5] =
+    {
+        { 8.203343e-2, -3.644705e-1, 6.278660e-1, -5.335581e-1, 2.312756e-1 },
+        { 4.028559e-3, -3.697768e-2, 1.021332e-1, -1.201436e-1, 6.412774e-2 },
+    };
+    static const double q[2][3] =
+    {
+        { 1.0, 8.212018e-1, 2.078043e-1 },
+        { 1.0, 9.599102e-1, 2.918724e-1 },
+    };
+    nu = fabs(nu);
+    if(nu > 1.0)
+        return 0.0;
+    int part = (nu < 0.75 ? 0 : 1);
+    double end = (nu < 0.75 ? 0.75 : 1.0);
+    double delnusq = nu * nu - end * end;
+    double top = 0.0;
+    double bot = 0.0;
+    for(int k = 4; k >= 0; k--)
+        top = top * delnusq + p[part][k];
+    for(int k = 2; k >= 0; k--)
+        bot = bot * delnusq + q[part][k];
+    return (bot > 0.0 ? top / bot : 0.0);
+}
+
+VLBIGridder::VLBIGridder()
+{
+    updateTable();
+}
+
+VLBIGridder::~VLBIGridder()
+{
+    table.clear();
+}
+
+void VLBIGridder::setKernel(vlbi_gridding_kernel kernel, int support, int oversampling)
+{
+    Kernel = kernel;
+    Support = (support < 1 ? 6 : support);
+    Oversampling = (oversampling < 1 ? 128 : oversampling);
+    tile_size = Max(64, Support * 4);
+    updateTable();
+}
+
+void VLBIGridder::setWeighting(vlbi_weighting_mode mode, double robust)
+{
+    Weighting = mode;
+    Robust = robust;
+}
+
+double VLBIGridder::evaluate(double nu)
+{
+    nu = fabs(nu);
+    if(nu > 1.0)
+        return 0.0;
+    switch(Kernel)
+    {
+        case vlbi_gridding_kaiser_bessel:
+        {
+            double beta = PI * sqrt(fmax(Support * Support / 4.0 - 0.8, 1.0));
+            return bessel_i0(beta * sqrt(1.0 - nu * nu)) / bessel_i0(beta);
+        }
+        case vlbi_gridding_prolate_spheroidal:
+            return (1.0 - nu * nu) * spheroidal(nu);
+        default:
+            break;
+    }
+    return (nu < 1.0 / Support ? 1.0 : 0.0);
+}
+
+void VLBIGridder::updateTable()
+{
+    double half = Support / 2.0;
+    int len = (int)(half * Oversampling) + 1;
+    table.resize((size_t)len);
+    for(int i = 0; i < len; i++)
+        table[i] = evaluate((double)i / Oversampling / half);
+    double peak = table[0];
+    for(int i = 0; i < len && peak > 0.0; i++)
+        table[i] /= peak;
+}
+
+void VLBIGridder::getWeights(std::vector<vlbi_uv_sample> *samples, int u, int v, double *weights)
+{
+    int len = (int)samples->size();
+    for(int k = 0; k < len; k++)
+        weights[k] = samples->at(k).weight;
+    if(Weighting == vlbi_weighting_natural)
+        return;
+    std::vector<double> density((size_t)u * v, 0.0);
+    std::vector<int> cells((size_t)len);
+    double sum = 0.0;
+    for(int k = 0; k < len; k++)
+    {
+        int x = Max(0, Min(u - 1, (int)round(samples->at(k).u + u / 2)));
+        int y = Max(0, Min(v - 1, (int)round(samples->at(k).v + v / 2)));
+        cells[k] = x + y * u;
+        density[cells[k]] += weights[k];
+        sum += weights[k];
+    }
+    if(Weighting == vlbi_weighting_uniform)
+    {
+        for(int k = 0; k < len; k++)
+            weights[k] = (density[cells[k]] > 0.0 ? weights[k] / density[cells[k]] : 0.0);
+        return;
+    }
+    double sum2 = 0.0;
+    for(size_t c = 0; c < density.size(); c++)
+        sum2 += density[c] * density[c];
+    double f2 = (sum2 > 0.0 ? pow(5.0 * pow(10.0, -Robust), 2) / (sum2 / sum) : 0.0);
+    for(int k = 0; k < len; k++)
+        weights[k] = weights[k] / (1.0 + density[cells[k]] * f2);
+}
+
+void *VLBIGridder::gridTile(void *arg)
+{
+    tile *t = (tile*)arg;
+    VLBIGridder *gridder = t->gridder;
+    double half = gridder->Support / 2.0;
+    std::vector<double> kx((size_t)gridder->Support + 2);
+    for(size_t n = 0; n < t->indexes.size(); n++)
+    {
+        int k = t->indexes[n];
+        vlbi_uv_sample *s = &t->samples->at(k);
+        double val = (t->imaginary ? s->imag : s->val) * t->weights[k];
+        double su = s->u + t->u / 2;
+        double sv = s->v + t->v / 2;
+        int x0 = Max(t->x0, (int)ceil(su - half));
+        int x1 = Min(t->x1 - 1, (int)floor(su + half));
+        int y0 = Max(t->y0, (int)ceil(sv - half));
+        int y1 = Min(t->y1 - 1, (int)floor(sv + half));
+        for(int x = x0; x <= x1; x++)
+            kx[x - x0] = gridder->lookup(x - su);
+        for(int y = y0; y <= y1; y++)
+        {
+            double ky = val * gridder->lookup(y - sv);
+            dsp_t *row = &t->plane[(long)y * t->u];
+            for(int x = x0; x <= x1; x++)
+                row[x] += ky * kx[x - x0];
+        }
+    }
+    return nullptr;
+}
+
+double VLBIGridder::convolve(std::vector<vlbi_uv_sample> *samples, double *weights, dsp_t *plane, int u, int v,
+                             VLBIThreadPool *pool, bool imaginary)
+{
+    dsp_buffer_set(plane, (long)u * v, 0.0);
+    int len = (int)samples->size();
+    double half = Support / 2.0;
+    int nx = (u + tile_size - 1) / tile_size;
+    int ny = (v + tile_size - 1) / tile_size;
+    std::vector<tile> tiles((size_t)nx * ny);
+    for(int ty = 0; ty < ny; ty++)
+    {
+        for(int tx = 0; tx < nx; tx++)
+        {
+            tile *t = &tiles[tx + ty * nx];
+            t->gridder = this;
+            t->samples = samples;
+            t->weights = weights;
+            t->plane = plane;
+            t->u = u;
+            t->v = v;
+            t->imaginary = imaginary;
+            t->x0 = tx * tile_size;
+            t->y0 = ty * tile_size;
+            t->x1 = Min(u, t->x0 + tile_size);
+            t->y1 = Min(v, t->y0 + tile_size);
+        }
+    }
+    double sum = 0.0;
+    for(int k = 0; k < len; k++)
+    {
+        vlbi_uv_sample *s = &samples->at(k);
+        int x0 = Max(0, (int)ceil(s->u + u / 2 - half));
+        int x1 = Min(u - 1, (int)floor(s->u + u / 2 + half));
+        int y0 = Max(0, (int)ceil(s->v + v / 2 - half));
+        int y1 = Min(v - 1, (int)floor(s->v + v / 2 + half));
+        if(x0 > x1 || y0 > y1)
+            continue;
+        sum += weights[k];
+        for(int ty = y0 / tile_size; ty <= y1 / tile_size; ty++)
+            for(int tx = x0 / tile_size; tx <= x1 / tile_size; tx++)
+                tiles[tx + ty * nx].indexes.push_back(k);
+    }
+    std::atomic<int> pending(0);
+    for(size_t t = 0; t < tiles.size(); t++)
+    {
+        if(tiles[t].indexes.size() > 0)
+            pool->push(gridTile, &tiles[t], &pending);
+    }
+    pool->wait(&pending);
+    pgarb("%d samples gridded into %d tiles\n", len, nx * ny);
+    return sum;
+}
+
+void VLBIGridder::grid(std::vector<vlbi_uv_sample> *samples, dsp_t *plane, int u, int v, VLBIThreadPool *pool)
+{
+    pfunc;
+    dsp_buffer_set(plane, (long)u * v, 0.0);
+    int len = (int)samples->size();
+    if(len < 1)
+        return;
+    double *weights = (double*)malloc(sizeof(double) * (size_t)len);
+    getWeights(samples, u, v, weights);
+    double sum = convolve(samples, weights, plane, u, v, pool);
+    if(sum > 0.0)
+    {
+        for(long x = 0; x < (long)u * v; x++)
+            plane[x] /= sum;
+    }
+    free(weights);
+}
+
+void *VLBIGridder::transformPlane(void *arg)
+{
+    wplane *p = (wplane*)arg;
+    int u = p->u;
+    int v = p->v;
+    fftw_execute_dft(p->plan, p->buf, p->buf);
+    if(p->w == 0.0)
+        return nullptr;
+    for(int y = 0; y < v; y++)
+    {
+        double m = AIRY * (y - v / 2) / v;
+        for(int x = 0; x < u; x++)
+        {
+            double l = AIRY * (x - u / 2) / u;
+            double r = l * l + m * m;
+            double n = (r < 1.0 ? sqrt(1.0 - r) : 0.0);
+            double phi = 2.0 * PI * p->w / AIRY * (n - 1.0);
+            double c = cos(phi);
+            double s = sin(phi);
+            fftw_complex *z = &p->buf[((y + v - v / 2) % v) * u + (x + u - u / 2) % u];
+            double re = (*z)[0];
+            double im = (*z)[1];
+            (*z)[0] = re * c - im * s;
+            (*z)[1] = re * s + im * c;
+        }
+    }
+    return nullptr;
+}
+
+void VLBIGridder::wstack(std::vector<vlbi_uv_sample> *samples, dsp_t *image, int u, int v, int wplanes, VLBIThreadPool *pool)
+{
+    pfunc;
+    long len = (long)u * v;
+    dsp_buffer_set(image, len, 0.0);
+    int count = (int)samples->size();
+    if(count < 1)
+        return;
+    wplanes = Max(1, wplanes);
+    double *weights = (double*)malloc(sizeof(double) * (size_t)count);
+    getWeights(samples, u, v, weights);
+    double wmin = DBL_MAX;
+    double wmax = -DBL_MAX;
+    for(int k = 0; k < count; k++)
+    {
+        wmin = fmin(wmin, samples->at(k).w);
+        wmax = fmax(wmax, samples->at(k).w);
+    }
+    double dw = (wmax - wmin) / wplanes;
+    std::vector<std::vector<vlbi_uv_sample>> binned((size_t)wplanes);
+    std::vector<std::vector<double>> binned_weights((size_t)wplanes);
+    for(int k = 0; k < count; k++)
+    {
+        int p = (dw > 0.0 ? Min(wplanes - 1, (int)((samples->at(k).w - wmin) / dw)) : 0);
+        binned[p].push_back(samples->at(k));
+        binned_weights[p].push_back(weights[k]);
+    }
+    free(weights);
+    bool has_imaginary = false;
+    for(int k = 0; k < count && !has_imaginary; k++)
+        has_imaginary = (samples->at(k).imag != 0.0);
+    dsp_t *plane = (dsp_t*)malloc(sizeof(dsp_t) * (size_t)len);
+    dsp_t *imaginary = (has_imaginary ? (dsp_t*)malloc(sizeof(dsp_t) * (size_t)len) : nullptr);
+    std::vector<wplane> planes((size_t)wplanes);
+    fftw_plan plan = nullptr;
+    double sum = 0.0;
+    std::atomic<int> pending(0);
+    for(int p = 0; p < wplanes; p++)
+    {
+        planes[p].buf = nullptr;
+        if(binned[p].empty())
+            continue;
+        sum += convolve(&binned[p], binned_weights[p].data(), plane, u, v, pool);
+        if(has_imaginary)
+            convolve(&binned[p], binned_weights[p].data(), imaginary, u, v, pool, true);
+        planes[p].buf = fftw_alloc_complex((size_t)len);
+        if(plan == nullptr)
+            plan = fftw_plan_dft_2d(v, u, planes[p].buf, planes[p].buf, FFTW_BACKWARD, FFTW_ESTIMATE);
+        for(int y = 0; y < v; y++)
+        {
+            for(int x = 0; x < u; x++)
+            {
+                fftw_complex *z = &planes[p].buf[((y + v - v / 2) % v) * u + (x + u - u / 2) % u];
+                (*z)[0] = plane[x + y * u];
+                (*z)[1] = (has_imaginary ? imaginary[x + y * u] : 0.0);
+            }
+        }
+        planes[p].plan = plan;
+        planes[p].w = (dw > 0.0 ? wmin + (p + 0.5) * dw : wmin);
+        planes[p].u = u;
+        planes[p].v = v;
+        pool->push(transformPlane, &planes[p], &pending);
+    }
+    pool->wait(&pending);
+    for(int p = 0; p < wplanes; p++)
+    {
+        if(planes[p].buf == nullptr)
+            continue;
+        for(int y = 0; y < v; y++)
+            for(int x = 0; x < u; x++)
+                image[x + y * u] += planes[p].buf[((y + v - v / 2) % v) * u + (x + u - u / 2) % u][0];
+        fftw_free(planes[p].buf);
+    }
+    if(plan != nullptr)
+        fftw_destroy_plan(plan);
+    free(plane);
+    free(imaginary);
+    if(sum > 0.0)
+    {
+        for(long x = 0; x < len; x++)
+            image[x] /= sum;
+    }
+    pgarb("%d samples stacked into %d w-planes\n", count, wplanes);
+}
+
+void VLBIGridder::getCorrection(dsp_t *correction, int u, int v)
+{
+    pfunc;
+    int sizes[2] = { u, v };
+    std::vector<double> axes[2];
+    for(int d = 0; d < 2; d++)
+    {
+        axes[d].resize((size_t)sizes[d]);
+        double zero = 0.0;
+        for(int l = 0; l < sizes[d]; l++)
+        {
+            double x = (double)(l - sizes[d] / 2) / sizes[d];
+            double c = table[0];
+            for(size_t i = 1; i < table.size(); i++)
+                c += 2.0 * table[i] * cos(2.0 * PI * x * i / Oversampling);
+            if(l == sizes[d] / 2)
+                zero = c;
+            axes[d][l] = c;
+        }
+        for(int l = 0; l < sizes[d]; l++)
+        {
+            if(!isEnabled())
+                axes[d][l] = 1.0;
+            else if(axes[d][l] > zero * 1E-6)
+                axes[d][l] = zero / axes[d][l];
+            else
+                axes[d][l] = 0.0;
+        }
+    }
+    for(int y = 0; y < v; y++)
+        for(int x = 0; x < u; x++)
+            correction[x + y * u] = axes[0][x] * axes[1][y];
+}
+
+void *VLBIGridder::degridRows(void *arg)
+{
+    rows *r = (rows*)arg;
+    VLBIGridder *gridder = r->gridder;
+    double half = gridder->Support / 2.0;
+    int u = r->u;
+    int v = r->v;
+    std::vector<double> kx((size_t)gridder->Support + 2);
+    for(int k = r->start; k < r->end; k++)
+    {
+        double su = r->su[k] + u / 2;
+        double sv = r->sv[k] + v / 2;
+        int x0 = Max(0, (int)ceil(su - half));
+        int x1 = Min(u - 1, (int)floor(su + half));
+        int y0 = Max(0, (int)ceil(sv - half));
+        int y1 = Min(v - 1, (int)floor(sv + half));
+        double re = 0.0;
+        double im = 0.0;
+        double norm = 0.0;
+        for(int x = x0; x <= x1; x++)
+            kx[x - x0] = gridder->lookup(x - su);
+        for(int y = y0; y <= y1; y++)
+        {
+            double ky = gridder->lookup(y - sv);
+            fftw_complex *row = &r->grid[(long)y * u];
+            for(int x = x0; x <= x1; x++)
+            {
+                double k = ky * kx[x - x0];
+                re += k * row[x][0];
+                im += k * row[x][1];
+                norm += k;
+            }
+        }
+        r->out[k][0] = (norm > 0.0 ? re / norm : 0.0);
+        r->out[k][1] = (norm > 0.0 ? im / norm : 0.0);
+    }
+    return nullptr;
+}
+
+void VLBIGridder::degrid(dsp_t *image, int u, int v, double *su, double *sv, int count, complex_t *out, VLBIThreadPool *pool)
+{
+    pfunc;
+    long len = (long)u * v;
+    if(count < 1 || len < 1)
+        return;
+    dsp_t *correction = (dsp_t*)malloc(sizeof(dsp_t) * (size_t)len);
+    getCorrection(correction, u, v);
+    fftw_complex *buf = fftw_alloc_complex((size_t)len);
+    fftw_complex *grid = fftw_alloc_complex((size_t)len);
+    fftw_plan plan = fftw_plan_dft_2d(v, u, buf, buf, FFTW_FORWARD, FFTW_ESTIMATE);
+    for(int y = 0; y < v; y++)
+    {
+        for(int x = 0; x < u; x++)
+        {
+            fftw_complex *z = &buf[((y + v - v / 2) % v) * u + (x + u - u / 2) % u];
+            (*z)[0] = image[x + y * u] * correction[x + y * u];
+            (*z)[1] = 0.0;
+        }
+    }
+    fftw_execute(plan);
+    fftw_destroy_plan(plan);
+    for(int y = 0; y < v; y++)
+    {
+        for(int x = 0; x < u; x++)
+        {
+            fftw_complex *z = &buf[((y + v - v / 2) % v) * u + (x + u - u / 2) % u];
+            grid[x + y * u][0] = (*z)[0];
+            grid[x + y * u][1] = (*z)[1];
+        }
+    }
+    fftw_free(buf);
+    free(correction);
+    int njobs = Max(1, Min(count, pool->getThreads() * 4));
+    std::vector<rows> jobs((size_t)njobs);
+    std::atomic<int> pending(0);
+    for(int j = 0; j < njobs; j++)
+    {
+        jobs[j].gridder = this;
+        jobs[j].grid = grid;
+        jobs[j].u = u;
+        jobs[j].v = v;
+        jobs[j].su = su;
+        jobs[j].sv = sv;
+        jobs[j].out = out;
+        jobs[j].start = (int)((long)count * j / njobs);
+        jobs[j].end = (int)((long)count * (j + 1) / njobs);
+        pool->push(degridRows, &jobs[j], &pending);
+    }
+    pool->wait(&pending);
+    fftw_free(grid);
+    pgarb("%d samples degridded\n", count);
+}
@@ -0,0 +1,129 @@
+/*  OpenVLBI - Open Source Very Long Baseline Interferometry
+*   Copyright © 2017-2023  Ilia Platone
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 2 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along
+*   with this program; if not, write to the Free Software Foundation, Inc.,
+*   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#ifndef _GRIDDER_H
+#define _GRIDDER_H
+
+#include <vlbi.h>
+#include <fftw3.h>
+#include <vector>
+
+class VLBIThreadPool;
+
+/**
+* A sample to be gridded, its position is in cells of the UV plane from its center,
+* w is measured in cells too. The weight multiplies the density weight, the imaginary part
+* of the value is gridded only by w-stacking.
+*/
+struct vlbi_uv_sample
+{
+    double u;
+    double v;
+    double w;
+    double val;
+    double imag;
+    double weight;
+    double time;
+    int channel;
+};
+
+/**
+* Convolutional gridder of the UV plane.
+* The kernel is tabulated once with the given oversampling, the density weights are computed
+* from the cell counts of the samples, and the plane is split into square tiles, each gridded by one job
+* with all the samples whose kernel footprint overlaps it, so no two threads write the same cell.
+* Degridding transforms a corrected model image once and interpolates it with the same kernel at each sample.
+*/
+class VLBIGridder
+{
+    public:
+        VLBIGridder();
+        ~VLBIGridder();
+        void setKernel(vlbi_gridding_kernel kernel, int support, int oversampling);
+        void setWeighting(vlbi_weighting_mode mode, double robust);
+        void grid(std::vector<vlbi_uv_sample> *samples, dsp_t *plane, int u, int v, VLBIThreadPool *pool);
+        void wstack(std::vector<vlbi_uv_sample> *samples, dsp_t *image, int u, int v, int wplanes, VLBIThreadPool *pool);
+        void getCorrection(dsp_t *correction, int u, int v);
+        void degrid(dsp_t *image, int u, int v, double *su, double *sv, int count, complex_t *out, VLBIThreadPool *pool);
+        inline bool isEnabled() { return Kernel != vlbi_gridding_none; }
+        inline vlbi_gridding_kernel getKernel() { return Kernel; }
+        inline int getSupport() { return Support; }
+        inline int getOversampling() { return Oversampling; }
+        inline vlbi_weighting_mode getWeighting() { return Weighting; }
+        inline double getRobust() { return Robust; }
+
+    private:
+        struct tile
+        {
+            VLBIGridder *gridder;
+            std::vector<vlbi_uv_sample> *samples;
+            double *weights;
+            std::vector<int> indexes;
+            dsp_t *plane;
+            int u;
+            int v;
+            bool imaginary;
+            int x0;
+            int y0;
+            int x1;
+            int y1;
+        };
+        struct wplane
+        {
+            fftw_plan plan;
+            fftw_complex *buf;
+            double w;
+            int u;
+            int v;
+        };
+        struct rows
+        {
+            VLBIGridder *gridder;
+            fftw_complex *grid;
+            int u;
+            int v;
+            double *su;
+            double *sv;
+            complex_t *out;
+            int start;
+            int end;
+        };
+        static void *gridTile(void *arg);
+        static void *degridRows(void *arg);
+        static void *transformPlane(void *arg);
+        double convolve(std::vector<vlbi_uv_sample> *samples, double *weights, dsp_t *plane, int u, int v, VLBIThreadPool *pool,
+                        bool imaginary = false);
+        double evaluate(double nu);
+        void updateTable();
+        void getWeights(std::vector<vlbi_uv_sample> *samples, int u, int v, double *weights);
+        inline double lookup(double offset)
+        {
+            int i = (int)(fabs(offset) * Oversampling + 0.5);
+            return (i < (int)table.size() ? table[i] : 0.0);
+        }
+
+        vlbi_gridding_kernel Kernel { vlbi_gridding_none };
+        int Support { 6 };
+        int Oversampling { 128 };
+        vlbi_weighting_mode Weighting { vlbi_weighting_natural };
+        double Robust { 0.0 };
+        int tile_size { 64 };
+        std::vector<double> table;
+};
+
+#endif //_GRIDDER_H
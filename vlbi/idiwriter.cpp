@@ -0,0 +1,462 @@
+/*  OpenVLBI - Open Source Very Long Baseline Interferometry
+*   Copyright © 2017-2023  Ilia Platone
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 2 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along
+*   with this program; if not, write to the Free Software Foundation, Inc.,
+*   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+#include "idiwriter.h"
+#include "nodecollection.h"
+#include "baselinecollection.h"
+#include "baseline.h"
+#include <algorithm>
+
+static const long batch_size = 4194304;
+static const double seconds_per_day = 86400.0;
+
+static void julian_to_date(double jd, char *date)
+{
+    long z = (long)floor(jd + 0.5);
+    long a = z;
+    if(z >= 2299161)
+    {
+        long alpha = (long)floor((z - 1867216.25) / 36524.25);
+        a = z + 1 + alpha - alpha / 4;
+    }
+    long b = a + 1524;
+    long c = (long)floor((b - 122.1) / 365.25);
+    long d = (long)floor(365.25 * c);
+    long e = (long)floor((b - d) / 30.6001);
+    int day = (int)(b - d - (long)floor(30.6001 * e));
+    int month = (int)(e < 14 ? e - 1 : e - 13);
+    int year = (int)(month > 2 ? c - 4716 : c - 4715);
+    sprintf(date, "%04d-%02d-%02d", year, month, day);
+}
+
+VLBIIdiWriter::VLBIIdiWriter()
+{
+    pthread_mutex_init(&mutex, nullptr);
+}
+
+VLBIIdiWriter::~VLBIIdiWriter()
+{
+    close();
+    pthread_mutex_destroy(&mutex);
+}
+
+bool VLBIIdiWriter::check(const char *what)
+{
+    if(status == 0)
+        return true;
+    char error_status[64];
+    fits_get_errstatus(status, error_status);
+    perr("%s: FITS Error: %s\n", what, error_status);
+    return false;
+}
+
+bool VLBIIdiWriter::open(const char *filename, NodeCollection *nodes, double *target, double freq, int channels)
+{
+    pfunc;
+    if(File != nullptr || nodes == nullptr || channels < 1 || freq <= 0.0)
+        return false;
+    Nodes = nodes;
+    memcpy(Target, target, sizeof(double) * 3);
+    Freq = freq;
+    Channels = channels;
+    BatchRows = Max(1, batch_size / (long)(sizeof(float) * 2 * channels));
+    Rows = 0;
+    status = 0;
+    Stations.clear();
+    double starttime = DBL_MAX;
+    double samplerate = 0.0;
+    for(int x = 0; x < Nodes->count(); x++)
+    {
+        VLBINode *node = Nodes->at(x);
+        node->setLocation(0);
+        if(node->getSampleRate() <= 0.0)continue;
+        starttime = fmin(starttime, node->getStartTime());
+        if(samplerate <= 0.0)
+            samplerate = node->getSampleRate();
+    }
+    if(samplerate <= 0.0)
+    {
+        perr("No nodes with a valid sampling rate\n");
+        return false;
+    }
+    ChannelWidth = samplerate / (channels * 2);
+    RefDate = floor(J2000 + starttime / seconds_per_day - 0.5) + 0.5;
+    BaselineCollection *baselines = Nodes->getBaselines();
+    baselines->setRelative(Nodes->isRelative());
+    baselines->setFrequency(Freq);
+    unlink(filename);
+    fits_create_file(&File, filename, &status);
+    if(!check(filename))
+    {
+        File = nullptr;
+        return false;
+    }
+    long naxes[1] = { 0 };
+    int groups = 1;
+    int count = 0;
+    fits_create_img(File, BYTE_IMG, 1, naxes, &status);
+    fits_update_key(File, TLOGICAL, "GROUPS", &groups, "Random groups convention", &status);
+    fits_update_key(File, TINT, "GCOUNT", &count, "No random groups", &status);
+    fits_update_key(File, TINT, "PCOUNT", &count, "No random parameters", &status);
+    fits_update_key(File, TSTRING, "CORRELAT", (void*)"OPENVLBI", "Name/type of correlator", &status);
+    fits_update_key(File, TSTRING, "FXCORVER", (void*)VLBI_VERSION_STRING, "Version number of the correlator software", &status);
+    writeArrayGeometry();
+    writeSource();
+    writeFrequency();
+    createUVData();
+    if(!check(filename))
+    {
+        int close_status = 0;
+        fits_close_file(File, &close_status);
+        File = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void VLBIIdiWriter::sort()
+{
+    long width = 0;
+    fits_read_key(File, TLONG, "NAXIS1", &width, nullptr, &status);
+    if(Rows < 2 || !check("UV_DATA"))
+        return;
+    std::vector<double> time((size_t)Rows);
+    std::vector<int> baseline((size_t)Rows);
+    fits_read_col(File, TDOUBLE, 5, 1, 1, Rows, nullptr, time.data(), nullptr, &status);
+    fits_read_col(File, TINT, 6, 1, 1, Rows, nullptr, baseline.data(), nullptr, &status);
+    if(!check("UV_DATA"))
+        return;
+    std::vector<long> order((size_t)Rows);
+    for(long r = 0; r < Rows; r++)
+        order[r] = r;
+    std::stable_sort(order.begin(), order.end(), [&](long a, long b)
+    {
+        return time[a] < time[b] || (time[a] == time[b] && baseline[a] < baseline[b]);
+    });
+    std::vector<unsigned char> row((size_t)width);
+    std::vector<unsigned char> held((size_t)width);
+    std::vector<bool> placed((size_t)Rows, false);
+    for(long r = 0; r < Rows && status == 0; r++)
+    {
+        if(placed[r] || order[r] == r)
+            continue;
+        fits_read_tblbytes(File, r + 1, 1, width, held.data(), &status);
+        long x = r;
+        while(order[x] != r && status == 0)
+        {
+            fits_read_tblbytes(File, order[x] + 1, 1, width, row.data(), &status);
+            fits_write_tblbytes(File, x + 1, 1, width, row.data(), &status);
+            placed[x] = true;
+            x = order[x];
+        }
+        fits_write_tblbytes(File, x + 1, 1, width, held.data(), &status);
+        placed[x] = true;
+    }
+    check("UV_DATA");
+}
+
+long VLBIIdiWriter::close()
+{
+    if(File == nullptr)
+        return -1;
+    if(status == 0)
+        sort();
+    fits_close_file(File, &status);
+    File = nullptr;
+    if(!check("UV_DATA"))
+        return -1;
+    pgarb("%ld UV_DATA rows written\n", Rows);
+    return Rows;
+}
+
+void VLBIIdiWriter::writeCommonKeys()
+{
+    int nstokes = 1;
+    int stokes = 1;
+    int nband = 1;
+    double refpixel = 1.0;
+    fits_update_key(File, TSTRING, "OBSCODE", (void*)"", "Observation code", &status);
+    fits_update_key(File, TINT, "NO_STKD", &nstokes, "The number of Stokes parameters", &status);
+    fits_update_key(File, TINT, "STK_1", &stokes, "The first Stokes parameter coordinate value", &status);
+    fits_update_key(File, TINT, "NO_BAND", &nband, "The number of bands", &status);
+    fits_update_key(File, TINT, "NO_CHAN", &Channels, "The number of spectral channels per band", &status);
+    fits_update_key(File, TDOUBLE, "REF_FREQ", &Freq, "The file reference frequency in Hz", &status);
+    fits_update_key(File, TDOUBLE, "CHAN_BW", &ChannelWidth, "The channel bandwidth in Hz", &status);
+    fits_update_key(File, TDOUBLE, "REF_PIXL", &refpixel, "The reference pixel for the frequency axis", &status);
+}
+
+void VLBIIdiWriter::writeArrayGeometry()
+{
+    const char *ttype[] = { "ANNAME", "STABXYZ", "DERXYZ", "ORBPARM", "NOSTA", "MNTSTA", "STAXOF" };
+    const char *tform[] = { "8A", "3D", "3E", "0D", "1I", "1J", "3E" };
+    const char *tunit[] = { "", "METERS", "METERS/SEC", "", "", "", "METERS" };
+    fits_create_tbl(File, BINARY_TBL, 0, 7, (char**)ttype, (char**)tform, (char**)tunit, FITS_TABLE_FITSIDI_ARRAY_GEOMETRY, &status);
+    int tabrev = 1;
+    int extver = 1;
+    int numorb = 0;
+    double zero = 0.0;
+    double degpdy = 360.0 * seconds_per_day / SIDEREAL_DAY;
+    double gstia0 = vlbi_time_J2000time_to_lst((RefDate - J2000) * seconds_per_day, 0.0) * 15.0;
+    char rdate[32];
+    julian_to_date(RefDate, rdate);
+    fits_update_key(File, TINT, "TABREV", &tabrev, "", &status);
+    writeCommonKeys();
+    fits_update_key(File, TINT, "EXTVER", &extver, "Array number", &status);
+    fits_update_key(File, TSTRING, "ARRNAM", (void*)"OPENVLBI", "Array name", &status);
+    fits_update_key(File, TSTRING, "FRAME", (void*)"GEOCENTRIC", "Coordinate frame", &status);
+    fits_update_key(File, TDOUBLE, "ARRAYX", &zero, "x coordinate of array center (m)", &status);
+    fits_update_key(File, TDOUBLE, "ARRAYY", &zero, "y coordinate of array center (m)", &status);
+    fits_update_key(File, TDOUBLE, "ARRAYZ", &zero, "z coordinate of array center (m)", &status);
+    fits_update_key(File, TINT, "NUMORB", &numorb, "Number orbital parameters in table", &status);
+    fits_update_key(File, TDOUBLE, "FREQ", &Freq, "Reference frequency (Hz)", &status);
+    fits_update_key(File, TSTRING, "TIMESYS", (void*)"UTC", "Time system", &status);
+    fits_update_key(File, TSTRING, "RDATE", rdate, "Reference date", &status);
+    fits_update_key(File, TDOUBLE, "GSTIA0", &gstia0, "GST at 0h on reference date (degrees)", &status);
+    fits_update_key(File, TDOUBLE, "DEGPDY", &degpdy, "Earth's rotation rate (degrees/day)", &status);
+    fits_update_key(File, TDOUBLE, "UT1UTC", &zero, "UT1 - UTC (sec)", &status);
+    fits_update_key(File, TDOUBLE, "IATUTC", &zero, "IAT - UTC (sec)", &status);
+    fits_update_key(File, TDOUBLE, "POLARX", &zero, "x coordinate of North Pole (arc seconds)", &status);
+    fits_update_key(File, TDOUBLE, "POLARY", &zero, "y coordinate of North Pole (arc seconds)", &status);
+    float offsets[3] = { 0.0, 0.0, 0.0 };
+    for(int x = 0; x < Nodes->count(); x++)
+    {
+        VLBINode *node = Nodes->at(x);
+        char *name = node->getName();
+        double xyz[3];
+        if(node->GeographicCoordinates())
+        {
+            double *location = vlbi_matrix_calc_location(node->getGeographicLocation());
+            memcpy(xyz, location, sizeof(double) * 3);
+            free(location);
+        }
+        else
+            memcpy(xyz, node->getLocation(), sizeof(double) * 3);
+        short nosta = (short)(x + 1);
+        Stations[node] = nosta;
+        int mount = 0;
+        fits_write_col(File, TSTRING, 1, x + 1, 1, 1, &name, &status);
+        fits_write_col(File, TDOUBLE, 2, x + 1, 1, 3, xyz, &status);
+        fits_write_col(File, TFLOAT, 3, x + 1, 1, 3, offsets, &status);
+        fits_write_col(File, TSHORT, 5, x + 1, 1, 1, &nosta, &status);
+        fits_write_col(File, TINT, 6, x + 1, 1, 1, &mount, &status);
+        fits_write_col(File, TFLOAT, 7, x + 1, 1, 3, offsets, &status);
+    }
+}
+
+void VLBIIdiWriter::writeSource()
+{
+    const char *ttype[] = { "SOURCE_ID", "SOURCE", "QUAL", "CALCODE", "FREQID", "IFLUX", "QFLUX", "UFLUX", "VFLUX", "ALPHA", "FREQOFF", "RAEPO", "DECEPO", "EQUINOX", "RAAPP", "DECAPP", "SYSVEL", "VELTYP", "VELDEF", "RESTFREQ", "PMRA", "PMDEC", "PARALLAX", "EPOCH" };
+    const char *tform[] = { "1J", "16A", "1J", "4A", "1J", "1E", "1E", "1E", "1E", "1E", "1D", "1D", "1D", "8A", "1D", "1D", "1D", "8A", "8A", "1D", "1D", "1D", "1E", "1D" };
+    const char *tunit[] = { "", "", "", "", "", "JY", "JY", "JY", "JY", "", "HZ", "DEGREES", "DEGREES", "", "DEGREES", "DEGREES", "M/SEC", "", "", "HZ", "DEG/DAY", "DEG/DAY", "ARCSEC", "YEARS" };
+    fits_create_tbl(File, BINARY_TBL, 0, 24, (char**)ttype, (char**)tform, (char**)tunit, FITS_TABLE_FITSIDI_SOURCE, &status);
+    int tabrev = 1;
+    fits_update_key(File, TINT, "TABREV", &tabrev, "", &status);
+    writeCommonKeys();
+    double ra = Target[0] * 15.0;
+    double dec = Target[1];
+    double minutes = fmod(Target[0], 24.0) * 60.0;
+    double arcmin = fabs(dec) * 60.0;
+    char source[32];
+    sprintf(source, "J%02d%02d%c%02d%02d", (int)(minutes / 60.0), (int)fmod(minutes, 60.0), (dec < 0.0 ? '-' : '+'), (int)(arcmin / 60.0), (int)fmod(arcmin, 60.0));
+    char *name = source;
+    char *calcode = (char*)"";
+    char *equinox = (char*)"J2000";
+    char *veltyp = (char*)"GEOCENTR";
+    char *veldef = (char*)"RADIO";
+    int one = 1;
+    int zero = 0;
+    float fzero = 0.0;
+    double dzero = 0.0;
+    double parallax = 0.0;
+    double epoch = 2000.0;
+    if(Target[2] < DBL_MAX && Target[2] > 0.0)
+        parallax = 180.0 * 3600.0 / PI * ASTRONOMICALUNIT / Target[2];
+    float fparallax = (float)parallax;
+    fits_write_col(File, TINT, 1, 1, 1, 1, &one, &status);
+    fits_write_col(File, TSTRING, 2, 1, 1, 1, &name, &status);
+    fits_write_col(File, TINT, 3, 1, 1, 1, &zero, &status);
+    fits_write_col(File, TSTRING, 4, 1, 1, 1, &calcode, &status);
+    fits_write_col(File, TINT, 5, 1, 1, 1, &one, &status);
+    for(int col = 6; col <= 10; col++)
+        fits_write_col(File, TFLOAT, col, 1, 1, 1, &fzero, &status);
+    fits_write_col(File, TDOUBLE, 11, 1, 1, 1, &dzero, &status);
+    fits_write_col(File, TDOUBLE, 12, 1, 1, 1, &ra, &status);
+    fits_write_col(File, TDOUBLE, 13, 1, 1, 1, &dec, &status);
+    fits_write_col(File, TSTRING, 14, 1, 1, 1, &equinox, &status);
+    fits_write_col(File, TDOUBLE, 15, 1, 1, 1, &ra, &status);
+    fits_write_col(File, TDOUBLE, 16, 1, 1, 1, &dec, &status);
+    fits_write_col(File, TDOUBLE, 17, 1, 1, 1, &dzero, &status);
+    fits_write_col(File, TSTRING, 18, 1, 1, 1, &veltyp, &status);
+    fits_write_col(File, TSTRING, 19, 1, 1, 1, &veldef, &status);
+    fits_write_col(File, TDOUBLE, 20, 1, 1, 1, &Freq, &status);
+    fits_write_col(File, TDOUBLE, 21, 1, 1, 1, &dzero, &status);
+    fits_write_col(File, TDOUBLE, 22, 1, 1, 1, &dzero, &status);
+    fits_write_col(File, TFLOAT, 23, 1, 1, 1, &fparallax, &status);
+    fits_write_col(File, TDOUBLE, 24, 1, 1, 1, &epoch, &status);
+}
+
+void VLBIIdiWriter::writeFrequency()
+{
+    const char *ttype[] = { "FREQID", "BANDFREQ", "CH_WIDTH", "TOTAL_BANDWIDTH", "SIDEBAND" };
+    const char *tform[] = { "1J", "1D", "1E", "1E", "1J" };
+    const char *tunit[] = { "", "HZ", "HZ", "HZ", "" };
+    fits_create_tbl(File, BINARY_TBL, 0, 5, (char**)ttype, (char**)tform, (char**)tunit, FITS_TABLE_FITSIDI_FREQUENCY, &status);
+    int tabrev = 1;
+    fits_update_key(File, TINT, "TABREV", &tabrev, "", &status);
+    writeCommonKeys();
+    int one = 1;
+    double offset = 0.0;
+    float width = (float)ChannelWidth;
+    float bandwidth = (float)(ChannelWidth * Channels);
+    fits_write_col(File, TINT, 1, 1, 1, 1, &one, &status);
+    fits_write_col(File, TDOUBLE, 2, 1, 1, 1, &offset, &status);
+    fits_write_col(File, TFLOAT, 3, 1, 1, 1, &width, &status);
+    fits_write_col(File, TFLOAT, 4, 1, 1, 1, &bandwidth, &status);
+    fits_write_col(File, TINT, 5, 1, 1, 1, &one, &status);
+}
+
+void VLBIIdiWriter::createUVData()
+{
+    char flux[32];
+    sprintf(flux, "%dE", Channels * 2);
+    const char *ttype[] = { "UU---SIN", "VV---SIN", "WW---SIN", "DATE", "TIME", "BASELINE", "ARRAY", "SOURCE_ID", "FREQID", "INTTIM", "FLUX", "WEIGHT" };
+    const char *tform[] = { "1D", "1D", "1D", "1D", "1D", "1J", "1J", "1J", "1J", "1D", flux, "1E" };
+    const char *tunit[] = { "SECONDS", "SECONDS", "SECONDS", "DAYS", "DAYS", "", "", "", "", "SECONDS", "UNCALIB", "" };
+    fits_create_tbl(File, BINARY_TBL, 0, 12, (char**)ttype, (char**)tform, (char**)tunit, FITS_TABLE_FITSIDI_UV_DATA, &status);
+    long naxes[6] = { 2, 1, Channels, 1, 1, 1 };
+    fits_write_tdim(File, 11, 6, naxes, &status);
+    int tabrev = 2;
+    fits_update_key(File, TINT, "TABREV", &tabrev, "", &status);
+    writeCommonKeys();
+    char dateobs[32];
+    julian_to_date(RefDate, dateobs);
+    fits_update_key(File, TSTRING, "DATE-OBS", dateobs, "Observation date", &status);
+    fits_update_key(File, TSTRING, "EQUINOX", (void*)"J2000", "Mean equinox", &status);
+    fits_update_key(File, TSTRING, "WEIGHTYP", (void*)"NORMAL", "Type of data weights", &status);
+    int nmatrix = 1;
+    int maxis = 6;
+    int tmatx = 1;
+    fits_update_key(File, TINT, "NMATRIX", &nmatrix, "Number of UV data matrices", &status);
+    fits_update_key(File, TINT, "MAXIS", &maxis, "Number of UV data matrix axes", &status);
+    fits_update_key(File, TLOGICAL, "TMATX11", &tmatx, "FLUX column contains the UV data matrix", &status);
+    const char *ctype[] = { "COMPLEX", "STOKES", "FREQ", "BAND", "RA", "DEC" };
+    double cdelt[] = { 1.0, -1.0, ChannelWidth, 1.0, 1.0, 1.0 };
+    double crval[] = { 1.0, 1.0, Freq, 1.0, Target[0] * 15.0, Target[1] };
+    for(int axis = 0; axis < maxis; axis++)
+    {
+        char keyword[16];
+        int len = (int)naxes[axis];
+        double crpix = 1.0;
+        sprintf(keyword, "MAXIS%d", axis + 1);
+        fits_update_key(File, TINT, keyword, &len, "", &status);
+        sprintf(keyword, "CTYPE%d", axis + 1);
+        fits_update_key(File, TSTRING, keyword, (void*)ctype[axis], "", &status);
+        sprintf(keyword, "CDELT%d", axis + 1);
+        fits_update_key(File, TDOUBLE, keyword, &cdelt[axis], "", &status);
+        sprintf(keyword, "CRPIX%d", axis + 1);
+        fits_update_key(File, TDOUBLE, keyword, &crpix, "", &status);
+        sprintf(keyword, "CRVAL%d", axis + 1);
+        fits_update_key(File, TDOUBLE, keyword, &crval[axis], "", &status);
+    }
+}
+
+int VLBIIdiWriter::getStation(VLBINode *node)
+{
+    std::map<VLBINode*, int>::iterator it = Stations.find(node);
+    return (it == Stations.end() ? 0 : it->second);
+}
+
+VLBIIdiWriter::batch *VLBIIdiWriter::createBatch(VLBIBaseline *b)
+{
+    batch *rows = new batch();
+    int station1 = getStation(b->getNode(0));
+    int station2 = getStation(b->getNode(1));
+    rows->swap = (station1 > station2);
+    rows->baseline = (rows->swap ? 256 * station2 + station1 : 256 * station1 + station2);
+    rows->rows = 0;
+    rows->uu.resize(BatchRows);
+    rows->vv.resize(BatchRows);
+    rows->ww.resize(BatchRows);
+    rows->time.resize(BatchRows);
+    rows->inttim.resize(BatchRows);
+    rows->flux.resize(BatchRows * Channels * 2);
+    return rows;
+}
+
+void VLBIIdiWriter::append(batch *rows, VLBIBaseline *b, double time, double inttim, complex_t *visibilities)
+{
+    double uvw[3];
+    b->getProjection(time, uvw);
+    double scale = b->getWaveLength() / (AIRY * vlbi_astro_mean_speed(0));
+    double sign = (rows->swap ? -1.0 : 1.0);
+    long row = rows->rows;
+    rows->uu[row] = sign * uvw[0] * scale;
+    rows->vv[row] = sign * uvw[1] * scale;
+    rows->ww[row] = sign * uvw[2];
+    rows->time[row] = J2000 + time / seconds_per_day - RefDate;
+    rows->inttim[row] = inttim;
+    float *flux = &rows->flux[row * Channels * 2];
+    for(int c = 0; c < Channels; c++)
+    {
+        flux[c * 2] = (float)visibilities[c][0];
+        flux[c * 2 + 1] = (float)(sign * visibilities[c][1]);
+    }
+    rows->rows++;
+    if(rows->rows == BatchRows)
+        flush(rows);
+}
+
+void VLBIIdiWriter::flush(batch *rows)
+{
+    long n = rows->rows;
+    if(n < 1)
+        return;
+    std::vector<double> date((size_t)n, RefDate);
+    std::vector<int> baseline((size_t)n, rows->baseline);
+    std::vector<int> ones((size_t)n, 1);
+    std::vector<float> weight((size_t)n, 1.0f);
+    pthread_mutex_lock(&mutex);
+    if(File != nullptr && status == 0)
+    {
+        long first = Rows + 1;
+        fits_write_col(File, TDOUBLE, 1, first, 1, n, rows->uu.data(), &status);
+        fits_write_col(File, TDOUBLE, 2, first, 1, n, rows->vv.data(), &status);
+        fits_write_col(File, TDOUBLE, 3, first, 1, n, rows->ww.data(), &status);
+        fits_write_col(File, TDOUBLE, 4, first, 1, n, date.data(), &status);
+        fits_write_col(File, TDOUBLE, 5, first, 1, n, rows->time.data(), &status);
+        fits_write_col(File, TINT, 6, first, 1, n, baseline.data(), &status);
+        fits_write_col(File, TINT, 7, first, 1, n, ones.data(), &status);
+        fits_write_col(File, TINT, 8, first, 1, n, ones.data(), &status);
+        fits_write_col(File, TINT, 9, first, 1, n, ones.data(), &status);
+        fits_write_col(File, TDOUBLE, 10, first, 1, n, rows->inttim.data(), &status);
+        fits_write_col(File, TFLOAT, 11, first, 1, n * Channels * 2, rows->flux.data(), &status);
+        fits_write_col(File, TFLOAT, 12, first, 1, n, weight.data(), &status);
+        fits_flush_buffer(File, 0, &status);
+        if(check("UV_DATA"))
+            Rows += n;
+    }
+    pthread_mutex_unlock(&mutex);
+    rows->rows = 0;
+}
+
+void VLBIIdiWriter::closeBatch(batch *rows)
+{
+    flush(rows);
+    delete rows;
+}
@@ -0,0 +1,88 @@
+/*  OpenVLBI - Open Source Very Long Baseline Interferometry
+*   Copyright © 2017-2023  Ilia Platone
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 2 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along
+*   with this program; if not, write to the Free Software Foundation, Inc.,
+*   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+#ifndef _IDIWRITER_H
+#define _IDIWRITER_H
+
+#include <vlbi.h>
+#include <fitsio.h>
+#include <vector>
+#include <map>
+
+class NodeCollection;
+class VLBINode;
+class VLBIBaseline;
+
+/**
+* Streaming FITS-IDI writer of FX correlated visibilities.
+* The ARRAY_GEOMETRY, SOURCE and FREQUENCY tables are written from the context when the file is opened,
+* then each correlation job fills its own batch of UV_DATA rows and appends it to the table once full,
+* so at most one batch per running job is held in memory. The batches land in the order they complete,
+* when the file is closed the rows are permuted in place into time-baseline order, one row at a time.
+*/
+class VLBIIdiWriter
+{
+    public:
+        struct batch
+        {
+            int baseline;
+            bool swap;
+            long rows;
+            std::vector<double> uu;
+            std::vector<double> vv;
+            std::vector<double> ww;
+            std::vector<double> time;
+            std::vector<double> inttim;
+            std::vector<float> flux;
+        };
+        VLBIIdiWriter();
+        ~VLBIIdiWriter();
+        bool open(const char *filename, NodeCollection *nodes, double *target, double freq, int channels);
+        long close();
+        batch *createBatch(VLBIBaseline *b);
+        void append(batch *rows, VLBIBaseline *b, double time, double inttim, complex_t *visibilities);
+        void flush(batch *rows);
+        void closeBatch(batch *rows);
+        inline long getRows() { return Rows; }
+
+    private:
+        void sort();
+        void writeArrayGeometry();
+        void writeSource();
+        void writeFrequency();
+        void createUVData();
+        void writeCommonKeys();
+        bool check(const char *what);
+        int getStation(VLBINode *node);
+
+        fitsfile *File { nullptr };
+        NodeCollection *Nodes { nullptr };
+        std::map<VLBINode*, int> Stations;
+        pthread_mutex_t mutex;
+        double Target[3];
+        double Freq { 0 };
+        double ChannelWidth { 0 };
+        int Channels { 1 };
+        long BatchRows { 1 };
+        double RefDate { 0 };
+        long Rows { 0 };
+        int status { 0 };
+};
+
+#endif //_IDIWRITER_H
@@ -0,0 +1,511 @@
+/*  OpenVLBI - Open Source Very Long Baseline Interferometry
+*   Copyright © 2017-2023  Ilia Platone
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 2 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along
+*   with this program; if not, write to the Free Software Foundation, Inc.,
+*   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include <vlbi.h>
+#include <math.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define VLBI_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+static void product_generic(double **inputs, int count, double *output, int len)
+{
+    int i, n;
+    if(count < 1)
+    {
+        for(i = 0; i < len; i++)
+            output[i] = 0.0;
+        return;
+    }
+    for(i = 0; i < len; i++)
+    {
+        double val = inputs[0][i];
+        for(n = 1; n < count; n++)
+            val *= inputs[n][i];
+        output[i] = val;
+    }
+}
+
+static void coverage_generic(double **inputs, int count, double *output, int len)
+{
+    int i;
+    (void)inputs;
+    (void)count;
+    for(i = 0; i < len; i++)
+        output[i] = 1.0;
+}
+
+static void complex_multiply_conjugate_generic(double **inputs, int count, double *output, int len)
+{
+    int i;
+    if(count < 2)
+    {
+        for(i = 0; i < len; i++)
+            output[i] = 0.0;
+        return;
+    }
+    for(i = 0; i + 1 < len; i += 2)
+    {
+        double ar = inputs[0][i];
+        double ai = inputs[0][i + 1];
+        double br = inputs[1][i];
+        double bi = inputs[1][i + 1];
+        output[i] = ar * br + ai * bi;
+        output[i + 1] = ai * br - ar * bi;
+    }
+    if(i < len)
+        output[i] = 0.0;
+}
+
+static int find_peak_generic(double *buf, int len)
+{
+    int i, best = -1;
+    double peak = -1.0;
+    for(i = 0; i < len; i++)
+    {
+        double a = fabs(buf[i]);
+        if(a > peak)
+        {
+            peak = a;
+            best = i;
+        }
+    }
+    return best;
+}
+
+static double unpack_lut1[256][8];
+static double unpack_lut2[256][4];
+static double unpack_lut4[256][2];
+static double unpack_lut8[256][1];
+
+static void init_unpack_luts(void)
+{
+    static const double levels2[4] = { -3.3359, -1.0, 1.0, 3.3359 };
+    int b, s;
+    for(b = 0; b < 256; b++)
+    {
+        for(s = 0; s < 8; s++)
+            unpack_lut1[b][s] = ((b >> s) & 1) ? 1.0 : -1.0;
+        for(s = 0; s < 4; s++)
+            unpack_lut2[b][s] = levels2[(b >> (s * 2)) & 3];
+        for(s = 0; s < 2; s++)
+            unpack_lut4[b][s] = ((b >> (s * 4)) & 15) - 8.0;
+        unpack_lut8[b][0] = b - 128.0;
+    }
+}
+
+static const double *unpack_lut(int bits)
+{
+    switch(bits)
+    {
+        case 1:
+            return unpack_lut1[0];
+        case 2:
+            return unpack_lut2[0];
+        case 4:
+            return unpack_lut4[0];
+        case 8:
+            return unpack_lut8[0];
+        default:
+            return NULL;
+    }
+}
+
+static void unpack_generic(const unsigned char *in, int bits, double *output, long bytes)
+{
+    int per = 8 / bits;
+    const double *lut = unpack_lut(bits);
+    long b;
+    for(b = 0; b < bytes; b++)
+        memcpy(&output[b * per], &lut[in[b] * per], sizeof(double) * per);
+}
+
+#ifdef VLBI_KERNELS_X86
+
+__attribute__((target("avx2")))
+static void unpack_avx2(const unsigned char *in, int bits, double *output, long bytes)
+{
+    long b = 0;
+    switch(bits)
+    {
+        case 1:
+            for(; b < bytes; b++)
+            {
+                _mm256_storeu_pd(&output[b * 8], _mm256_loadu_pd(unpack_lut1[in[b]]));
+                _mm256_storeu_pd(&output[b * 8 + 4], _mm256_loadu_pd(&unpack_lut1[in[b]][4]));
+            }
+            break;
+        case 2:
+            for(; b < bytes; b++)
+                _mm256_storeu_pd(&output[b * 4], _mm256_loadu_pd(unpack_lut2[in[b]]));
+            break;
+        case 4:
+            for(; b + 2 <= bytes; b += 2)
+                _mm256_storeu_pd(&output[b * 2], _mm256_set_m128d(_mm_loadu_pd(unpack_lut4[in[b + 1]]),
+                                 _mm_loadu_pd(unpack_lut4[in[b]])));
+            break;
+        case 8:
+            for(; b + 4 <= bytes; b += 4)
+            {
+                int word;
+                memcpy(&word, &in[b], sizeof(int));
+                _mm256_storeu_pd(&output[b], _mm256_i32gather_pd(unpack_lut8[0], _mm_cvtepu8_epi32(_mm_cvtsi32_si128(word)),
+                                 sizeof(double)));
+            }
+            break;
+        default:
+            break;
+    }
+    unpack_generic(&in[b], bits, &output[b * (8 / bits)], bytes - b);
+}
+
+__attribute__((target("avx2")))
+static void product_avx2(double **inputs, int count, double *output, int len)
+{
+    int i = 0, n;
+    if(count < 1)
+    {
+        product_generic(inputs, count, output, len);
+        return;
+    }
+    for(; i + 4 <= len; i += 4)
+    {
+        __m256d val = _mm256_loadu_pd(&inputs[0][i]);
+        for(n = 1; n < count; n++)
+            val = _mm256_mul_pd(val, _mm256_loadu_pd(&inputs[n][i]));
+        _mm256_storeu_pd(&output[i], val);
+    }
+    for(; i < len; i++)
+    {
+        double val = inputs[0][i];
+        for(n = 1; n < count; n++)
+            val *= inputs[n][i];
+        output[i] = val;
+    }
+}
+
+__attribute__((target("avx2")))
+static void coverage_avx2(double **inputs, int count, double *output, int len)
+{
+    int i = 0;
+    __m256d one = _mm256_set1_pd(1.0);
+    (void)inputs;
+    (void)count;
+    for(; i + 4 <= len; i += 4)
+        _mm256_storeu_pd(&output[i], one);
+    for(; i < len; i++)
+        output[i] = 1.0;
+}
+
+__attribute__((target("avx2")))
+static void complex_multiply_conjugate_avx2(double **inputs, int count, double *output, int len)
+{
+    int i = 0;
+    if(count < 2)
+    {
+        complex_multiply_conjugate_generic(inputs, count, output, len);
+        return;
+    }
+    for(; i + 4 <= len; i += 4)
+    {
+        __m256d a = _mm256_loadu_pd(&inputs[0][i]);
+        __m256d b = _mm256_loadu_pd(&inputs[1][i]);
+        __m256d re = _mm256_mul_pd(a, b);
+        __m256d im = _mm256_mul_pd(_mm256_permute_pd(a, 0x5), b);
+        re = _mm256_add_pd(re, _mm256_permute_pd(re, 0x5));
+        im = _mm256_sub_pd(im, _mm256_permute_pd(im, 0x5));
+        _mm256_storeu_pd(&output[i], _mm256_blend_pd(re, _mm256_permute_pd(im, 0x5), 0xa));
+    }
+    for(; i + 1 < len; i += 2)
+    {
+        double ar = inputs[0][i];
+        double ai = inputs[0][i + 1];
+        double br = inputs[1][i];
+        double bi = inputs[1][i + 1];
+        output[i] = ar * br + ai * bi;
+        output[i + 1] = ai * br - ar * bi;
+    }
+    if(i < len)
+        output[i] = 0.0;
+}
+
+__attribute__((target("avx2")))
+static int find_peak_avx2(double *buf, int len)
+{
+    int i = 0;
+    __m256d mask = _mm256_castsi256_pd(_mm256_set1_epi64x(0x7fffffffffffffffLL));
+    __m256d best = _mm256_setzero_pd();
+    double lanes[4];
+    double peak;
+    __m256d target;
+    for(; i + 4 <= len; i += 4)
+        best = _mm256_max_pd(_mm256_and_pd(_mm256_loadu_pd(&buf[i]), mask), best);
+    _mm256_storeu_pd(lanes, best);
+    peak = fmax(fmax(lanes[0], lanes[1]), fmax(lanes[2], lanes[3]));
+    for(; i < len; i++)
+        peak = fmax(peak, fabs(buf[i]));
+    target = _mm256_set1_pd(peak);
+    for(i = 0; i + 4 <= len; i += 4)
+    {
+        int m = _mm256_movemask_pd(_mm256_cmp_pd(_mm256_and_pd(_mm256_loadu_pd(&buf[i]), mask), target, _CMP_EQ_OQ));
+        if(m)
+            return i + __builtin_ctz(m);
+    }
+    for(; i < len; i++)
+    {
+        if(fabs(buf[i]) == peak)
+            return i;
+    }
+    return -1;
+}
+
+__attribute__((target("avx512f")))
+static void product_avx512(double **inputs, int count, double *output, int len)
+{
+    int i = 0, n;
+    if(count < 1)
+    {
+        product_generic(inputs, count, output, len);
+        return;
+    }
+    for(; i + 8 <= len; i += 8)
+    {
+        __m512d val = _mm512_loadu_pd(&inputs[0][i]);
+        for(n = 1; n < count; n++)
+            val = _mm512_mul_pd(val, _mm512_loadu_pd(&inputs[n][i]));
+        _mm512_storeu_pd(&output[i], val);
+    }
+    for(; i < len; i++)
+    {
+        double val = inputs[0][i];
+        for(n = 1; n < count; n++)
+            val *= inputs[n][i];
+        output[i] = val;
+    }
+}
+
+__attribute__((target("avx512f")))
+static void coverage_avx512(double **inputs, int count, double *output, int len)
+{
+    int i = 0;
+    __m512d one = _mm512_set1_pd(1.0);
+    (void)inputs;
+    (void)count;
+    for(; i + 8 <= len; i += 8)
+        _mm512_storeu_pd(&output[i], one);
+    for(; i < len; i++)
+        output[i] = 1.0;
+}
+
+__attribute__((target("avx512f")))
+static void complex_multiply_conjugate_avx512(double **inputs, int count, double *output, int len)
+{
+    int i = 0;
+    if(count < 2)
+    {
+        complex_multiply_conjugate_generic(inputs, count, output, len);
+        return;
+    }
+    for(; i + 8 <= len; i += 8)
+    {
+        __m512d a = _mm512_loadu_pd(&inputs[0][i]);
+        __m512d b = _mm512_loadu_pd(&inputs[1][i]);
+        __m512d re = _mm512_mul_pd(a, b);
+        __m512d im = _mm512_mul_pd(_mm512_permute_pd(a, 0x55), b);
+        re = _mm512_add_pd(re, _mm512_permute_pd(re, 0x55));
+        im = _mm512_sub_pd(im, _mm512_permute_pd(im, 0x55));
+        _mm512_storeu_pd(&output[i], _mm512_mask_blend_pd(0xaa, re, _mm512_permute_pd(im, 0x55)));
+    }
+    for(; i + 1 < len; i += 2)
+    {
+        double ar = inputs[0][i];
+        double ai = inputs[0][i + 1];
+        double br = inputs[1][i];
+        double bi = inputs[1][i + 1];
+        output[i] = ar * br + ai * bi;
+        output[i + 1] = ai * br - ar * bi;
+    }
+    if(i < len)
+        output[i] = 0.0;
+}
+
+__attribute__((target("avx512f")))
+static int find_peak_avx512(double *buf, int len)
+{
+    int i = 0;
+    __m512i mask = _mm512_set1_epi64(0x7fffffffffffffffLL);
+    __m512d best = _mm512_setzero_pd();
+    double lanes[4];
+    double peak;
+    __m512d target;
+    for(; i + 8 <= len; i += 8)
+        best = _mm512_max_pd(_mm512_castsi512_pd(_mm512_and_epi64(_mm512_castpd_si512(_mm512_loadu_pd(&buf[i])), mask)), best);
+    _mm256_storeu_pd(lanes, _mm256_max_pd(_mm512_castpd512_pd256(best), _mm512_extractf64x4_pd(best, 1)));
+    peak = fmax(fmax(lanes[0], lanes[1]), fmax(lanes[2], lanes[3]));
+    for(; i < len; i++)
+        peak = fmax(peak, fabs(buf[i]));
+    target = _mm512_set1_pd(peak);
+    for(i = 0; i + 8 <= len; i += 8)
+    {
+        __mmask8 m = _mm512_cmp_pd_mask(_mm512_castsi512_pd(_mm512_and_epi64(_mm512_castpd_si512(_mm512_loadu_pd(&buf[i])), mask)), target,
+                                        _CMP_EQ_OQ);
+        if(m)
+            return i + __builtin_ctz(m);
+    }
+    for(; i < len; i++)
+    {
+        if(fabs(buf[i]) == peak)
+            return i;
+    }
+    return -1;
+}
+
+__attribute__((target("avx512f")))
+static void unpack_avx512(const unsigned char *in, int bits, double *output, long bytes)
+{
+    long b = 0;
+    switch(bits)
+    {
+        case 1:
+            for(; b < bytes; b++)
+                _mm512_storeu_pd(&output[b * 8], _mm512_loadu_pd(unpack_lut1[in[b]]));
+            break;
+        case 2:
+            for(; b + 2 <= bytes; b += 2)
+                _mm512_storeu_pd(&output[b * 4], _mm512_insertf64x4(_mm512_castpd256_pd512(_mm256_loadu_pd(unpack_lut2[in[b]])),
+                                 _mm256_loadu_pd(unpack_lut2[in[b + 1]]), 1));
+            break;
+        case 8:
+            for(; b + 8 <= bytes; b += 8)
+            {
+                long long word;
+                memcpy(&word, &in[b], sizeof(long long));
+                _mm512_storeu_pd(&output[b], _mm512_i32gather_pd(_mm256_cvtepu8_epi32(_mm_cvtsi64_si128(word)), unpack_lut8[0],
+                                 sizeof(double)));
+            }
+            break;
+        default:
+            break;
+    }
+    unpack_avx2(&in[b], bits, &output[b * (8 / bits)], bytes - b);
+}
+
+#endif
+
+static vlbi_func_block_t product_kernel = NULL;
+static vlbi_func_block_t coverage_kernel = NULL;
+static vlbi_func_block_t complex_multiply_conjugate_kernel = NULL;
+static int (*find_peak_kernel)(double *buf, int len) = NULL;
+static void (*unpack_kernel)(const unsigned char *in, int bits, double *output, long bytes) = NULL;
+static const char *kernels_isa = NULL;
+static pthread_once_t kernels_once = PTHREAD_ONCE_INIT;
+
+static void select_kernels(void)
+{
+    vlbi_func_block_t product = product_generic;
+    vlbi_func_block_t coverage = coverage_generic;
+    vlbi_func_block_t complex_multiply_conjugate = complex_multiply_conjugate_generic;
+    int (*find_peak)(double *buf, int len) = find_peak_generic;
+    void (*unpack)(const unsigned char *in, int bits, double *output, long bytes) = unpack_generic;
+    const char *isa = "generic";
+    init_unpack_luts();
+#ifdef VLBI_KERNELS_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx512f"))
+    {
+        product = product_avx512;
+        coverage = coverage_avx512;
+        complex_multiply_conjugate = complex_multiply_conjugate_avx512;
+        find_peak = find_peak_avx512;
+        unpack = unpack_avx512;
+        isa = "avx512f";
+    }
+    else if(__builtin_cpu_supports("avx2"))
+    {
+        product = product_avx2;
+        coverage = coverage_avx2;
+        complex_multiply_conjugate = complex_multiply_conjugate_avx2;
+        find_peak = find_peak_avx2;
+        unpack = unpack_avx2;
+        isa = "avx2";
+    }
+#endif
+    product_kernel = product;
+    coverage_kernel = coverage;
+    complex_multiply_conjugate_kernel = complex_multiply_conjugate;
+    find_peak_kernel = find_peak;
+    unpack_kernel = unpack;
+    kernels_isa = isa;
+}
+
+const char *vlbi_block_kernels_isa(void)
+{
+    pthread_once(&kernels_once, select_kernels);
+    return kernels_isa;
+}
+
+void vlbi_block_product(double **inputs, int count, double *output, int len)
+{
+    pthread_once(&kernels_once, select_kernels);
+    product_kernel(inputs, count, output, len);
+}
+
+void vlbi_block_coverage(double **inputs, int count, double *output, int len)
+{
+    pthread_once(&kernels_once, select_kernels);
+    coverage_kernel(inputs, count, output, len);
+}
+
+void vlbi_block_complex_multiply_conjugate(double **inputs, int count, double *output, int len)
+{
+    pthread_once(&kernels_once, select_kernels);
+    complex_multiply_conjugate_kernel(inputs, count, output, len);
+}
+
+int vlbi_block_find_peak(double *buf, int len)
+{
+    pthread_once(&kernels_once, select_kernels);
+    return find_peak_kernel(buf, len);
+}
+
+void vlbi_block_unpack(const unsigned char *in, int bits, long first, double *output, int len)
+{
+    int per, i = 0, s;
+    long byte;
+    const double *lut;
+    pthread_once(&kernels_once, select_kernels);
+    lut = unpack_lut(bits);
+    if(lut == NULL || len < 1)
+        return;
+    per = 8 / bits;
+    byte = first / per;
+    s = (int)(first % per);
+    if(s > 0)
+    {
+        for(; s < per && i < len; s++, i++)
+            output[i] = lut[in[byte] * per + s];
+        byte++;
+    }
+    unpack_kernel(&in[byte], bits, &output[i], (len - i) / per);
+    byte += (len - i) / per;
+    i += (len - i) / per * per;
+    for(s = 0; i < len; s++, i++)
+        output[i] = lut[in[byte] * per + s];
+}
@@ -17,8 +17,114 @@
 */
 
 #include <dsp.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "node.h"
 
+template <typename T>
+static void convert(T *data, long samples, double step, long length, long first, int len, double *out)
+{
+    long start = Max(0L, Min((long)len, -first));
+    long end = Max(start, Min((long)len, length - first));
+    for(long i = 0; i < start; i++)
+        out[i] = 0.0;
+    if(step == 1.0)
+    {
+        for(long i = start; i < end; i++)
+            out[i] = (double)data[first + i];
+    }
+    else
+    {
+        for(long i = start; i < end; i++)
+            out[i] = (double)data[Min((long)((first + i) * step), samples - 1)];
+    }
+    for(long i = end; i < len; i++)
+        out[i] = 0.0;
+}
+
+template <typename T>
+static void gather(T *data, long samples, double step, long length, int *indexes, int stride, int len, double *out,
+                   unsigned char *missing)
+{
+    for(int x = 0; x < len; x++)
+    {
+        long idx = indexes[x * stride];
+        bool valid = (idx >= 0 && idx < length);
+        out[x] = valid ? (double)data[step == 1.0 ? idx : Min((long)(idx * step), samples - 1)] : 0.0;
+        missing[x] |= !valid;
+    }
+}
+
+static void convert_packed(unsigned char *data, int bits, long samples, double step, long length, long first, int len,
+                           double *out)
+{
+    long start = Max(0L, Min((long)len, -first));
+    long end = Max(start, Min((long)len, length - first));
+    for(long i = 0; i < start; i++)
+        out[i] = 0.0;
+    if(step == 1.0)
+        vlbi_block_unpack(data, bits, first + start, &out[start], (int)(end - start));
+    else
+    {
+        for(long i = start; i < end; i++)
+            vlbi_block_unpack(data, bits, Min((long)((first + i) * step), samples - 1), &out[i], 1);
+    }
+    for(long i = end; i < len; i++)
+        out[i] = 0.0;
+}
+
+static void gather_packed(unsigned char *data, int bits, long samples, double step, long length, int *indexes, int stride,
+                          int len, double *out, unsigned char *missing)
+{
+    int x = 0;
+    while(x < len)
+    {
+        long idx = indexes[x * stride];
+        if(idx < 0 || idx >= length)
+        {
+            out[x] = 0.0;
+            missing[x] = 1;
+            x++;
+            continue;
+        }
+        if(step != 1.0)
+        {
+            vlbi_block_unpack(data, bits, Min((long)(idx * step), samples - 1), &out[x], 1);
+            x++;
+            continue;
+        }
+        int run = 1;
+        while(x + run < len && idx + run < length && indexes[(x + run) * stride] == idx + run)
+            run++;
+        vlbi_block_unpack(data, bits, idx, &out[x], run);
+        x += run;
+    }
+}
+
+static int sample_bits(vlbi_sample_type type)
+{
+    switch(type)
+    {
+        case vlbi_sample_int8:
+            return 8;
+        case vlbi_sample_int16:
+            return 16;
+        case vlbi_sample_float:
+            return 32;
+        case vlbi_sample_packed1:
+            return 1;
+        case vlbi_sample_packed2:
+            return 2;
+        case vlbi_sample_packed4:
+            return 4;
+        case vlbi_sample_packed8:
+            return 8;
+        default:
+            return 0;
+    }
+}
+
 VLBINode::VLBINode(dsp_stream_p stream, const char* name, int index, bool geographic_coordinates)
 {
     setStream(stream);
@@ -26,14 +132,26 @@ VLBINode::VLBINode(dsp_stream_p stream, const char* name, int index, bool geogra
     Index = index;
     setLocation(0);
     Geo = geographic_coordinates;
+    Capacity = getStream()->len;
+    Origin = getStream()->starttimeutc;
 }
 
 VLBINode::~VLBINode()
 {
+    release();
 }
 
 void VLBINode::setSampleRate(double samplerate)
 {
+    if(isNative())
+    {
+        if(NativeRate <= 0.0)
+            NativeRate = samplerate;
+        if(samplerate > 0.0)
+            Step = NativeRate / samplerate;
+        getStream()->samplerate = samplerate;
+        return;
+    }
     getStream()->align_info.factor[0] = getStream()->samplerate / samplerate;
     if(getStream()->align_info.factor[0] != 1.0)
     {
@@ -41,6 +159,255 @@ void VLBINode::setSampleRate(double samplerate)
         getStream()->len *= getStream()->align_info.factor[0];
         dsp_stream_alloc_buffer(getStream(), getStream()->len);
         dsp_stream_scale(getStream());
+        Capacity = getStream()->len;
+        Dropped *= getStream()->align_info.factor[0];
     }
     getStream()->samplerate = samplerate;
 }
+
+void VLBINode::reserve(int len)
+{
+    dsp_stream_p stream = getStream();
+    if(len <= Capacity)
+        return;
+    int size = stream->sizes[0];
+    Capacity = Max(len, Capacity * 2);
+    dsp_stream_set_dim(stream, 0, Capacity);
+    dsp_stream_alloc_buffer(stream, Capacity);
+    dsp_stream_set_dim(stream, 0, size);
+}
+
+void VLBINode::trim()
+{
+    dsp_stream_p stream = getStream();
+    if(Retention <= 0.0 || getSampleRate() <= 0.0 || isNative())
+        return;
+    int retained = (int)Max(1.0, ceil(Retention * getSampleRate()));
+    if(stream->len <= retained + retained / 2)
+        return;
+    int dropped = stream->len - retained;
+    memmove(stream->buf, &stream->buf[dropped], sizeof(dsp_t) * retained);
+    if(Moving)
+        memmove(stream->location, &stream->location[dropped], sizeof(dsp_location) * retained);
+    dsp_stream_set_dim(stream, 0, retained);
+    Dropped += dropped;
+    double offset = Dropped / getSampleRate();
+    long nsec = Origin.tv_nsec + (long)((offset - floor(offset)) * 1000000000.0);
+    stream->starttimeutc.tv_sec = Origin.tv_sec + (time_t)floor(offset) + nsec / 1000000000;
+    stream->starttimeutc.tv_nsec = nsec % 1000000000;
+}
+
+void VLBINode::setRetention(double seconds)
+{
+    Retention = seconds;
+    trim();
+}
+
+void VLBINode::append(dsp_t *buf, int len, dsp_location *locations)
+{
+    dsp_stream_p stream = getStream();
+    if(len < 1)
+        return;
+    if(isNative())
+    {
+        perr("%s: samples cannot be appended to memory mapped or packed nodes\n", getName());
+        return;
+    }
+    if(stream->len != stream->sizes[0])
+    {
+        perr("%s: samples can be appended to one dimensional nodes only\n", getName());
+        return;
+    }
+    int start = stream->len;
+    reserve(start + len);
+    dsp_stream_set_dim(stream, 0, start + len);
+    memcpy(&stream->buf[start], buf, sizeof(dsp_t) * len);
+    if(locations != nullptr)
+        Moving = true;
+    for(int x = 0; x < len; x++)
+    {
+        if(locations != nullptr)
+            stream->location[start + x] = locations[x];
+        else
+            stream->location[start + x] = stream->location[Moving && start > 0 ? start - 1 : 0];
+    }
+    trim();
+}
+
+bool VLBINode::map(const char *filename, off_t offset, vlbi_sample_type type, long len)
+{
+    int bits = sample_bits(type);
+    if(bits == 0)
+    {
+        perr("%s: unknown sample type %d\n", getName(), type);
+        return false;
+    }
+    int fd = open(filename, O_RDONLY);
+    if(fd < 0)
+    {
+        perr("%s: cannot open %s\n", getName(), filename);
+        return false;
+    }
+    struct stat st;
+    if(offset < 0 || fstat(fd, &st) < 0 || st.st_size < offset + (bits + 7) / 8)
+    {
+        perr("%s: %s holds no samples past offset %ld\n", getName(), filename, (long)offset);
+        close(fd);
+        return false;
+    }
+    long available = (long)((st.st_size - offset) * 8 / bits);
+    if(len > available)
+        pwarn("%s: %s holds %ld samples only\n", getName(), filename, available);
+    if(len <= 0 || len > available)
+        len = available;
+    off_t start = offset - offset % sysconf(_SC_PAGESIZE);
+    size_t length = (size_t)(offset - start) + ((size_t)len * bits + 7) / 8;
+    void *mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, start);
+    close(fd);
+    if(mapping == MAP_FAILED)
+    {
+        perr("%s: cannot map %s\n", getName(), filename);
+        return false;
+    }
+    posix_madvise(mapping, length, POSIX_MADV_SEQUENTIAL);
+    release();
+    Mapping = mapping;
+    MappingSize = length;
+    Data = (char*)mapping + (offset - start);
+    MappedFile = strdup(filename);
+    MappedOffset = offset;
+    SampleType = type;
+    Samples = len;
+    NativeRate = getSampleRate();
+    Step = 1.0;
+    pgarb("%s: %ld samples mapped from %s\n", getName(), Samples, filename);
+    return true;
+}
+
+bool VLBINode::pack(const void *buf, vlbi_sample_type type, long len)
+{
+    int bits = sample_bits(type);
+    if(bits == 0)
+    {
+        perr("%s: unknown sample type %d\n", getName(), type);
+        return false;
+    }
+    if(len < 1)
+        return false;
+    size_t size = ((size_t)len * bits + 7) / 8;
+    void *data = malloc(size);
+    if(data == nullptr)
+    {
+        perr("%s: cannot allocate %ld samples\n", getName(), len);
+        return false;
+    }
+    memcpy(data, buf, size);
+    release();
+    Data = data;
+    SampleType = type;
+    Samples = len;
+    NativeRate = getSampleRate();
+    Step = 1.0;
+    return true;
+}
+
+bool VLBINode::copySamples(VLBINode *node)
+{
+    if(node->isMapped())
+    {
+        if(!map(node->MappedFile, node->MappedOffset, node->SampleType, node->Samples))
+            return false;
+    }
+    else if(!node->isNative() || !pack(node->Data, node->SampleType, node->Samples))
+        return false;
+    NativeRate = node->NativeRate;
+    Step = node->Step;
+    return true;
+}
+
+void VLBINode::release()
+{
+    if(isMapped())
+    {
+        munmap(Mapping, MappingSize);
+        free(MappedFile);
+    }
+    else if(isNative())
+        free(Data);
+    Mapping = nullptr;
+    MappingSize = 0;
+    Data = nullptr;
+    MappedFile = nullptr;
+    Samples = 0;
+}
+
+dsp_t VLBINode::getSample(long idx)
+{
+    if(idx < 0 || idx >= getLength())
+        return 0.0;
+    if(!isNative())
+        return getStream()->buf[idx];
+    long i = Min((long)(idx * Step), Samples - 1);
+    double value = 0.0;
+    switch(SampleType)
+    {
+        case vlbi_sample_int8:
+            return ((int8_t*)Data)[i];
+        case vlbi_sample_int16:
+            return ((int16_t*)Data)[i];
+        case vlbi_sample_float:
+            return ((float*)Data)[i];
+        default:
+            vlbi_block_unpack((unsigned char*)Data, sample_bits(SampleType), i, &value, 1);
+            return value;
+    }
+}
+
+void VLBINode::getSamples(long first, int len, double *out)
+{
+    if(!isNative())
+    {
+        convert(getStream()->buf, getStream()->len, 1.0, getStream()->len, first, len, out);
+        return;
+    }
+    switch(SampleType)
+    {
+        case vlbi_sample_int8:
+            convert((int8_t*)Data, Samples, Step, getLength(), first, len, out);
+            break;
+        case vlbi_sample_int16:
+            convert((int16_t*)Data, Samples, Step, getLength(), first, len, out);
+            break;
+        case vlbi_sample_float:
+            convert((float*)Data, Samples, Step, getLength(), first, len, out);
+            break;
+        default:
+            convert_packed((unsigned char*)Data, sample_bits(SampleType), Samples, Step, getLength(), first, len, out);
+            break;
+    }
+}
+
+void VLBINode::getSamples(int *indexes, int stride, int len, double *out, unsigned char *missing)
+{
+    if(!isNative())
+    {
+        gather(getStream()->buf, getStream()->len, 1.0, getStream()->len, indexes, stride, len, out, missing);
+        return;
+    }
+    switch(SampleType)
+    {
+        case vlbi_sample_int8:
+            gather((int8_t*)Data, Samples, Step, getLength(), indexes, stride, len, out, missing);
+            break;
+        case vlbi_sample_int16:
+            gather((int16_t*)Data, Samples, Step, getLength(), indexes, stride, len, out, missing);
+            break;
+        case vlbi_sample_float:
+            gather((float*)Data, Samples, Step, getLength(), indexes, stride, len, out, missing);
+            break;
+        default:
+            gather_packed((unsigned char*)Data, sample_bits(SampleType), Samples, Step, getLength(), indexes, stride, len, out,
+                          missing);
+            break;
+    }
+}
@@ -23,6 +23,7 @@
 #include <cstdlib>
 #include <cstdint>
 #include <cstring>
+#include <sys/types.h>
 #include <vlbi.h>
 
 class VLBINode
@@ -78,6 +79,10 @@ class VLBINode
         {
             return Location;
         }
+        inline double* getLocation(int x)
+        {
+            return getStream()->location[Max(0, Min(x, getStream()->len - 1))].coordinates;
+        }
         inline double* getGeographicLocation()
         {
             GeographicLocation[0] = getLocation()[0];
@@ -142,7 +147,49 @@ class VLBINode
         {
             return StationLocation;
         }
+        void append(dsp_t *buf, int len, dsp_location *locations = nullptr);
+        void setRetention(double seconds);
+        inline double getRetention()
+        {
+            return Retention;
+        }
+
+        bool map(const char *filename, off_t offset, vlbi_sample_type type, long len);
+        bool pack(const void *buf, vlbi_sample_type type, long len);
+        bool copySamples(VLBINode *node);
+        inline bool isNative()
+        {
+            return Data != nullptr;
+        }
+        inline bool isMapped()
+        {
+            return Mapping != nullptr;
+        }
+        inline long getLength()
+        {
+            return isNative() ? (long)floor(Samples / Step) : getStream()->len;
+        }
+        dsp_t getSample(long idx);
+        void getSamples(long first, int len, double *out);
+        void getSamples(int *indexes, int stride, int len, double *out, unsigned char *missing);
     private:
+        void reserve(int len);
+        void trim();
+        void release();
+        void *Mapping { nullptr };
+        size_t MappingSize { 0 };
+        void *Data { nullptr };
+        char *MappedFile { nullptr };
+        off_t MappedOffset { 0 };
+        vlbi_sample_type SampleType { vlbi_sample_float };
+        long Samples { 0 };
+        double NativeRate { 0 };
+        double Step { 1.0 };
+        double Retention { 0 };
+        int Capacity { 0 };
+        long long Dropped { 0 };
+        timespec Origin;
+        bool Moving { false };
         dsp_location StationLocation;
         double GeographicLocation[3];
         double Location[3];
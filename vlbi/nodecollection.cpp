@@ -22,17 +22,64 @@
 #include "nodecollection.h"
 #include "baselinecollection.h"
 #include "modelcollection.h"
+#include "delaymodel.h"
+#include "gridder.h"
+#include "visibilitytable.h"
+#include "closures.h"
 
 NodeCollection::NodeCollection() : VLBICollection::VLBICollection()
 {
     relative = false;
     models = new ModelCollection();
     baselines = new BaselineCollection(this);
+    delay_model = new VLBIDelayModel(this);
+    gridder = new VLBIGridder();
+    visibilities = new VLBIVisibilityTable();
+    closures = new VLBIClosures();
     setCorrelationOrder(2);
 }
 
 NodeCollection::~NodeCollection()
 {
+    delete closures;
+    delete visibilities;
+    delete gridder;
+    delete delay_model;
+    delete baselines;
+    delete models;
+}
+
+void NodeCollection::invalidate(const char *node)
+{
+    delay_model->invalidate();
+    visibilities->clear();
+    if(node == nullptr)
+    {
+        plot_states.clear();
+        return;
+    }
+    for(auto state = plot_states.begin(); state != plot_states.end();)
+    {
+        bool involved = false;
+        for(auto progress = state->second.progress.begin(); progress != state->second.progress.end() && !involved; progress++)
+        {
+            std::string name = progress->first;
+            for(size_t start = 0, end = 0; end != std::string::npos && !involved; start = end + 1)
+            {
+                end = name.find('*', start);
+                involved = !name.compare(start, end == std::string::npos ? std::string::npos : end - start, node);
+            }
+        }
+        if(involved)
+        {
+            state = plot_states.erase(state);
+        }
+        else
+        {
+            state->second.locations.erase(node);
+            state++;
+        }
+    }
 }
 
 BaselineCollection* NodeCollection::getBaselines()
@@ -47,12 +94,26 @@ BaselineCollection* NodeCollection::getBaselines()
 void NodeCollection::add(VLBINode * element)
 {
     VLBICollection::add(element, element->getName());
+    invalidate(element->getName());
+    setCorrelationOrder(getCorrelationOrder());
+}
+
+void NodeCollection::add(VLBINode **elements, int num_elements)
+{
+    if(num_elements < 1)
+        return;
+    for(int i = 0; i < num_elements; i++)
+    {
+        VLBICollection::add(elements[i], elements[i]->getName());
+        invalidate(elements[i]->getName());
+    }
     setCorrelationOrder(getCorrelationOrder());
 }
 
 void NodeCollection::remove(const char* name)
 {
     VLBICollection::remove(name);
+    invalidate(name);
     setCorrelationOrder(getCorrelationOrder());
 }
 
@@ -74,6 +135,7 @@ bool NodeCollection::contains(const char* element)
 void NodeCollection::setRelative(bool value)
 {
     relative = value;
+    invalidate();
     baselines->setRelative(value);
     for(int x = 0; x < count(); x++)
     {
@@ -21,9 +21,38 @@
 
 #include "collection.h"
 #include "node.h"
+#include <map>
+#include <string>
+#include <vector>
 
 class BaselineCollection;
 class ModelCollection;
+class VLBIDelayModel;
+class VLBIGridder;
+class VLBIVisibilityTable;
+class VLBIClosures;
+
+/**
+* The parameters of an incremental UV plot, including the station and node locations, by node name, it was computed with,
+* its plane before the model gets stretched and the time up to which each baseline, by name, has already been accumulated into it.
+*/
+struct vlbi_plot_state
+{
+    int u;
+    int v;
+    double target[3];
+    double freq;
+    double sr;
+    bool nodelay;
+    bool moving_baseline;
+    vlbi_func2_t delegate;
+    vlbi_func_block_t block_delegate;
+    bool relative;
+    dsp_location station;
+    std::map<std::string, std::vector<double>> locations;
+    std::map<std::string, double> progress;
+    std::vector<dsp_t> plane;
+};
 
 class NodeCollection : public VLBICollection
 {
@@ -31,6 +60,7 @@ class NodeCollection : public VLBICollection
         NodeCollection();
         ~NodeCollection();
         void add(VLBINode *element);
+        void add(VLBINode **elements, int num_elements);
         void removeAt(int index);
         VLBINode *get(const char* name);
         void remove(const char* element);
@@ -42,6 +72,22 @@ class NodeCollection : public VLBICollection
         {
             return models;
         }
+        inline VLBIDelayModel* getDelayModel()
+        {
+            return delay_model;
+        }
+        inline VLBIGridder* getGridder()
+        {
+            return gridder;
+        }
+        inline VLBIVisibilityTable* getVisibilities()
+        {
+            return visibilities;
+        }
+        inline VLBIClosures* getClosures()
+        {
+            return closures;
+        }
         dsp_location *stationLocation()
         {
             return &station;
@@ -53,13 +99,38 @@ class NodeCollection : public VLBICollection
         void setRelative(bool value);
         void setCorrelationOrder(int order);
         inline int getCorrelationOrder() { return correlation_order; }
+        inline void setAccumulationMode(vlbi_accumulation_mode mode) { accumulation_mode = mode; }
+        inline vlbi_accumulation_mode getAccumulationMode() { return accumulation_mode; }
+        inline void setChunkSize(double seconds) { chunk_size = seconds; }
+        inline double getChunkSize() { return chunk_size; }
+        inline void setIncremental(bool value) { incremental = value; }
+        inline bool isIncremental() { return incremental; }
+        inline void setAveraging(double fov) { averaging_fov = fov; }
+        inline double getAveraging() { return averaging_fov; }
+        inline void setSubbands(double *freqs, int count, bool cube) { subbands.assign(freqs, freqs + Max(0, count)); subbands_cube = cube; }
+        inline std::vector<double> *getSubbands() { return &subbands; }
+        inline bool isCube() { return subbands_cube; }
+        inline vlbi_plot_state *getPlotState(const char *name) { return &plot_states[name]; }
+        inline void removePlotState(const char *name) { plot_states.erase(name); }
+        void invalidate(const char *node = nullptr);
 
     private:
         int  correlation_order {2};
+        vlbi_accumulation_mode accumulation_mode { vlbi_accumulation_shared };
+        double chunk_size {0};
+        bool incremental { false };
+        double averaging_fov { 0 };
+        std::vector<double> subbands;
+        bool subbands_cube { false };
+        std::map<std::string, vlbi_plot_state> plot_states;
         BaselineCollection *baselines;
         bool relative;
         dsp_location station;
         ModelCollection *models;
+        VLBIDelayModel *delay_model;
+        VLBIGridder *gridder;
+        VLBIVisibilityTable *visibilities;
+        VLBIClosures *closures;
 };
 
 #endif //_NODECOLLECTION_H
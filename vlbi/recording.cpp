@@ -0,0 +1,339 @@
+/*  OpenVLBI - Open Source Very Long Baseline Interferometry
+*   Copyright © 2017-2023  Ilia Platone
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 2 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along
+*   with this program; if not, write to the Free Software Foundation, Inc.,
+*   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "recording.h"
+#include "nodecollection.h"
+#include <climits>
+#include <sys/stat.h>
+
+static const long mark5b_frame_size = 10016;
+static const int mark5b_header_size = 16;
+static const unsigned int mark5b_sync = 0xABADDEED;
+static const long max_gap_seconds = 4;
+
+static unsigned int word(unsigned char *buf, int index)
+{
+    buf = &buf[index * 4];
+    return (unsigned int)buf[0] | ((unsigned int)buf[1] << 8) | ((unsigned int)buf[2] << 16) | ((unsigned int)buf[3] << 24);
+}
+
+static long bcd(unsigned int value, int digits)
+{
+    long ret = 0;
+    for(int d = digits - 1; d >= 0; d--)
+        ret = ret * 10 + ((value >> (d * 4)) & 0xf);
+    return ret;
+}
+
+static timespec unix_time(long seconds)
+{
+    timespec ret = vlbi_time_mktimespec(1970, 1, 1, 0, 0, 0, 0);
+    ret.tv_sec += seconds;
+    return ret;
+}
+
+VLBIRecording::VLBIRecording(NodeCollection *nodes, vlbi_recording_format format, const char *name, dsp_location *location,
+                             bool geo)
+{
+    Nodes = nodes;
+    Format = format;
+    Name = name;
+    if(location != nullptr)
+        Location = *location;
+    else
+        memset(&Location, 0, sizeof(dsp_location));
+    Geo = geo;
+    static const unsigned char order[4] = { 0, 2, 1, 3 };
+    for(int b = 0; b < 256; b++)
+        Mark5BLevels[b] = order[b & 3] | (order[(b >> 2) & 3] << 2) | (order[(b >> 4) & 3] << 4) | (order[b >> 6] << 6);
+}
+
+VLBIRecording::~VLBIRecording()
+{
+    if(File != nullptr)
+        fclose(File);
+}
+
+bool VLBIRecording::readHeader(frame *f)
+{
+    unsigned char header[32];
+    off_t pos = ftello(File);
+    if(fread(header, 1, 16, File) != 16)
+    {
+        clearerr(File);
+        fseeko(File, pos, SEEK_SET);
+        return false;
+    }
+    if(Format == vlbi_recording_mark5b)
+    {
+        if(word(header, 0) != mark5b_sync)
+        {
+            perr("%s: Mark5B sync word not found at offset %ld\n", Name.c_str(), (long)pos);
+            fseeko(File, pos, SEEK_SET);
+            return false;
+        }
+        f->valid = true;
+        f->number = word(header, 1) & 0x7fff;
+        f->second = bcd(word(header, 2) >> 20, 3) * 86400 + bcd(word(header, 2) & 0xfffff, 5);
+        f->thread = 0;
+        f->channels = Channels;
+        f->bits = Bits;
+        f->length = mark5b_frame_size;
+        f->header = mark5b_header_size;
+        return true;
+    }
+    unsigned int w0 = word(header, 0);
+    unsigned int w2 = word(header, 2);
+    unsigned int w3 = word(header, 3);
+    f->header = ((w0 >> 30) & 1) ? 16 : 32;
+    if(f->header > 16 && fread(&header[16], 1, 16, File) != 16)
+    {
+        clearerr(File);
+        fseeko(File, pos, SEEK_SET);
+        return false;
+    }
+    f->valid = !((w0 >> 31) & 1) && !((w3 >> 31) & 1);
+    f->second = w0 & 0x3fffffff;
+    f->number = word(header, 1) & 0xffffff;
+    f->channels = 1 << ((w2 >> 24) & 0x1f);
+    f->length = (long)(w2 & 0xffffff) * 8;
+    f->bits = ((w3 >> 26) & 0x1f) + 1;
+    f->thread = (w3 >> 16) & 0x3ff;
+    if(f->length <= f->header)
+    {
+        perr("%s: VDIF frame with invalid length at offset %ld\n", Name.c_str(), (long)pos);
+        fseeko(File, pos, SEEK_SET);
+        return false;
+    }
+    return true;
+}
+
+bool VLBIRecording::open(const char *filename, double samplerate, int channels, int bits)
+{
+    pfunc;
+    File = fopen(filename, "rb");
+    if(File == nullptr)
+    {
+        perr("cannot open %s\n", filename);
+        return false;
+    }
+    Channels = Max(1, channels);
+    Bits = bits;
+    frame f;
+    if(!readHeader(&f))
+    {
+        perr("%s: no frames in %s\n", Name.c_str(), filename);
+        return false;
+    }
+    unsigned char header[16];
+    fseeko(File, 0, SEEK_SET);
+    if(fread(header, 1, 16, File) != 16)
+        return false;
+    if(Format == vlbi_recording_mark5b)
+    {
+        struct stat st;
+        long reference = (stat(filename, &st) == 0 ? st.st_mtime : time(nullptr)) / 86400 + 40587;
+        long day = f.second / 86400;
+        long mjd = reference - ((reference - day) % 1000 + 1000) % 1000;
+        Epoch = unix_time((mjd - day - 40587) * 86400);
+    }
+    else
+    {
+        int epoch = (word(header, 1) >> 24) & 0x3f;
+        Epoch = vlbi_time_mktimespec(2000 + epoch / 2, (epoch % 2) ? 7 : 1, 1, 0, 0, 0, 0);
+        if((word(header, 3) >> 31) & 1)
+        {
+            perr("%s: complex VDIF samples are not supported\n", Name.c_str());
+            return false;
+        }
+    }
+    Channels = f.channels;
+    Bits = f.bits;
+    if(Bits != 1 && Bits != 2 && Bits != 4 && Bits != 8)
+    {
+        perr("%s: %d bits samples are not supported\n", Name.c_str(), Bits);
+        return false;
+    }
+    SamplesPerFrame = (f.length - f.header) * 8 / (Bits * Channels);
+    StartSecond = f.second;
+    StartFrame = f.number;
+    long highest = 0;
+    bool complete = false;
+    fseeko(File, 0, SEEK_SET);
+    while(readHeader(&f))
+    {
+        complete = (f.second >= StartSecond + 2);
+        if(complete)
+            break;
+        if(std::find(threads.begin(), threads.end(), f.thread) == threads.end())
+            threads.push_back(f.thread);
+        highest = Max(highest, f.number);
+        if(fseeko(File, f.length - f.header, SEEK_CUR) != 0)
+            break;
+    }
+    clearerr(File);
+    fseeko(File, 0, SEEK_SET);
+    std::sort(threads.begin(), threads.end());
+    FramesPerSecond = highest + 1;
+    if(samplerate > 0.0)
+        FramesPerSecond = (long)Max(1.0, round(samplerate / SamplesPerFrame));
+    else if(!complete)
+        pwarn("%s: less than two seconds recorded, the frame rate may be underestimated\n", Name.c_str());
+    SampleRate = (double)FramesPerSecond * SamplesPerFrame;
+    for(int t : threads)
+    {
+        for(int c = 0; c < Channels; c++)
+        {
+            char name[DSP_NAME_SIZE];
+            if(threads.size() > 1 || Channels > 1)
+                snprintf(name, DSP_NAME_SIZE, "%s_%d_%d", Name.c_str(), t, c);
+            else
+                snprintf(name, DSP_NAME_SIZE, "%s", Name.c_str());
+            names.push_back(name);
+        }
+    }
+    next.assign(threads.size(), 0);
+    resync.assign(threads.size(), -1);
+    created.assign(names.size(), false);
+    pending.resize(names.size());
+    pgarb("%s: %ld frames per second of %ld samples, %d threads, %d channels, %d bits\n", Name.c_str(), FramesPerSecond,
+          SamplesPerFrame, (int)threads.size(), Channels, Bits);
+    return true;
+}
+
+void VLBIRecording::pad(int stream, long frames)
+{
+    for(int c = 0; c < Channels; c++)
+    {
+        std::vector<dsp_t> *p = &pending[stream * Channels + c];
+        p->resize(p->size() + (size_t)(frames * SamplesPerFrame), 0.0);
+    }
+}
+
+void VLBIRecording::decode(frame *f, unsigned char *data, int stream)
+{
+    long len = SamplesPerFrame * Channels;
+    if(Format == vlbi_recording_mark5b && Bits == 2)
+    {
+        for(long b = 0; b < f->length - f->header; b++)
+            data[b] = Mark5BLevels[data[b]];
+    }
+    samples.resize((size_t)len);
+    vlbi_block_unpack(data, Bits, 0, samples.data(), (int)len);
+    for(int c = 0; c < Channels; c++)
+    {
+        std::vector<dsp_t> *p = &pending[stream * Channels + c];
+        size_t start = p->size();
+        p->resize(start + (size_t)SamplesPerFrame);
+        dsp_t *out = &p->at(start);
+        for(long s = 0; s < SamplesPerFrame; s++)
+            out[s] = samples[s * Channels + c];
+    }
+}
+
+void VLBIRecording::flush()
+{
+    double offset = (double)StartFrame / FramesPerSecond;
+    for(size_t n = 0; n < names.size(); n++)
+    {
+        std::vector<dsp_t> *p = &pending[n];
+        int len = (int)p->size();
+        if(len < 1)
+            continue;
+        if(!created[n])
+        {
+            dsp_stream_p stream = dsp_stream_new();
+            dsp_stream_add_dim(stream, len);
+            dsp_stream_alloc_buffer(stream, len);
+            memcpy(stream->buf, p->data(), sizeof(dsp_t) * len);
+            for(int x = 0; x < len; x++)
+                stream->location[x] = Location;
+            stream->samplerate = SampleRate;
+            stream->starttimeutc = Epoch;
+            stream->starttimeutc.tv_sec += StartSecond;
+            stream->starttimeutc.tv_nsec += (long)(offset * 1000000000.0);
+            Nodes->add(new VLBINode(stream, names[n].c_str(), Nodes->count(), Geo));
+            created[n] = true;
+        }
+        else if(Nodes->contains(names[n].c_str()))
+            Nodes->get(names[n].c_str())->append(p->data(), len);
+        p->clear();
+    }
+}
+
+long VLBIRecording::read(double seconds)
+{
+    pfunc;
+    if(File == nullptr || threads.empty())
+        return 0;
+    long target = (seconds > 0.0 ? (long)ceil(seconds * SampleRate) : LONG_MAX);
+    long produced = 0;
+    std::vector<long> first = next;
+    frame f;
+    while(produced < target)
+    {
+        off_t pos = ftello(File);
+        if(!readHeader(&f))
+            break;
+        payload.resize((size_t)(f.length - f.header));
+        if(fread(payload.data(), 1, payload.size(), File) != payload.size())
+        {
+            clearerr(File);
+            fseeko(File, pos, SEEK_SET);
+            break;
+        }
+        int t = (int)(std::find(threads.begin(), threads.end(), f.thread) - threads.begin());
+        if(t == (int)threads.size())
+            continue;
+        long index = (f.second - StartSecond) * FramesPerSecond + f.number - StartFrame;
+        if(index < next[t])
+            continue;
+        long gap = index - next[t];
+        if(gap > max_gap_seconds * FramesPerSecond)
+        {
+            if(resync[t] < 0 || index != resync[t] + 1)
+            {
+                pwarn("%s: thread %d frame %ld is %ld frames ahead, skipped\n", Name.c_str(), f.thread, index, gap);
+                resync[t] = index;
+                continue;
+            }
+            pwarn("%s: thread %d resynced %ld frames ahead, the gap is zero filled\n", Name.c_str(), f.thread, gap);
+        }
+        resync[t] = -1;
+        while(index > next[t])
+        {
+            long frames = Min(index - next[t], FramesPerSecond);
+            pad(t, frames);
+            missing += frames;
+            next[t] += frames;
+            if(frames == FramesPerSecond)
+                flush();
+        }
+        if(!f.valid || f.channels != Channels || f.bits != Bits || f.length - f.header != (long)(SamplesPerFrame * Channels * Bits / 8))
+        {
+            pad(t, 1);
+            missing ++;
+        }
+        else
+            decode(&f, payload.data(), t);
+        next[t] = index + 1;
+        produced = Max(produced, (next[t] - first[t]) * SamplesPerFrame);
+    }
+    flush();
+    return produced;
+}
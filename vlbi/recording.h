@@ -0,0 +1,93 @@
+/*  OpenVLBI - Open Source Very Long Baseline Interferometry
+*   Copyright © 2017-2023  Ilia Platone
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 2 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along
+*   with this program; if not, write to the Free Software Foundation, Inc.,
+*   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#ifndef _RECORDING_H
+#define _RECORDING_H
+
+#include <vlbi.h>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+class NodeCollection;
+
+/**
+* Streaming reader of VDIF and Mark5B recordings.
+* The frame headers of the first seconds are scanned once for the frame rate, the threads and the channels,
+* then each read decodes frames in order, unpacks them with vlbi_block_unpack and appends each thread and channel
+* to its own node. Missing or invalid frames are replaced by zeros, so the nodes keep their time base.
+* A frame more than a few seconds ahead is taken as a corrupt header and skipped, if the next frame of its thread
+* confirms the jump the thread resyncs on it and the gap is zero filled, appending to the nodes one second at a time.
+* Reading stops at the end of the file without consuming a partial frame, so a growing recording can be read again later.
+*/
+class VLBIRecording
+{
+    public:
+        VLBIRecording(NodeCollection *nodes, vlbi_recording_format format, const char *name, dsp_location *location, bool geo);
+        ~VLBIRecording();
+        bool open(const char *filename, double samplerate, int channels, int bits);
+        long read(double seconds);
+        inline long getMissingFrames() { return missing; }
+        inline int getNodesCount() { return (int)std::count(created.begin(), created.end(), true); }
+        inline const char *getNodeName(int index) { return names[index].c_str(); }
+
+    private:
+        struct frame
+        {
+            bool valid;
+            long second;
+            long number;
+            int thread;
+            int channels;
+            int bits;
+            long length;
+            int header;
+        };
+        bool readHeader(frame *f);
+        void decode(frame *f, unsigned char *payload, int stream);
+        void pad(int stream, long frames);
+        void flush();
+
+        NodeCollection *Nodes;
+        vlbi_recording_format Format;
+        std::string Name;
+        dsp_location Location;
+        bool Geo;
+        FILE *File { nullptr };
+        timespec Epoch;
+        double SampleRate { 0 };
+        long FramesPerSecond { 0 };
+        long SamplesPerFrame { 0 };
+        long StartSecond { 0 };
+        long StartFrame { 0 };
+        int Channels { 1 };
+        int Bits { 2 };
+        long missing { 0 };
+        std::vector<int> threads;
+        std::vector<long> next;
+        std::vector<long> resync;
+        unsigned char Mark5BLevels[256];
+        std::vector<std::string> names;
+        std::vector<bool> created;
+        std::vector<std::vector<dsp_t>> pending;
+        std::vector<unsigned char> payload;
+        std::vector<double> samples;
+};
+
+#endif //_RECORDING_H
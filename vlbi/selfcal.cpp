@@ -0,0 +1,210 @@
+/*  OpenVLBI - Open Source Very Long Baseline Interferometry
+*   Copyright © 2017-2023  Ilia Platone
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 2 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along
+*   with this program; if not, write to the Free Software Foundation, Inc.,
+*   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "selfcal.h"
+#include "threadpool.h"
+#include "visibilitytable.h"
+#include <algorithm>
+#include <map>
+
+VLBISelfCal::VLBISelfCal(VLBIThreadPool *pool)
+{
+    Pool = pool;
+}
+
+VLBISelfCal::~VLBISelfCal()
+{
+}
+
+void VLBISelfCal::bin(VLBIVisibilityTable *table, std::vector<solution> *solutions, std::vector<double> *start)
+{
+    double tmin = DBL_MAX;
+    for(int r = 0; r < table->count(); r++)
+        tmin = fmin(tmin, table->getTime()[r]);
+    std::map<long, std::vector<int>> bins;
+    for(int r = 0; r < table->count(); r++)
+    {
+        int id = table->getBaseline()[r];
+        if(table->getFirstStation(id) < 0 || table->getSecondStation(id) < 0)
+            continue;
+        long b = (interval > 0.0 ? (long)floor((table->getTime()[r] - tmin) / interval) : 0);
+        bins[b].push_back(r);
+    }
+    solutions->resize(bins.size());
+    start->resize(bins.size());
+    size_t n = 0;
+    for(std::map<long, std::vector<int>>::iterator it = bins.begin(); it != bins.end(); it++, n++)
+    {
+        solutions->at(n).cal = this;
+        solutions->at(n).table = table;
+        solutions->at(n).rows.swap(it->second);
+        solutions->at(n).iterations = 0;
+        start->at(n) = tmin + it->first * interval;
+    }
+}
+
+void *VLBISelfCal::solveInterval(void *arg)
+{
+    solution *s = (solution*)arg;
+    VLBIVisibilityTable *table = s->table;
+    int stations = table->getStationsCount();
+    bool model = table->hasModel();
+    std::vector<double> g((size_t)stations * 2, 0.0);
+    std::vector<double> num((size_t)stations * 2);
+    std::vector<double> den((size_t)stations);
+    for(int p = 0; p < stations; p++)
+        g[p * 2] = 1.0;
+    for(s->iterations = 0; s->iterations < s->cal->iterations; s->iterations++)
+    {
+        std::fill(num.begin(), num.end(), 0.0);
+        std::fill(den.begin(), den.end(), 0.0);
+        for(size_t n = 0; n < s->rows.size(); n++)
+        {
+            int r = s->rows[n];
+            if(table->getFlags()[r])continue;
+            int id = table->getBaseline()[r];
+            int p = table->getFirstStation(id);
+            int q = table->getSecondStation(id);
+            double wt = table->getWeight()[r];
+            double *vis = table->getVisibility()[r];
+            double mre = (model ? table->getModel()[r][0] : 1.0);
+            double mim = (model ? table->getModel()[r][1] : 0.0);
+            double zre = g[q * 2] * mre + g[q * 2 + 1] * mim;
+            double zim = g[q * 2] * mim - g[q * 2 + 1] * mre;
+            num[p * 2] += wt * (vis[0] * zre + vis[1] * zim);
+            num[p * 2 + 1] += wt * (vis[1] * zre - vis[0] * zim);
+            den[p] += wt * (zre * zre + zim * zim);
+            zre = g[p * 2] * mre - g[p * 2 + 1] * mim;
+            zim = -g[p * 2] * mim - g[p * 2 + 1] * mre;
+            num[q * 2] += wt * (vis[0] * zre - vis[1] * zim);
+            num[q * 2 + 1] += wt * (-vis[1] * zre - vis[0] * zim);
+            den[q] += wt * (zre * zre + zim * zim);
+        }
+        double diff = 0.0;
+        double norm = 0.0;
+        for(int p = 0; p < stations; p++)
+        {
+            if(den[p] <= 0.0)
+                continue;
+            double re = num[p * 2] / den[p];
+            double im = num[p * 2 + 1] / den[p];
+            if(s->iterations % 2)
+            {
+                re = (re + g[p * 2]) / 2.0;
+                im = (im + g[p * 2 + 1]) / 2.0;
+            }
+            diff += (re - g[p * 2]) * (re - g[p * 2]) + (im - g[p * 2 + 1]) * (im - g[p * 2 + 1]);
+            norm += re * re + im * im;
+            g[p * 2] = re;
+            g[p * 2 + 1] = im;
+        }
+        if(norm <= 0.0 || diff <= s->cal->tolerance * s->cal->tolerance * norm)
+            break;
+    }
+    int ref = -1;
+    for(int p = 0; p < stations && ref < 0; p++)
+    {
+        if(g[p * 2] != 0.0 || g[p * 2 + 1] != 0.0)
+            ref = p;
+    }
+    double phi = (ref < 0 ? 0.0 : atan2(g[ref * 2 + 1], g[ref * 2]));
+    for(int p = 0; p < stations; p++)
+    {
+        double mag = sqrt(g[p * 2] * g[p * 2] + g[p * 2 + 1] * g[p * 2 + 1]);
+        double arg = atan2(g[p * 2 + 1], g[p * 2]) - phi;
+        s->gains[p][0] = mag * cos(arg);
+        s->gains[p][1] = mag * sin(arg);
+    }
+    return nullptr;
+}
+
+void *VLBISelfCal::applyInterval(void *arg)
+{
+    solution *s = (solution*)arg;
+    VLBIVisibilityTable *table = s->table;
+    for(size_t n = 0; n < s->rows.size(); n++)
+    {
+        int r = s->rows[n];
+        int id = table->getBaseline()[r];
+        double *gp = s->gains[table->getFirstStation(id)];
+        double *gq = s->gains[table->getSecondStation(id)];
+        double re = gp[0] * gq[0] + gp[1] * gq[1];
+        double im = gp[1] * gq[0] - gp[0] * gq[1];
+        double mag = re * re + im * im;
+        if(mag <= 0.0)
+            continue;
+        double *vis = table->getVisibility()[r];
+        double vre = vis[0];
+        double vim = vis[1];
+        vis[0] = (vre * re + vim * im) / mag;
+        vis[1] = (vim * re - vre * im) / mag;
+    }
+    return nullptr;
+}
+
+int VLBISelfCal::solve(VLBIVisibilityTable *table)
+{
+    pfunc;
+    std::vector<solution> solutions;
+    std::vector<double> start;
+    bin(table, &solutions, &start);
+    int stations = table->getStationsCount();
+    int count = (int)solutions.size();
+    if(count < 1 || stations < 2)
+        return 0;
+    complex_t *gains = (complex_t*)malloc(sizeof(complex_t) * (size_t)count * stations);
+    std::atomic<int> pending(0);
+    for(int n = 0; n < count; n++)
+    {
+        solutions[n].gains = &gains[n * stations];
+        Pool->push(solveInterval, &solutions[n], &pending);
+    }
+    Pool->wait(&pending);
+    table->setGains(count, start.data(), gains);
+    free(gains);
+    pgarb("%d stations solved in %d intervals\n", stations, count);
+    return count;
+}
+
+void VLBISelfCal::apply(VLBIVisibilityTable *table)
+{
+    pfunc;
+    int stations = table->getStationsCount();
+    int count = table->getIntervalsCount();
+    if(count < 1)
+        return;
+    double *start = table->getIntervals();
+    std::vector<solution> solutions((size_t)count);
+    for(int r = 0; r < table->count(); r++)
+    {
+        int id = table->getBaseline()[r];
+        if(table->getFirstStation(id) < 0 || table->getSecondStation(id) < 0)
+            continue;
+        int n = (int)(std::upper_bound(start, start + count, table->getTime()[r]) - start) - 1;
+        solutions[Max(0, n)].rows.push_back(r);
+    }
+    std::atomic<int> pending(0);
+    for(int n = 0; n < count; n++)
+    {
+        solutions[n].table = table;
+        solutions[n].gains = &table->getGains()[n * stations];
+        Pool->push(applyInterval, &solutions[n], &pending);
+    }
+    Pool->wait(&pending);
+    pgarb("gains of %d stations applied to %d visibilities\n", stations, table->count());
+}
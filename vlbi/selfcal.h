@@ -0,0 +1,66 @@
+/*  OpenVLBI - Open Source Very Long Baseline Interferometry
+*   Copyright © 2017-2023  Ilia Platone
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 2 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along
+*   with this program; if not, write to the Free Software Foundation, Inc.,
+*   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+#ifndef _SELFCAL_H
+#define _SELFCAL_H
+
+#include <vlbi.h>
+#include <vector>
+
+class VLBIThreadPool;
+class VLBIVisibilityTable;
+
+/**
+* Antenna based gain calibration of a visibility table.
+* The complex gain of each station is solved for each solution interval with the StEFCal iteration,
+* so that each visibility matches the model column, or a point source when no model was predicted,
+* scaled by the gain of its first station times the conjugate gain of its second one.
+* Each solution interval is solved, or applied, by a separate job of the thread pool.
+*/
+class VLBISelfCal
+{
+    public:
+        VLBISelfCal(VLBIThreadPool *pool);
+        ~VLBISelfCal();
+        int solve(VLBIVisibilityTable *table);
+        void apply(VLBIVisibilityTable *table);
+        inline void setInterval(double value) { interval = value; }
+        inline void setIterations(int value) { iterations = value; }
+        inline void setTolerance(double value) { tolerance = value; }
+
+    private:
+        struct solution
+        {
+            VLBISelfCal *cal;
+            VLBIVisibilityTable *table;
+            std::vector<int> rows;
+            complex_t *gains;
+            int iterations;
+        };
+        static void *solveInterval(void *arg);
+        static void *applyInterval(void *arg);
+        void bin(VLBIVisibilityTable *table, std::vector<solution> *solutions, std::vector<double> *start);
+
+        VLBIThreadPool *Pool;
+        double interval { 0.0 };
+        int iterations { 100 };
+        double tolerance { 1E-6 };
+};
+
+#endif //_SELFCAL_H
@@ -23,10 +23,27 @@
 #include <nodecollection.h>
 #include <baselinecollection.h>
 #include <modelcollection.h>
+#include <delaymodel.h>
+#include <gridder.h>
+#include <visibilitytable.h>
+#include <clean.h>
+#include <selfcal.h>
+#include <closures.h>
+#include <fringe.h>
+#include <recording.h>
+#include <idiwriter.h>
+#include <threadpool.h>
 #include <base64.h>
+#include <fftw3.h>
+#include <climits>
 #include <thread>
+#include <atomic>
+#include <vector>
+#include <algorithm>
 
 static NodeCollection *vlbi_nodes = new NodeCollection();
+static VLBIThreadPool *vlbi_pool = nullptr;
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_mutex_t mutex;
 static pthread_mutexattr_t mutexattr;
 static bool mutex_initialized = false;
@@ -39,10 +56,23 @@ unsigned long int vlbi_max_threads(unsigned long value)
     {
         MAX_THREADS = value;
         dsp_max_threads(value);
+        pthread_mutex_lock(&pool_mutex);
+        if(vlbi_pool != nullptr)
+            vlbi_pool->setThreads((int)value);
+        pthread_mutex_unlock(&pool_mutex);
     }
     return MAX_THREADS;
 }
 
+static VLBIThreadPool *get_thread_pool()
+{
+    pthread_mutex_lock(&pool_mutex);
+    if(vlbi_pool == nullptr)
+        vlbi_pool = new VLBIThreadPool((int)MAX_THREADS);
+    pthread_mutex_unlock(&pool_mutex);
+    return vlbi_pool;
+}
+
 static void init_mutex()
 {
     pfunc;
@@ -62,8 +92,7 @@ static void destroy_mutex()
 static void lock_mutex()
 {
     pfunc;
-    while(pthread_mutex_trylock(&mutex))
-        usleep(100);
+    pthread_mutex_lock(&mutex);
 }
 
 static void unlock_mutex()
@@ -78,142 +107,176 @@ const char* vlbi_get_version()
     return VLBI_VERSION_STRING;
 }
 
-static double getDelay(double time, NodeCollection *nodes, VLBIBaseline *b, double Ra, double Dec, double Distance,
-                       double wavelength)
-{
-    double delay = 0.0;
-    b->setRa(Ra);
-    b->setDec(Dec);
-    b->setDistance(Distance);
-    b->setRelative(nodes->isRelative());
-    b->setWaveLength(wavelength);
-    b->setTime(time);
-    b->getProjection();
-    delay = b->getDelay();
-    return delay;
-}
-
 double vlbi_get_offset(vlbi_context ctx, double J2000Time, const char* node, double Ra, double Dec, double Distance)
 {
     pfunc;
     ctx = (ctx == nullptr ? vlbi_nodes : ctx);
     NodeCollection *nodes = (NodeCollection*)ctx;
-    char baseline[VLBI_BASELINE_NAME_SIZE];
-    BaselineCollection *collection = nodes->getBaselines();
-    double offset = 0.0;
-    collection->setRa(Ra);
-    collection->setDec(Dec);
-    collection->setDistance(Distance);
-    collection->setFrequency(1);
-    VLBIBaseline *bl = nullptr;
-    double max_delay = 0;
-    int farest = 0, x, y;
-    for (x = 0; x < nodes->count(); x++)
+    if(!nodes->contains(node))
+        return 0.0;
+    VLBIDelayModel model(nodes);
+    model.copyResiduals(nodes->getDelayModel());
+    model.update(Ra, Dec, Distance, J2000Time, J2000Time);
+    int index = model.indexOf(nodes->get(node));
+    if(index < 0)
+        return 0.0;
+    double *offsets = (double*)malloc(sizeof(double) * (size_t)model.count());
+    model.getExactOffsets(J2000Time, offsets);
+    double offset = offsets[index];
+    free(offsets);
+    return offset;
+}
+
+struct uv_update
+{
+    int idx;
+    double val;
+};
+
+struct fillplane_args
+{
+    VLBIBaseline *b;
+    NodeCollection *nodes;
+    BaselineCollection *baselines;
+    bool moving_baseline;
+    bool nodelay;
+    int *stop;
+    std::atomic<int> *nthreads;
+    double st;
+    double et;
+    int l;
+    std::vector<uv_update> *updates;
+    int stripes;
+    std::vector<vlbi_uv_sample> *samples;
+    std::vector<double> *scales;
+    int average;
+};
+
+static void addsample(fillplane_args *argument, double u, double v, double w, double val, double t)
+{
+    std::vector<double> *scales = argument->scales;
+    if(scales == nullptr)
     {
-        for (y = x + 1; y < nodes->count(); y++)
-        {
-            sprintf(baseline, "%s_%s", nodes->at(x)->getName(), nodes->at(y)->getName());
-            if(!collection->contains(baseline))
-                sprintf(baseline, "%s_%s", nodes->at(y)->getName(), nodes->at(x)->getName());
-            if(collection->contains(baseline)) {
-                bl = collection->get(baseline);
-                double delay = getDelay(J2000Time, nodes, bl, bl->getRa(), bl->getDec(), bl->getDistance(), bl->getWaveLength());
-                if(fabs(delay) > max_delay)
-                {
-                    max_delay = fabs(delay);
-                    if(delay < 0)
-                        farest = x;
-                    else
-                        farest = y;
-                }
-            }
-        }
+        argument->samples->push_back({u, v, w, val, 0.0, 1.0, t, 0});
+        return;
+    }
+    for(size_t k = 0; k < scales->size(); k++)
+    {
+        double s = scales->at(k);
+        argument->samples->push_back({u * s, v * s, w * s, val, 0.0, 1.0, t, (int)k});
+    }
+}
+
+static void accumulate(fillplane_args *argument, dsp_stream_p parent, int idx, double val, double stack)
+{
+    if(argument->updates != nullptr)
+    {
+        argument->updates[(long)idx * argument->stripes / parent->len].push_back({idx, val / stack});
     }
-    bl = nullptr;
-    sprintf(baseline, "%s_%s", node, nodes->at(farest)->getName());
-    if(!collection->contains(baseline))
-        sprintf(baseline, "%s_%s", nodes->at(farest)->getName(), node);
-    if(collection->contains(baseline)) {
-        bl = collection->get(baseline);
-        offset = getDelay(J2000Time, nodes, bl, bl->getRa(), bl->getDec(), bl->getDistance(), bl->getWaveLength());
+    else if(mutex_initialized)
+    {
+        lock_mutex();
+        parent->buf[idx] = (parent->buf[idx]+val/stack)/(stack+1);
+        unlock_mutex();
     }
-    return offset;
+}
+
+static void flushplane(fillplane_args *argument, dsp_stream_p parent, VLBIBaseline *b, std::vector<int> *positions,
+                       std::vector<int> *indexes, std::vector<double> *coords, double *values, double stack)
+{
+    int len = (int)positions->size();
+    if(len < 1)return;
+    b->Correlate(indexes->data(), len, values);
+    for(int x = 0; x < len; x++)
+    {
+        if(argument->samples != nullptr)
+            addsample(argument, coords->at(x * 4), coords->at(x * 4 + 1), coords->at(x * 4 + 2), values[x], coords->at(x * 4 + 3));
+        else
+            accumulate(argument, parent, positions->at(x), values[x], stack);
+    }
+    positions->clear();
+    indexes->clear();
+    coords->clear();
 }
 
 static void* fillplane(void *arg)
 {
     pfunc;
-    struct args
-    {
-        VLBIBaseline *b;
-        NodeCollection *nodes;
-        NodeCollection *nodes_2nd;
-        BaselineCollection *baselines;
-        bool moving_baseline;
-        bool nodelay;
-        int *stop;
-        int *nthreads;
-    };
     if(arg == nullptr)return nullptr;
-    args *argument = (args*)arg;
-    double stack = (*argument->nthreads);
+    fillplane_args *argument = (fillplane_args*)arg;
     VLBIBaseline *b = argument->b;
     if(b == nullptr)return nullptr;
     bool moving_baseline = argument->moving_baseline;
     bool nodelay = argument->nodelay;
     NodeCollection *nodes = argument->nodes;
     if(nodes == nullptr)return nullptr;
-    NodeCollection *nodes_2nd = argument->nodes_2nd;
-    if(nodes_2nd == nullptr)return nullptr;
     BaselineCollection *baselines = argument->baselines;
     if(baselines == nullptr)return nullptr;
     dsp_stream_p parent = baselines->getStream();
     if(parent == nullptr)return nullptr;
+    double stack = 1.0;
+    if(argument->updates == nullptr)
+        stack = ++(*argument->nthreads);
     int u = parent->sizes[0];
     int v = parent->sizes[1];
-    double st = b->getStartTime();
-    double et = b->getEndTime();
+    double st = argument->st;
+    double et = argument->et;
     double tau = 1.0 / b->getSampleRate();
     double t;
-    int l = 0;
-    int e = 0;
-    int s = 0;
+    int l = argument->l;
+    int e = l;
+    int s = l;
     int i = 1;
     int *pos = (int*)malloc(sizeof(int)*2);
     double *offsets = (double*)malloc(sizeof(double)*baselines->getCorrelationOrder());
+    VLBIDelayModel *model = nodes->getDelayModel();
+    double *station_offsets = (double*)malloc(sizeof(double)*(size_t)Max(1, model->count()));
+    int *stations = (int*)malloc(sizeof(int)*baselines->getCorrelationOrder());
+    for(int y = 0; y < baselines->getCorrelationOrder(); y++)
+        stations[y] = model->indexOf(b->getNode(y));
+    double uvw[3];
     int idx = 0;
     int oldidx = 0;
     int x;
-    double val;
+    int order = b->getNodesCount();
+    int block_size = 1024;
+    double starttime = b->getStartTime();
+    double samplerate = b->getSampleRate();
+    std::vector<int> positions;
+    std::vector<int> indexes;
+    std::vector<double> coords;
+    positions.reserve(block_size);
+    indexes.reserve(block_size * order);
+    coords.reserve(block_size * 4);
+    double wscale = vlbi_astro_mean_speed(0) * AIRY / b->getWaveLength();
+    double *values = (double*)malloc(sizeof(double) * block_size);
+    double **locations = (double**)malloc(sizeof(double*) * order);
     for(t = st; t < et; t += tau * i, l++)
     {
         if(*argument->stop)
             break;
-        for (x = 0; x < nodes->count(); x++)
+        for (x = 0; x < order; x++)
+            locations[x] = b->getNode(x)->getLocation(moving_baseline ? l : 0);
+        if(!nodelay)
         {
             if(moving_baseline)
-            {
-                nodes->at(x)->setLocation(l);
-            }
+                model->getExactOffsets(t, station_offsets, l);
             else
-            {
-                nodes->at(x)->setLocation(0);
-            }
+                model->getOffsets(t, station_offsets);
         }
         for(int y = 0; y < baselines->getCorrelationOrder(); y++) {
-            if(nodelay)
+            if(nodelay || stations[y] < 0)
             {
                 offsets[y] = t;
             }
             else
             {
-                offsets[y] = t + vlbi_get_offset((void*)nodes_2nd, t, b->getNode(y)->getName(), b->getRa(), b->getDec(), b->getDistance());
+                offsets[y] = t + station_offsets[stations[y]];
             }
         }
-        b->setTime(t);
-        b->getProjection();
-        int U = (int)b->getU() + u / 2;
-        int V = (int)b->getV() + v / 2;
+        b->getProjection(t, uvw, locations);
+        int U = (int)uvw[0] + u / 2;
+        int V = (int)uvw[1] + v / 2;
         if(U >= 0 && U < u && V >= 0 && V < v)
         {
             pos[0] = U;
@@ -222,13 +285,15 @@ static void* fillplane(void *arg)
             if(idx != oldidx)
             {
                 oldidx = idx;
-                val = b->Locked() ? b->Correlate(t) : b->Correlate(offsets);
-                if(mutex_initialized)
-                {
-                    lock_mutex();
-                    parent->buf[idx] = (parent->buf[idx]+val/stack)/(stack+1);
-                    unlock_mutex();
-                }
+                positions.push_back(idx);
+                coords.push_back(uvw[0]);
+                coords.push_back(uvw[1]);
+                coords.push_back(uvw[2] * wscale);
+                coords.push_back(t);
+                for(int y = 0; y < order; y++)
+                    indexes.push_back((int)(((b->Locked() ? t : offsets[y]) - starttime) / samplerate));
+                if((int)positions.size() == block_size)
+                    flushplane(argument, parent, b, &positions, &indexes, &coords, values, stack);
                 e = s;
                 double k = 100.0 * (t - st) / (et - st);
                 pinfo("%.3lf%%\n", k);
@@ -237,9 +302,233 @@ static void* fillplane(void *arg)
         s = l + 1;
         i = s - e;
     }
+    flushplane(argument, parent, b, &positions, &indexes, &coords, values, stack);
+    free(locations);
+    free(values);
     free(pos);
     free(offsets);
-    (*argument->nthreads)--;
+    free(station_offsets);
+    free(stations);
+    if(argument->updates == nullptr)
+        (*argument->nthreads)--;
+    return nullptr;
+}
+
+static void* averageplane(void *arg)
+{
+    pfunc;
+    if(arg == nullptr)return nullptr;
+    fillplane_args *argument = (fillplane_args*)arg;
+    VLBIBaseline *b = argument->b;
+    if(b == nullptr)return nullptr;
+    NodeCollection *nodes = argument->nodes;
+    if(nodes == nullptr)return nullptr;
+    BaselineCollection *baselines = argument->baselines;
+    if(baselines == nullptr)return nullptr;
+    dsp_stream_p parent = baselines->getStream();
+    if(parent == nullptr)return nullptr;
+    int u = parent->sizes[0];
+    int v = parent->sizes[1];
+    double st = argument->st;
+    double et = argument->et;
+    double tau = 1.0 / b->getSampleRate();
+    double starttime = b->getStartTime();
+    double samplerate = b->getSampleRate();
+    double wscale = vlbi_astro_mean_speed(0) * AIRY / b->getWaveLength();
+    int average = argument->average;
+    int order = b->getNodesCount();
+    VLBIDelayModel *model = nodes->getDelayModel();
+    double *station_offsets = (double*)malloc(sizeof(double)*(size_t)Max(1, model->count()));
+    int *stations = (int*)malloc(sizeof(int)*order);
+    for(int y = 0; y < order; y++)
+        stations[y] = model->indexOf(b->getNode(y));
+    std::vector<int> indexes;
+    indexes.reserve(average * order);
+    double *values = (double*)malloc(sizeof(double) * average);
+    double **locations = (double**)malloc(sizeof(double*) * order);
+    for(int y = 0; y < order; y++)
+        locations[y] = b->getNode(y)->getLocation(0);
+    double uvw[3];
+    for(int l = 0; st + l * tau < et; l += average)
+    {
+        if(*argument->stop)
+            break;
+        indexes.clear();
+        int n = 0;
+        for(double t = st + l * tau; n < average && t < et; n++, t = st + (l + n) * tau)
+        {
+            if(!argument->nodelay)
+                model->getOffsets(t, station_offsets);
+            for(int y = 0; y < order; y++)
+            {
+                double offset = t;
+                if(!argument->nodelay && !b->Locked() && stations[y] >= 0)
+                    offset += station_offsets[stations[y]];
+                indexes.push_back((int)((offset - starttime) / samplerate));
+            }
+        }
+        b->Correlate(indexes.data(), n, values);
+        double val = 0.0;
+        for(int x = 0; x < n; x++)
+            val += values[x];
+        double t = st + (l + (n - 1) / 2.0) * tau;
+        b->getProjection(t, uvw, locations);
+        int U = (int)uvw[0] + u / 2;
+        int V = (int)uvw[1] + v / 2;
+        if(U >= 0 && U < u && V >= 0 && V < v)
+            addsample(argument, uvw[0], uvw[1], uvw[2] * wscale, val / n, t);
+        pinfo("%.3lf%%\n", 100.0 * (l * tau) / (et - st));
+    }
+    free(locations);
+    free(values);
+    free(station_offsets);
+    free(stations);
+    return nullptr;
+}
+
+struct reduceplane_args
+{
+    dsp_stream_p parent;
+    fillplane_args *jobs;
+    int njobs;
+    int stripe;
+};
+
+static void* reduceplane(void *arg)
+{
+    pfunc;
+    if(arg == nullptr)return nullptr;
+    reduceplane_args *argument = (reduceplane_args*)arg;
+    dsp_stream_p parent = argument->parent;
+    double stack = 1.0;
+    for(int j = 0; j < argument->njobs; j++)
+    {
+        std::vector<uv_update> *updates = &argument->jobs[j].updates[argument->stripe];
+        for(size_t x = 0; x < updates->size(); x++)
+        {
+            int idx = updates->at(x).idx;
+            parent->buf[idx] = (parent->buf[idx]+updates->at(x).val)/(stack+1);
+        }
+    }
+    return nullptr;
+}
+
+struct fxcorrelate_args
+{
+    VLBIBaseline *b;
+    NodeCollection *nodes;
+    fftw_plan plan;
+    int channels;
+    double integration;
+    double freq;
+    bool nodelay;
+    int *stop;
+    VLBIIdiWriter *writer;
+};
+
+static void* fxcorrelate(void *arg)
+{
+    pfunc;
+    if(arg == nullptr)return nullptr;
+    fxcorrelate_args *argument = (fxcorrelate_args*)arg;
+    VLBIBaseline *b = argument->b;
+    if(b == nullptr)return nullptr;
+    if(b->getNodesCount() != 2 || b->Locked())return nullptr;
+    NodeCollection *nodes = argument->nodes;
+    if(nodes == nullptr)return nullptr;
+    VLBIDelayModel *model = nodes->getDelayModel();
+    int channels = argument->channels;
+    int fftsize = channels * 2;
+    double sr = b->getNode(0)->getSampleRate();
+    if(sr <= 0.0 || sr != b->getNode(1)->getSampleRate())
+    {
+        perr("%s: FX correlation needs nodes with the same sampling rate\n", b->getName());
+        return nullptr;
+    }
+    double st = b->getStartTime();
+    double et = DBL_MAX;
+    for(int n = 0; n < 2; n++)
+        et = fmin(et, b->getNode(n)->getStartTime() + b->getNode(n)->getLength() / sr);
+    int segments = Max(1, (int)(argument->integration * sr) / fftsize);
+    double segment_time = fftsize / sr;
+    int integrations = (int)floor((et - st) / (segments * segment_time));
+    if(integrations < 1)return nullptr;
+    dsp_stream_p stream = b->getStream();
+    dsp_stream_set_dim(stream, 0, channels);
+    if(stream->dims < 2)
+        dsp_stream_add_dim(stream, integrations);
+    else
+        dsp_stream_set_dim(stream, 1, integrations);
+    dsp_stream_alloc_buffer(stream, stream->len);
+    stream->samplerate = 1.0 / (segments * segment_time);
+    double *in = fftw_alloc_real(fftsize);
+    fftw_complex *spectrum[2];
+    spectrum[0] = fftw_alloc_complex(channels + 1);
+    spectrum[1] = fftw_alloc_complex(channels + 1);
+    complex_t *acc = (complex_t*)malloc(sizeof(complex_t) * channels);
+    complex_t *cross = (complex_t*)malloc(sizeof(complex_t) * channels);
+    double *cross_inputs[2] = { spectrum[0][0], spectrum[1][0] };
+    double *offsets = (double*)malloc(sizeof(double) * (size_t)Max(1, model->count()));
+    int station[2];
+    station[0] = model->indexOf(b->getNode(0));
+    station[1] = model->indexOf(b->getNode(1));
+    VLBIIdiWriter::batch *rows = (argument->writer != nullptr ? argument->writer->createBatch(b) : nullptr);
+    for(int k = 0; k < integrations; k++)
+    {
+        if(*argument->stop)
+            break;
+        dsp_buffer_set(acc[0], channels * 2, 0.0);
+        for(int s = 0; s < segments; s++)
+        {
+            double t = st + (k * segments + s) * segment_time;
+            if(!argument->nodelay)
+                model->getOffsets(t + segment_time / 2.0, offsets);
+            for(int n = 0; n < 2; n++)
+            {
+                VLBINode *node = b->getNode(n);
+                double delay = ((argument->nodelay || station[n] < 0) ? 0.0 : offsets[station[n]]);
+                double position = (t + delay - node->getStartTime()) * sr;
+                long first = (long)floor(position);
+                double fraction = position - first;
+                node->getSamples(first, fftsize, in);
+                fftw_execute_dft_r2c(argument->plan, in, spectrum[n]);
+                for(int c = 0; c < channels; c++)
+                {
+                    double rad = 2.0 * PI * (argument->freq * delay + c * fraction / fftsize);
+                    double re = spectrum[n][c][0];
+                    double im = spectrum[n][c][1];
+                    spectrum[n][c][0] = re * cos(rad) - im * sin(rad);
+                    spectrum[n][c][1] = re * sin(rad) + im * cos(rad);
+                }
+            }
+            vlbi_block_complex_multiply_conjugate(cross_inputs, 2, cross[0], channels * 2);
+            for(int c = 0; c < channels; c++)
+            {
+                acc[c][0] += cross[c][0];
+                acc[c][1] += cross[c][1];
+            }
+        }
+        for(int c = 0; c < channels; c++)
+        {
+            int idx = k * channels + c;
+            stream->dft.pairs[idx][0] = acc[c][0] / segments;
+            stream->dft.pairs[idx][1] = acc[c][1] / segments;
+            stream->buf[idx] = sqrt(pow(stream->dft.pairs[idx][0], 2) + pow(stream->dft.pairs[idx][1], 2));
+            stream->magnitude->buf[idx] = stream->buf[idx];
+            stream->phase->buf[idx] = atan2(stream->dft.pairs[idx][1], stream->dft.pairs[idx][0]);
+        }
+        if(rows != nullptr)
+            argument->writer->append(rows, b, st + (k + 0.5) * segments * segment_time, segments * segment_time, &stream->dft.pairs[k * channels]);
+        pinfo("%s: %.3lf%%\n", b->getName(), 100.0 * (k + 1) / integrations);
+    }
+    if(rows != nullptr)
+        argument->writer->closeBatch(rows);
+    fftw_free(in);
+    fftw_free(spectrum[0]);
+    fftw_free(spectrum[1]);
+    free(acc);
+    free(cross);
+    free(offsets);
     return nullptr;
 }
 
@@ -247,6 +536,7 @@ void* vlbi_init()
 {
     pfunc;
     init_mutex();
+    get_thread_pool();
     return new NodeCollection();
 }
 
@@ -279,6 +569,62 @@ void vlbi_add_node(void *ctx, dsp_stream_p stream, const char *name, int geo)
     nodes->add(new VLBINode(stream, name, nodes->count(), geo == 1));
 }
 
+static VLBINode *new_native_node(NodeCollection *nodes, dsp_stream_p stream, const char *name, int geo)
+{
+    if(stream->dims > 0)
+        dsp_stream_set_dim(stream, 0, 1);
+    else
+        dsp_stream_add_dim(stream, 1);
+    dsp_stream_alloc_buffer(stream, stream->len);
+    return new VLBINode(stream, name, nodes->count(), geo == 1);
+}
+
+void vlbi_add_node_mmap(void *ctx, dsp_stream_p stream, const char *filename, off_t offset, vlbi_sample_type type, long len, const char *name, int geo)
+{
+    pfunc;
+    ctx = (ctx == nullptr ? vlbi_nodes : ctx);
+    NodeCollection *nodes = (NodeCollection*)ctx;
+    VLBINode *node = new_native_node(nodes, stream, name, geo);
+    if(!node->map(filename, offset, type, len))
+    {
+        delete node;
+        return;
+    }
+    nodes->add(node);
+}
+
+void vlbi_add_node_packed(void *ctx, dsp_stream_p stream, const void *buf, vlbi_sample_type type, long len, const char *name, int geo)
+{
+    pfunc;
+    ctx = (ctx == nullptr ? vlbi_nodes : ctx);
+    NodeCollection *nodes = (NodeCollection*)ctx;
+    VLBINode *node = new_native_node(nodes, stream, name, geo);
+    if(!node->pack(buf, type, len))
+    {
+        delete node;
+        return;
+    }
+    nodes->add(node);
+}
+
+void vlbi_append_node_samples(void *ctx, const char *name, dsp_t *buf, int len, dsp_location *locations)
+{
+    pfunc;
+    ctx = (ctx == nullptr ? vlbi_nodes : ctx);
+    NodeCollection *nodes = (NodeCollection*)ctx;
+    if(!vlbi_has_node(ctx, name))return;
+    nodes->get(name)->append(buf, len, locations);
+}
+
+void vlbi_set_node_retention(void *ctx, const char *name, double seconds)
+{
+    pfunc;
+    ctx = (ctx == nullptr ? vlbi_nodes : ctx);
+    NodeCollection *nodes = (NodeCollection*)ctx;
+    if(!vlbi_has_node(ctx, name))return;
+    nodes->get(name)->setRetention(seconds);
+}
+
 void vlbi_copy_node(void *ctx, const char *name, const char *node)
 {
     pfunc;
@@ -286,7 +632,13 @@ void vlbi_copy_node(void *ctx, const char *name, const char *node)
     NodeCollection *nodes = (NodeCollection*)ctx;
     if(vlbi_has_node(ctx, node)) {
         VLBINode *n = nodes->get(node);
-        nodes->add(new VLBINode(dsp_stream_copy(n->getStream()), name, nodes->count(), n->GeographicCoordinates()));
+        VLBINode *copy = new VLBINode(dsp_stream_copy(n->getStream()), name, nodes->count(), n->GeographicCoordinates());
+        if(n->isNative() && !copy->copySamples(n))
+        {
+            delete copy;
+            return;
+        }
+        nodes->add(copy);
     }
 }
 
@@ -295,7 +647,15 @@ dsp_stream_p vlbi_get_node(void *ctx, const char *name)
     pfunc;
     ctx = (ctx == nullptr ? vlbi_nodes : ctx);
     NodeCollection *nodes = (NodeCollection*)ctx;
-    return nodes->get(name)->getStream();
+    VLBINode *n = nodes->get(name);
+    if(n == nullptr)
+        return nullptr;
+    if(n->isNative())
+    {
+        perr("%s: memory mapped or packed nodes have no stream samples\n", name);
+        return nullptr;
+    }
+    return n->getStream();
 }
 
 int vlbi_has_node(void *ctx, const char *name)
@@ -342,13 +702,36 @@ void vlbi_del_node(void *ctx, const char *name)
     }
 }
 
+static dsp_stream_p copy_node_samples(VLBINode *n)
+{
+    dsp_stream_p stream = dsp_stream_copy(n->getStream());
+    if(!n->isNative())
+        return stream;
+    long len = n->getLength();
+    if(len > INT_MAX)
+    {
+        perr("%s: %ld samples do not fit into a stream\n", n->getName(), len);
+        dsp_stream_free_buffer(stream);
+        dsp_stream_free(stream);
+        return nullptr;
+    }
+    dsp_stream_set_dim(stream, 0, (int)len);
+    dsp_stream_alloc_buffer(stream, stream->len);
+    n->getSamples(0, (int)len, stream->buf);
+    for(int x = 1; x < stream->len; x++)
+        stream->location[x] = stream->location[0];
+    return stream;
+}
+
 void vlbi_filter_lp_node(void *ctx, const char *name, const char *node, double radians)
 {
     pfunc;
     ctx = (ctx == nullptr ? vlbi_nodes : ctx);
     NodeCollection *nodes = (NodeCollection*)ctx;
     VLBINode *n = nodes->get(node);
-    dsp_stream_p stream = dsp_stream_copy(n->getStream());
+    dsp_stream_p stream = copy_node_samples(n);
+    if(stream == nullptr)
+        return;
     dsp_fourier_dft(stream, 1);
     dsp_filter_lowpass(stream, radians);
     dsp_stream_free_buffer(stream->magnitude);
@@ -364,7 +747,9 @@ void vlbi_filter_hp_node(void *ctx, const char *name, const char *node, double r
     ctx = (ctx == nullptr ? vlbi_nodes : ctx);
     NodeCollection *nodes = (NodeCollection*)ctx;
     VLBINode *n = nodes->get(node);
-    dsp_stream_p stream = dsp_stream_copy(n->getStream());
+    dsp_stream_p stream = copy_node_samples(n);
+    if(stream == nullptr)
+        return;
     dsp_fourier_dft(stream, 1);
     dsp_filter_highpass(stream, radians);
     dsp_stream_free_buffer(stream->magnitude);
@@ -380,7 +765,9 @@ void vlbi_filter_bp_node(void *ctx, const char *name, const char *node, double l
     ctx = (ctx == nullptr ? vlbi_nodes : ctx);
     NodeCollection *nodes = (NodeCollection*)ctx;
     VLBINode *n = nodes->get(node);
-    dsp_stream_p stream = dsp_stream_copy(n->getStream());
+    dsp_stream_p stream = copy_node_samples(n);
+    if(stream == nullptr)
+        return;
     dsp_fourier_dft(stream, 1);
     dsp_filter_bandpass(stream, lo_radians, hi_radians);
     dsp_stream_free_buffer(stream->magnitude);
@@ -396,7 +783,9 @@ void vlbi_filter_br_node(void *ctx, const char *name, const char *node, double l
     ctx = (ctx == nullptr ? vlbi_nodes : ctx);
     NodeCollection *nodes = (NodeCollection*)ctx;
     VLBINode *n = nodes->get(node);
-    dsp_stream_p stream = dsp_stream_copy(n->getStream());
+    dsp_stream_p stream = copy_node_samples(n);
+    if(stream == nullptr)
+        return;
     dsp_fourier_dft(stream, 1);
     dsp_filter_bandreject(stream, lo_radians, hi_radians);
     dsp_stream_free_buffer(stream->magnitude);
@@ -465,6 +854,7 @@ void vlbi_del_model(void *ctx, const char *name)
     {
         dsp_stream_p model = nodes->getModels()->get(name);
         nodes->getModels()->remove(name);
+        nodes->removePlotState(name);
         if(model != nullptr) {
             dsp_stream_free_buffer(model);
             dsp_stream_free(model);
@@ -626,8 +1016,78 @@ void vlbi_unlock_baseline(void *ctx, const char **names)
     b->Unlock();
 }
 
-void vlbi_get_uv_plot(vlbi_context ctx, const char *name, int u, int v, double *target, double freq, double sr, int nodelay,
-                      int moving_baseline, vlbi_func2_t delegate, int *interrupt)
+void vlbi_set_accumulation_mode(void *ctx, vlbi_accumulation_mode mode)
+{
+    pfunc;
+    ctx = (ctx == nullptr ? vlbi_nodes : ctx);
+    NodeCollection *nodes = (NodeCollection*)ctx;
+    nodes->setAccumulationMode(mode);
+}
+
+void vlbi_set_plot_chunk_size(void *ctx, double seconds)
+{
+    pfunc;
+    ctx = (ctx == nullptr ? vlbi_nodes : ctx);
+    NodeCollection *nodes = (NodeCollection*)ctx;
+    nodes->setChunkSize(seconds);
+}
+
+void vlbi_set_plot_incremental(void *ctx, int incremental)
+{
+    pfunc;
+    ctx = (ctx == nullptr ? vlbi_nodes : ctx);
+    NodeCollection *nodes = (NodeCollection*)ctx;
+    nodes->setIncremental(incremental != 0);
+}
+
+void vlbi_set_plot_averaging(void *ctx, double fov)
+{
+    pfunc;
+    ctx = (ctx == nullptr ? vlbi_nodes : ctx);
+    NodeCollection *nodes = (NodeCollection*)ctx;
+    nodes->setAveraging(fov);
+}
+
+void vlbi_set_plot_subbands(void *ctx, double *freqs, int count, int cube)
+{
+    pfunc;
+    ctx = (ctx == nullptr ? vlbi_nodes : ctx);
+    NodeCollection *nodes = (NodeCollection*)ctx;
+    nodes->setSubbands(freqs, (freqs == nullptr ? 0 : count), cube != 0);
+}
+
+void vlbi_set_plot_gridding(void *ctx, vlbi_gridding_kernel kernel, int support, int oversampling)
+{
+    pfunc;
+    ctx = (ctx == nullptr ? vlbi_nodes : ctx);
+    NodeCollection *nodes = (NodeCollection*)ctx;
+    nodes->getGridder()->setKernel(kernel, support, oversampling);
+}
+
+void vlbi_set_plot_weighting(void *ctx, vlbi_weighting_mode mode, double robust)
+{
+    pfunc;
+    ctx = (ctx == nullptr ? vlbi_nodes : ctx);
+    NodeCollection *nodes = (NodeCollection*)ctx;
+    nodes->getGridder()->setWeighting(mode, robust);
+}
+
+void vlbi_get_grid_correction(void *ctx, const char *name, int u, int v)
+{
+    pfunc;
+    ctx = (ctx == nullptr ? vlbi_nodes : ctx);
+    NodeCollection *nodes = (NodeCollection*)ctx;
+    if(u < 1 || v < 1)return;
+    dsp_stream_p correction = dsp_stream_new();
+    dsp_stream_add_dim(correction, u);
+    dsp_stream_add_dim(correction, v);
+    dsp_stream_alloc_buffer(correction, correction->len);
+    nodes->getGridder()->getCorrection(correction->buf, u, v);
+    vlbi_add_model(ctx, correction, name);
+}
+
+static void get_uv_plot(vlbi_context ctx, const char *name, int u, int v, double *target, double freq, double sr, int nodelay,
+                        int moving_baseline, vlbi_func2_t delegate, vlbi_func_block_t block_delegate, int wplanes, int *interrupt)
 {
     pfunc;
     ctx = (ctx == nullptr ? vlbi_nodes : ctx);
@@ -635,15 +1095,62 @@ void vlbi_get_uv_plot(vlbi_context ctx, const char *name, int u, int v, double *
     if(nodes == nullptr)return;
     BaselineCollection *baselines = nodes->getBaselines();
     if(baselines == nullptr)return;
-    NodeCollection *nodes_2nd = new NodeCollection();
-    for(int x = 0; x < nodes->count(); x++)
-        nodes_2nd->add(nodes->at(x));
-    nodes_2nd->setCorrelationOrder(2);
     int stop = 0;
+    VLBIGridder *gridder = nodes->getGridder();
+    std::vector<double> *subbands = nodes->getSubbands();
+    bool mfs = !subbands->empty();
+    bool cube = (mfs && nodes->isCube());
+    std::vector<double> scales;
+    if(mfs)
+    {
+        freq = *std::max_element(subbands->begin(), subbands->end());
+        for(size_t k = 0; k < subbands->size(); k++)
+            scales.push_back(subbands->at(k) / freq);
+    }
+    bool gridding = (gridder->isEnabled() || wplanes > 0 || mfs);
+    vlbi_plot_state *state = nullptr;
+    bool resume = false;
+    if(nodes->isIncremental() && !gridding)
+    {
+        state = nodes->getPlotState(name);
+        std::map<std::string, std::vector<double>> locations;
+        bool moved = false;
+        for(int i = 0; i < nodes->count(); i++)
+        {
+            VLBINode *node = nodes->at(i);
+            double *location = node->getStream()->location[0].coordinates;
+            locations[node->getName()].assign(location, location + 3);
+            if(state->locations.count(node->getName()) > 0)
+                moved |= (state->locations[node->getName()] != locations[node->getName()]);
+        }
+        resume = vlbi_has_model(ctx, name) && state->u == u && state->v == v && !memcmp(state->target, target, sizeof(double) * 3) &&
+                 state->freq == freq && state->sr == sr && state->nodelay == (nodelay != 0) && state->moving_baseline == (moving_baseline != 0) &&
+                 state->delegate == delegate && state->block_delegate == block_delegate && (int)state->plane.size() == u * v &&
+                 state->relative == nodes->isRelative() && !memcmp(&state->station, nodes->stationLocation(), sizeof(dsp_location)) &&
+                 !moved;
+        state->locations = locations;
+        if(!resume)
+        {
+            state->relative = nodes->isRelative();
+            memcpy(&state->station, nodes->stationLocation(), sizeof(dsp_location));
+            state->u = u;
+            state->v = v;
+            memcpy(state->target, target, sizeof(double) * 3);
+            state->freq = freq;
+            state->sr = sr;
+            state->nodelay = (nodelay != 0);
+            state->moving_baseline = (moving_baseline != 0);
+            state->delegate = delegate;
+            state->block_delegate = block_delegate;
+            state->progress.clear();
+        }
+    }
     dsp_stream_p parent = baselines->getStream();
     dsp_buffer_set(parent->buf, parent->len, 0.0);
     baselines->setWidth(u);
     baselines->setHeight(v);
+    if(resume)
+        dsp_buffer_copy(state->plane.data(), parent->buf, parent->len);
     baselines->setFrequency(freq);
     baselines->setSampleRate(sr);
     baselines->setRa(target[0]);
@@ -652,61 +1159,655 @@ void vlbi_get_uv_plot(vlbi_context ctx, const char *name, int u, int v, double *
     parent->child_count = 0;
     pgarb("%ld nodes, %ld baselines\n", nodes->count(), baselines->count());
     baselines->setDelegate(delegate);
-    pthread_attr_t attr;
-    pthread_attr_init(&attr);
-    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
-    pthread_t *threads = (pthread_t*)malloc(sizeof(pthread_t) * baselines->count());
-    int threads_running = 0;
-    int max_threads = (int)vlbi_max_threads(0);
-    struct args
+    baselines->setBlockDelegate(block_delegate);
+    VLBIVisibilityTable *table = nodes->getVisibilities();
+    vlbi_visibility_key key;
+    bool cached = false;
+    if(gridding)
     {
-        VLBIBaseline *b;
-        NodeCollection *nodes;
-        NodeCollection *nodes_2nd;
-        BaselineCollection *baselines;
-        bool moving_baseline;
-        bool nodelay;
-        int *stop;
-        int *nthreads;
-    };
-    args *argument = (args*)malloc(sizeof(args) * (size_t)baselines->count());
-    for(int i = 0; i < baselines->count(); i++)
+        key.u = u;
+        key.v = v;
+        memcpy(key.target, target, sizeof(double) * 3);
+        key.freq = freq;
+        key.sr = sr;
+        key.nodelay = (nodelay != 0);
+        key.moving_baseline = (moving_baseline != 0);
+        key.delegate = delegate;
+        key.block_delegate = block_delegate;
+        key.averaging = nodes->getAveraging();
+        key.subbands = *subbands;
+        key.cube = cube;
+        memcpy(&key.station, nodes->stationLocation(), sizeof(dsp_location));
+        for(int x = 0; x < nodes->count(); x++)
+        {
+            nodes->at(x)->setLocation(0);
+            key.locations.insert(key.locations.end(), nodes->at(x)->getLocation(), nodes->at(x)->getLocation() + 3);
+        }
+        for(int i = 0; i < baselines->count(); i++)
+        {
+            VLBIBaseline *b = baselines->at(i);
+            if(b != nullptr)
+                key.spans[b->getName()] = std::make_pair(b->getStartTime(), b->getEndTime());
+        }
+        cached = table->isValid(&key);
+    }
+    VLBIThreadPool *pool = get_thread_pool();
+    bool private_accumulation = (!gridding && nodes->getAccumulationMode() == vlbi_accumulation_private);
+    int nstripes = private_accumulation ? Max(1, Min(pool->getThreads(), (int)parent->len)) : 1;
+    double chunk_size = nodes->getChunkSize();
+    std::atomic<int> threads_running(0);
+    std::atomic<int> pending(0);
+    std::vector<fillplane_args> jobs;
+    std::vector<std::pair<std::string, double>> progress;
+    for(int i = 0; i < baselines->count() && !cached; i++)
     {
         VLBIBaseline *b = baselines->at(i);
         if(b == nullptr)continue;
-        argument[i].b = b;
-        argument[i].nodes = nodes;
-        argument[i].nodes_2nd = nodes_2nd;
-        argument[i].baselines = baselines;
-        argument[i].moving_baseline = moving_baseline;
-        argument[i].nodelay = nodelay;
-        argument[i].nthreads = &threads_running;
+        fillplane_args argument;
+        argument.b = b;
+        argument.nodes = nodes;
+        argument.baselines = baselines;
+        argument.moving_baseline = moving_baseline;
+        argument.nodelay = nodelay;
+        argument.nthreads = &threads_running;
+        argument.updates = nullptr;
+        argument.stripes = nstripes;
+        argument.samples = nullptr;
+        argument.scales = (mfs ? &scales : nullptr);
+        argument.average = 1;
         if(interrupt != nullptr)
-            argument[i].stop = interrupt;
+            argument.stop = interrupt;
         else
-            argument[i].stop = &stop;
-        while(threads_running > max_threads - 1)
-            usleep(100000);
-        threads_running++;
-        pthread_create(&threads[i], &attr, fillplane, &argument[i]);
+            argument.stop = &stop;
+        double st = b->getStartTime();
+        double et = b->getEndTime();
+        double tau = 1.0 / b->getSampleRate();
+        int chunk = (chunk_size > 0.0 ? Max(1, (int)ceil(chunk_size / tau)) : 0);
+        if(gridding && nodes->getAveraging() > 0.0 && !moving_baseline)
+        {
+            double uvw[3];
+            for(int x = 0; x < nodes->count(); x++)
+                nodes->at(x)->setLocation(0);
+            b->getProjection(st, uvw);
+            double w = uvw[2] * vlbi_astro_mean_speed(0) * AIRY / b->getWaveLength();
+            double length = sqrt(uvw[0] * uvw[0] + uvw[1] * uvw[1] + w * w);
+            if(length > 0.0)
+                argument.average = (int)fmax(1.0, fmin(1E+6, 0.2 / nodes->getAveraging() / (2.0 * PI / SIDEREAL_DAY * length * tau)));
+            pgarb("baseline %s: %d samples averaged per bin\n", b->getName(), argument.average);
+        }
+        int l = 0;
+        if(state != nullptr)
+        {
+            progress.push_back(std::make_pair(std::string(b->getName()), et));
+            if(state->progress.count(b->getName()) > 0)
+                l = Max(0, (int)round((state->progress[b->getName()] - st) / tau));
+            if(st + l * tau >= et)
+                continue;
+        }
+        do
+        {
+            argument.l = l;
+            argument.st = st + l * tau;
+            argument.et = (chunk > 0 ? fmin(et, st + (l + chunk) * tau) : et);
+            if(private_accumulation)
+                argument.updates = new std::vector<uv_update>[nstripes];
+            if(gridding)
+                argument.samples = new std::vector<vlbi_uv_sample>();
+            jobs.push_back(argument);
+            l += chunk;
+        }
+        while(chunk > 0 && st + l * tau < et);
     }
-    for(int i = 0; i < baselines->count(); i++)
-        pthread_join(threads[i], nullptr);
-    free(argument);
-    free(threads);
-    pthread_attr_destroy(&attr);
-    if(vlbi_has_model(ctx, name)) {
-        dsp_stream_p model = vlbi_get_model(ctx, name);
-        dsp_stream_set_dim(model, 0, u);
-        dsp_stream_set_dim(model, 1, v);
-        dsp_stream_alloc_buffer(model, model->len);
-        dsp_buffer_copy(parent->buf, model->buf, model->len);
-    } else
-        vlbi_add_model(ctx, dsp_stream_copy(parent), name);
-    pgarb("aperture synthesis plotting completed\n");
-}
-
-void vlbi_get_ifft(vlbi_context ctx, const char *name, const char *magnitude, const char *phase)
+    if(!nodelay && jobs.size() > 0)
+    {
+        double starttime = DBL_MAX;
+        double endtime = -DBL_MAX;
+        for(size_t j = 0; j < jobs.size(); j++)
+        {
+            starttime = fmin(starttime, jobs[j].st);
+            endtime = fmax(endtime, jobs[j].et);
+        }
+        for(int x = 0; x < nodes->count(); x++)
+            nodes->at(x)->setLocation(0);
+        nodes->getDelayModel()->update(target[0], target[1], target[2], starttime, endtime);
+    }
+    for(size_t j = 0; j < jobs.size(); j++)
+        pool->push(jobs[j].average > 1 ? averageplane : fillplane, &jobs[j], &pending);
+    pool->wait(&pending);
+    if(private_accumulation)
+    {
+        std::vector<reduceplane_args> reducers(nstripes);
+        for(int s = 0; s < nstripes; s++)
+        {
+            reducers[s].parent = parent;
+            reducers[s].jobs = jobs.data();
+            reducers[s].njobs = (int)jobs.size();
+            reducers[s].stripe = s;
+            pool->push(reduceplane, &reducers[s], &pending);
+        }
+        pool->wait(&pending);
+        for(size_t j = 0; j < jobs.size(); j++)
+            delete[] jobs[j].updates;
+    }
+    if(gridding)
+    {
+        std::vector<vlbi_uv_sample> samples;
+        if(cached)
+        {
+            samples.reserve((size_t)table->count());
+            for(int r = 0; r < table->count(); r++)
+            {
+                if(table->getFlags()[r])continue;
+                samples.push_back({table->getU()[r], table->getV()[r], table->getW()[r], table->getVisibility()[r][0], table->getVisibility()[r][1],
+                                   table->getWeight()[r], table->getTime()[r], table->getChannel()[r]});
+            }
+            pgarb("%d visibilities reused\n", table->count());
+        }
+        else
+        {
+            table->clear();
+            size_t rows = 0;
+            for(size_t j = 0; j < jobs.size(); j++)
+                rows += jobs[j].samples->size();
+            table->reserve((int)rows);
+            for(size_t j = 0; j < jobs.size(); j++)
+            {
+                bool pair = (jobs[j].b->getNodesCount() == 2);
+                int id = table->addBaseline(jobs[j].b->getName(), pair ? jobs[j].b->getNode(0)->getName() : nullptr,
+                                            pair ? jobs[j].b->getNode(1)->getName() : nullptr);
+                for(size_t k = 0; k < jobs[j].samples->size(); k++)
+                {
+                    vlbi_uv_sample *sample = &jobs[j].samples->at(k);
+                    table->append(sample->time, id, sample->u, sample->v, sample->w, sample->val, sample->imag, sample->weight, sample->channel);
+                }
+                samples.insert(samples.end(), jobs[j].samples->begin(), jobs[j].samples->end());
+                delete jobs[j].samples;
+            }
+            if(interrupt != nullptr && *interrupt)
+                table->clear();
+            else
+                table->setKey(&key);
+        }
+        if(wplanes > 0)
+            gridder->wstack(&samples, parent->buf, u, v, wplanes, pool);
+        else
+            gridder->grid(&samples, parent->buf, u, v, pool);
+        for(size_t k = 0; cube && k < scales.size(); k++)
+        {
+            std::vector<vlbi_uv_sample> channel;
+            for(size_t x = 0; x < samples.size(); x++)
+            {
+                if(samples[x].channel == (int)k)
+                    channel.push_back(samples[x]);
+            }
+            char *plane = (char*)malloc(strlen(name) + 12);
+            sprintf(plane, "%s_%d", name, (int)k);
+            dsp_stream_p model = nullptr;
+            if(vlbi_has_model(ctx, plane))
+            {
+                model = nodes->getModels()->get(plane);
+                dsp_stream_set_dim(model, 0, u);
+                dsp_stream_set_dim(model, 1, v);
+                dsp_stream_alloc_buffer(model, model->len);
+            }
+            else
+            {
+                model = dsp_stream_new();
+                dsp_stream_add_dim(model, u);
+                dsp_stream_add_dim(model, v);
+                dsp_stream_alloc_buffer(model, model->len);
+                vlbi_add_model(ctx, model, plane);
+            }
+            if(wplanes > 0)
+                gridder->wstack(&channel, model->buf, u, v, wplanes, pool);
+            else
+                gridder->grid(&channel, model->buf, u, v, pool);
+            free(plane);
+        }
+    }
+    if(state != nullptr)
+    {
+        if(interrupt != nullptr && *interrupt)
+        {
+            nodes->removePlotState(name);
+        }
+        else
+        {
+            for(size_t p = 0; p < progress.size(); p++)
+                state->progress[progress[p].first] = progress[p].second;
+            state->plane.assign(parent->buf, parent->buf + parent->len);
+            pgarb("%ld plotting jobs over %ld baselines\n", (long)jobs.size(), (long)progress.size());
+        }
+    }
+    if(vlbi_has_model(ctx, name)) {
+        dsp_stream_p model = vlbi_get_model(ctx, name);
+        dsp_stream_set_dim(model, 0, u);
+        dsp_stream_set_dim(model, 1, v);
+        dsp_stream_alloc_buffer(model, model->len);
+        dsp_buffer_copy(parent->buf, model->buf, model->len);
+    } else
+        vlbi_add_model(ctx, dsp_stream_copy(parent), name);
+    pgarb("aperture synthesis plotting completed\n");
+}
+
+void vlbi_get_uv_plot(vlbi_context ctx, const char *name, int u, int v, double *target, double freq, double sr, int nodelay,
+                      int moving_baseline, vlbi_func2_t delegate, int *interrupt)
+{
+    pfunc;
+    get_uv_plot(ctx, name, u, v, target, freq, sr, nodelay, moving_baseline, delegate, nullptr, 0, interrupt);
+}
+
+void vlbi_get_uv_plot_block(vlbi_context ctx, const char *name, int u, int v, double *target, double freq, double sr,
+                            int nodelay, int moving_baseline, vlbi_func_block_t delegate, int *interrupt)
+{
+    pfunc;
+    get_uv_plot(ctx, name, u, v, target, freq, sr, nodelay, moving_baseline, nullptr, delegate, 0, interrupt);
+}
+
+void vlbi_get_wstack_image(vlbi_context ctx, const char *name, int u, int v, double *target, double freq, double sr,
+                           int nodelay, int moving_baseline, vlbi_func2_t delegate, int wplanes, int *interrupt)
+{
+    pfunc;
+    get_uv_plot(ctx, name, u, v, target, freq, sr, nodelay, moving_baseline, delegate, nullptr, Max(1, wplanes), interrupt);
+}
+
+int vlbi_get_visibilities(void *ctx, double **times, int **baseline, double **u, double **v, double **w, complex_t **visibility,
+                          double **weight, unsigned char **flags)
+{
+    pfunc;
+    ctx = (ctx == nullptr ? vlbi_nodes : ctx);
+    NodeCollection *nodes = (NodeCollection*)ctx;
+    VLBIVisibilityTable *table = nodes->getVisibilities();
+    if(times != nullptr)
+        *times = table->getTime();
+    if(baseline != nullptr)
+        *baseline = table->getBaseline();
+    if(u != nullptr)
+        *u = table->getU();
+    if(v != nullptr)
+        *v = table->getV();
+    if(w != nullptr)
+        *w = table->getW();
+    if(visibility != nullptr)
+        *visibility = table->getVisibility();
+    if(weight != nullptr)
+        *weight = table->getWeight();
+    if(flags != nullptr)
+        *flags = table->getFlags();
+    return table->count();
+}
+
+const char *vlbi_get_visibility_baseline(void *ctx, int id)
+{
+    pfunc;
+    ctx = (ctx == nullptr ? vlbi_nodes : ctx);
+    NodeCollection *nodes = (NodeCollection*)ctx;
+    return nodes->getVisibilities()->getBaselineName(id);
+}
+
+void vlbi_clear_visibilities(void *ctx)
+{
+    pfunc;
+    ctx = (ctx == nullptr ? vlbi_nodes : ctx);
+    NodeCollection *nodes = (NodeCollection*)ctx;
+    nodes->getVisibilities()->clear();
+}
+
+int vlbi_predict_visibilities(void *ctx, const char *model, complex_t **prediction)
+{
+    pfunc;
+    ctx = (ctx == nullptr ? vlbi_nodes : ctx);
+    NodeCollection *nodes = (NodeCollection*)ctx;
+    if(!vlbi_has_model(ctx, model))
+        return 0;
+    dsp_stream_p image = nodes->getModels()->get(model);
+    VLBIVisibilityTable *table = nodes->getVisibilities();
+    if(image->dims < 2 || table->count() < 1)
+        return 0;
+    table->resetModel();
+    nodes->getGridder()->degrid(image->buf, image->sizes[0], image->sizes[1], table->getU(), table->getV(), table->count(),
+                                table->getModel(), get_thread_pool());
+    if(prediction != nullptr)
+        *prediction = table->getModel();
+    return table->count();
+}
+
+static void store_image(void *ctx, const char *name, dsp_t *buf, int u, int v)
+{
+    dsp_stream_p image = dsp_stream_new();
+    dsp_stream_add_dim(image, u);
+    dsp_stream_add_dim(image, v);
+    dsp_stream_alloc_buffer(image, image->len);
+    memcpy(image->buf, buf, sizeof(dsp_t) * (size_t)image->len);
+    if(vlbi_has_model(ctx, name))
+        vlbi_del_model(ctx, name);
+    vlbi_add_model(ctx, image, name);
+}
+
+int vlbi_clean_hogbom(void *ctx, const char *name, const char *residual, const char *dirty, const char *psf, double gain,
+                      double threshold, int iterations, int window, int *interrupt)
+{
+    pfunc;
+    ctx = (ctx == nullptr ? vlbi_nodes : ctx);
+    NodeCollection *nodes = (NodeCollection*)ctx;
+    if(!vlbi_has_model(ctx, dirty))
+        return 0;
+    if(!vlbi_has_model(ctx, psf))
+        return 0;
+    dsp_stream_p image = nodes->getModels()->get(dirty);
+    dsp_stream_p beam = nodes->getModels()->get(psf);
+    if(image->dims < 2 || beam->dims < 2)
+        return 0;
+    int u = image->sizes[0];
+    int v = image->sizes[1];
+    std::vector<dsp_t> res(image->buf, image->buf + (long)u * v);
+    std::vector<dsp_t> components((size_t)u * v, 0.0);
+    VLBIClean clean(get_thread_pool());
+    clean.setGain(gain);
+    clean.setThreshold(threshold);
+    clean.setIterations(iterations);
+    clean.setWindow(window);
+    int n = clean.hogbom(res.data(), u, v, beam->buf, beam->sizes[0], beam->sizes[1], components.data(), interrupt);
+    store_image(ctx, name, components.data(), u, v);
+    store_image(ctx, residual, res.data(), u, v);
+    return n;
+}
+
+int vlbi_clean_cotton_schwab(void *ctx, const char *name, const char *residual, int u, int v, double gain, double threshold,
+                             int iterations, int cycles, int window, int *interrupt)
+{
+    pfunc;
+    ctx = (ctx == nullptr ? vlbi_nodes : ctx);
+    NodeCollection *nodes = (NodeCollection*)ctx;
+    VLBIVisibilityTable *table = nodes->getVisibilities();
+    VLBIGridder *gridder = nodes->getGridder();
+    VLBIThreadPool *pool = get_thread_pool();
+    if(u < 1 || v < 1)
+        return 0;
+    std::vector<vlbi_uv_sample> samples;
+    std::vector<vlbi_uv_sample> coverage;
+    std::vector<double> su;
+    std::vector<double> sv;
+    for(int r = 0; r < table->count(); r++)
+    {
+        if(table->getFlags()[r])continue;
+        vlbi_uv_sample sample = { table->getU()[r], table->getV()[r], 0.0, table->getVisibility()[r][0], table->getVisibility()[r][1],
+                                  table->getWeight()[r], table->getTime()[r] };
+        samples.push_back(sample);
+        sample.val = 1.0;
+        sample.imag = 0.0;
+        coverage.push_back(sample);
+        su.push_back(sample.u);
+        sv.push_back(sample.v);
+    }
+    int count = (int)samples.size();
+    if(count < 1)
+        return 0;
+    long len = (long)u * v;
+    std::vector<dsp_t> correction((size_t)len);
+    std::vector<dsp_t> psf((size_t)len);
+    std::vector<dsp_t> res((size_t)len);
+    std::vector<dsp_t> components((size_t)len, 0.0);
+    std::vector<dsp_t> delta((size_t)len);
+    complex_t *predicted = (complex_t*)malloc(sizeof(complex_t) * (size_t)count);
+    gridder->getCorrection(correction.data(), u, v);
+    for(int y = 0; y < v; y++)
+    {
+        for(int x = 0; x < u; x++)
+        {
+            if(abs(x - u / 2) > u / 4 || abs(y - v / 2) > v / 4)
+                correction[x + y * u] = 0.0;
+        }
+    }
+    gridder->wstack(&coverage, psf.data(), u, v, 1, pool);
+    for(long x = 0; x < len; x++)
+        psf[x] *= correction[x];
+    VLBIClean clean(pool);
+    clean.setGain(gain);
+    clean.setWindow(window);
+    int total = 0;
+    for(int cycle = 0; cycle < cycles && total < iterations; cycle++)
+    {
+        if(interrupt != nullptr && *interrupt)
+            break;
+        gridder->wstack(&samples, res.data(), u, v, 1, pool);
+        for(long x = 0; x < len; x++)
+            res[x] *= correction[x];
+        int peak = vlbi_block_find_peak(res.data(), (int)len);
+        if(peak < 0)
+            break;
+        clean.setThreshold(fmax(threshold, fabs(res[peak]) * 0.1));
+        clean.setIterations(iterations - total);
+        dsp_buffer_set(delta.data(), len, 0.0);
+        int n = clean.hogbom(res.data(), u, v, psf.data(), u, v, delta.data(), interrupt);
+        if(n < 1)
+            break;
+        total += n;
+        for(long x = 0; x < len; x++)
+            components[x] += delta[x];
+        gridder->degrid(components.data(), u, v, su.data(), sv.data(), count, predicted, pool);
+        for(int r = 0, k = 0; r < table->count(); r++)
+        {
+            if(table->getFlags()[r])continue;
+            samples[k].val = table->getVisibility()[r][0] - predicted[k][0];
+            samples[k].imag = table->getVisibility()[r][1] - predicted[k][1];
+            k++;
+        }
+        pgarb("major cycle %d: %d components\n", cycle, n);
+    }
+    gridder->wstack(&samples, res.data(), u, v, 1, pool);
+    for(long x = 0; x < len; x++)
+        res[x] *= correction[x];
+    free(predicted);
+    store_image(ctx, name, components.data(), u, v);
+    store_image(ctx, residual, res.data(), u, v);
+    return total;
+}
+
+int vlbi_solve_gains(void *ctx, double interval, int iterations, double tolerance)
+{
+    pfunc;
+    ctx = (ctx == nullptr ? vlbi_nodes : ctx);
+    NodeCollection *nodes = (NodeCollection*)ctx;
+    VLBISelfCal selfcal(get_thread_pool());
+    selfcal.setInterval(interval);
+    selfcal.setIterations(iterations);
+    selfcal.setTolerance(tolerance);
+    return selfcal.solve(nodes->getVisibilities());
+}
+
+int vlbi_get_gains(void *ctx, double **times, complex_t **gains, int *stations)
+{
+    pfunc;
+    ctx = (ctx == nullptr ? vlbi_nodes : ctx);
+    NodeCollection *nodes = (NodeCollection*)ctx;
+    VLBIVisibilityTable *table = nodes->getVisibilities();
+    if(times != nullptr)
+        *times = table->getIntervals();
+    if(gains != nullptr)
+        *gains = table->getGains();
+    if(stations != nullptr)
+        *stations = table->getStationsCount();
+    return table->getIntervalsCount();
+}
+
+const char *vlbi_get_gain_station(void *ctx, int id)
+{
+    pfunc;
+    ctx = (ctx == nullptr ? vlbi_nodes : ctx);
+    NodeCollection *nodes = (NodeCollection*)ctx;
+    return nodes->getVisibilities()->getStationName(id);
+}
+
+void vlbi_apply_gains(void *ctx)
+{
+    pfunc;
+    ctx = (ctx == nullptr ? vlbi_nodes : ctx);
+    NodeCollection *nodes = (NodeCollection*)ctx;
+    VLBISelfCal selfcal(get_thread_pool());
+    selfcal.apply(nodes->getVisibilities());
+}
+
+int vlbi_get_closures(void *ctx, double interval, double **times)
+{
+    pfunc;
+    ctx = (ctx == nullptr ? vlbi_nodes : ctx);
+    NodeCollection *nodes = (NodeCollection*)ctx;
+    VLBIClosures *closures = nodes->getClosures();
+    int snapshots = closures->compute(nodes->getVisibilities(), interval, get_thread_pool());
+    if(times != nullptr)
+        *times = closures->getTimes();
+    return snapshots;
+}
+
+int vlbi_get_closure_phases(void *ctx, int **triangles, double **phases)
+{
+    pfunc;
+    ctx = (ctx == nullptr ? vlbi_nodes : ctx);
+    NodeCollection *nodes = (NodeCollection*)ctx;
+    VLBIClosures *closures = nodes->getClosures();
+    if(triangles != nullptr)
+        *triangles = closures->getTriangles();
+    if(phases != nullptr)
+        *phases = closures->getPhases();
+    return closures->getTrianglesCount();
+}
+
+int vlbi_get_closure_amplitudes(void *ctx, int **quadrangles, double **amplitudes)
+{
+    pfunc;
+    ctx = (ctx == nullptr ? vlbi_nodes : ctx);
+    NodeCollection *nodes = (NodeCollection*)ctx;
+    VLBIClosures *closures = nodes->getClosures();
+    if(quadrangles != nullptr)
+        *quadrangles = closures->getQuadrangles();
+    if(amplitudes != nullptr)
+        *amplitudes = closures->getAmplitudes();
+    return closures->getQuadranglesCount();
+}
+
+static void fx_correlation(NodeCollection *nodes, int channels, double integration, double *target, double freq, int nodelay,
+                           int *interrupt, VLBIIdiWriter *writer)
+{
+    if(nodes == nullptr)return;
+    if(channels < 1)return;
+    BaselineCollection *baselines = nodes->getBaselines();
+    if(baselines == nullptr)return;
+    baselines->setRa(target[0]);
+    baselines->setDec(target[1]);
+    baselines->setDistance(target[2]);
+    if(!nodelay && nodes->count() > 0)
+    {
+        double starttime = DBL_MAX;
+        double endtime = -DBL_MAX;
+        for(int x = 0; x < nodes->count(); x++)
+        {
+            VLBINode *node = nodes->at(x);
+            node->setLocation(0);
+            if(node->getSampleRate() <= 0.0)continue;
+            starttime = fmin(starttime, node->getStartTime());
+            endtime = fmax(endtime, node->getStartTime() + node->getLength() / node->getSampleRate());
+        }
+        if(starttime < endtime)
+            nodes->getDelayModel()->update(target[0], target[1], target[2], starttime, endtime);
+    }
+    int stop = 0;
+    double *in = fftw_alloc_real(channels * 2);
+    fftw_complex *out = fftw_alloc_complex(channels + 1);
+    fftw_plan plan = fftw_plan_dft_r2c_1d(channels * 2, in, out, FFTW_ESTIMATE);
+    fftw_free(in);
+    fftw_free(out);
+    VLBIThreadPool *pool = get_thread_pool();
+    std::atomic<int> pending(0);
+    std::vector<fxcorrelate_args> jobs;
+    for(int i = 0; i < baselines->count(); i++)
+    {
+        fxcorrelate_args argument;
+        argument.b = baselines->at(i);
+        if(argument.b == nullptr)continue;
+        argument.nodes = nodes;
+        argument.plan = plan;
+        argument.channels = channels;
+        argument.integration = integration;
+        argument.freq = freq;
+        argument.nodelay = nodelay;
+        argument.stop = (interrupt != nullptr ? interrupt : &stop);
+        argument.writer = writer;
+        jobs.push_back(argument);
+    }
+    for(size_t j = 0; j < jobs.size(); j++)
+        pool->push(fxcorrelate, &jobs[j], &pending);
+    pool->wait(&pending);
+    fftw_destroy_plan(plan);
+    pgarb("FX correlation completed\n");
+}
+
+void vlbi_get_fx_correlation(void *ctx, int channels, double integration, double *target, double freq, int nodelay,
+                             int *interrupt)
+{
+    pfunc;
+    ctx = (ctx == nullptr ? vlbi_nodes : ctx);
+    NodeCollection *nodes = (NodeCollection*)ctx;
+    fx_correlation(nodes, channels, integration, target, freq, nodelay, interrupt, nullptr);
+}
+
+long vlbi_get_fx_correlation_to_fitsidi(void *ctx, const char *filename, int channels, double integration, double *target,
+                                        double freq, int nodelay, int *interrupt)
+{
+    pfunc;
+    ctx = (ctx == nullptr ? vlbi_nodes : ctx);
+    NodeCollection *nodes = (NodeCollection*)ctx;
+    if(nodes == nullptr)return -1;
+    VLBIIdiWriter writer;
+    if(!writer.open(filename, nodes, target, freq, channels))
+        return -1;
+    fx_correlation(nodes, channels, integration, target, freq, nodelay, interrupt, &writer);
+    return writer.close();
+}
+
+int vlbi_fringe_search(void *ctx, double freq, int oversampling, double snr, int *interrupt)
+{
+    pfunc;
+    ctx = (ctx == nullptr ? vlbi_nodes : ctx);
+    NodeCollection *nodes = (NodeCollection*)ctx;
+    VLBIFringeSearch search(get_thread_pool());
+    search.setOversampling(oversampling);
+    int count = search.search(nodes, freq, interrupt);
+    if(interrupt != nullptr && *interrupt)
+        return count;
+    search.solve(nodes, snr);
+    nodes->getVisibilities()->clear();
+    return count;
+}
+
+int vlbi_get_fringe(void *ctx, const char *baseline, double *delay, double *rate, double *snr)
+{
+    pfunc;
+    ctx = (ctx == nullptr ? vlbi_nodes : ctx);
+    NodeCollection *nodes = (NodeCollection*)ctx;
+    BaselineCollection *baselines = nodes->getBaselines();
+    if(!baselines->contains(baseline))
+        return 0;
+    VLBIBaseline *b = baselines->get(baseline);
+    if(delay != nullptr)
+        *delay = b->getFringeDelay();
+    if(rate != nullptr)
+        *rate = b->getFringeRate();
+    if(snr != nullptr)
+        *snr = b->getFringeSNR();
+    return 1;
+}
+
+void vlbi_clear_delay_residuals(void *ctx)
+{
+    pfunc;
+    ctx = (ctx == nullptr ? vlbi_nodes : ctx);
+    NodeCollection *nodes = (NodeCollection*)ctx;
+    nodes->getDelayModel()->clearResiduals();
+    nodes->getVisibilities()->clear();
+}
+
+void vlbi_get_ifft(vlbi_context ctx, const char *name, const char *magnitude, const char *phase)
 {
     pfunc;
     if(!vlbi_has_model(ctx, magnitude))
@@ -897,14 +1998,8 @@ void vlbi_add_model_from_jpeg(void *ctx, char *filename, const char *name)
     }
 }
 
-void vlbi_add_model_from_fits(void *ctx, char *filename, const char *name)
+static void add_model_from_fits(NodeCollection *nodes, dsp_stream_p* file, int channels, const char *name)
 {
-    pfunc;
-    ctx = (ctx == nullptr ? vlbi_nodes : ctx);
-    NodeCollection *nodes = (NodeCollection*)ctx;
-    int channels;
-    dsp_stream_p* file = nullptr;
-    file = dsp_file_read_fits(filename, &channels, 0);
     char *model = (char*)malloc(strlen(name)+5);
     if(file != nullptr)
     {
@@ -918,6 +2013,27 @@ void vlbi_add_model_from_fits(void *ctx, char *filename, const char *name)
         vlbi_add_model(nodes, file[channels], name);
         free(file);
     }
+    free(model);
+}
+
+void vlbi_add_model_from_fits(void *ctx, char *filename, const char *name)
+{
+    pfunc;
+    ctx = (ctx == nullptr ? vlbi_nodes : ctx);
+    NodeCollection *nodes = (NodeCollection*)ctx;
+    int channels;
+    dsp_stream_p* file = dsp_file_read_fits(filename, &channels, 0);
+    add_model_from_fits(nodes, file, channels, name);
+}
+
+void vlbi_add_model_from_fits_memory(void *ctx, void *buf, size_t len, const char *name)
+{
+    pfunc;
+    ctx = (ctx == nullptr ? vlbi_nodes : ctx);
+    NodeCollection *nodes = (NodeCollection*)ctx;
+    int channels;
+    dsp_stream_p* file = dsp_file_read_fits_memory(buf, len, &channels, 0);
+    add_model_from_fits(nodes, file, channels, name);
 }
 
 void vlbi_get_model_to_png(void *ctx, char *filename, const char *name)
@@ -1014,16 +2130,108 @@ void vlbi_add_node_from_fits(void *ctx, char *filename, const char *name, int ge
         nodes->add(new VLBINode(stream, name, nodes->count(), geo == 1));
 }
 
-void vlbi_add_nodes_from_sdfits(void *ctx, char *filename, const char *name, int geo)
+void vlbi_add_node_from_fits_memory(void *ctx, void *buf, size_t len, const char *name, int geo)
 {
     pfunc;
     ctx = (ctx == nullptr ? vlbi_nodes : ctx);
     NodeCollection *nodes = (NodeCollection*)ctx;
-    long n = 0;
-    dsp_stream_p *stream = vlbi_file_read_sdfits(filename, &n);
+    dsp_stream_p stream = vlbi_file_read_fits_memory(buf, len);
     if(stream != nullptr)
+        nodes->add(new VLBINode(stream, name, nodes->count(), geo == 1));
+}
+
+static void add_nodes_from_sdfits(NodeCollection *nodes, void *sdfits, long nrows, const char *name, int geo)
+{
+    long n = 0;
+    long row = 0;
+    if(sdfits == nullptr)
+        return;
+    std::vector<VLBINode*> added;
+    dsp_stream_p *stream;
+    while((stream = vlbi_file_read_sdfits_rows(sdfits, 1024, &n)) != nullptr)
+    {
+        for(int i = 0; i < n; i++, row++)
+        {
+            char node_name[DSP_NAME_SIZE];
+            if(nrows > 1)
+                snprintf(node_name, DSP_NAME_SIZE, "%s_%ld", name, row);
+            else
+                snprintf(node_name, DSP_NAME_SIZE, "%s", name);
+            added.push_back(new VLBINode(stream[i], node_name, nodes->count() + (int)added.size(), geo == 1));
+        }
+        free(stream);
+    }
+    vlbi_file_close_sdfits(sdfits);
+    nodes->add(added.data(), (int)added.size());
+}
+
+void vlbi_add_nodes_from_sdfits(void *ctx, char *filename, const char *name, int geo)
+{
+    pfunc;
+    ctx = (ctx == nullptr ? vlbi_nodes : ctx);
+    NodeCollection *nodes = (NodeCollection*)ctx;
+    long nrows = 0;
+    void *sdfits = vlbi_file_open_sdfits(filename, &nrows);
+    add_nodes_from_sdfits(nodes, sdfits, nrows, name, geo);
+}
+
+void vlbi_add_nodes_from_sdfits_memory(void *ctx, void *buf, size_t len, const char *name, int geo)
+{
+    pfunc;
+    ctx = (ctx == nullptr ? vlbi_nodes : ctx);
+    NodeCollection *nodes = (NodeCollection*)ctx;
+    long nrows = 0;
+    void *sdfits = vlbi_file_open_sdfits_memory(buf, len, &nrows);
+    add_nodes_from_sdfits(nodes, sdfits, nrows, name, geo);
+}
+
+void *vlbi_open_recording(void *ctx, const char *filename, vlbi_recording_format format, const char *name, dsp_location *location, int geo, double samplerate, int channels, int bits)
+{
+    pfunc;
+    ctx = (ctx == nullptr ? vlbi_nodes : ctx);
+    NodeCollection *nodes = (NodeCollection*)ctx;
+    VLBIRecording *recording = new VLBIRecording(nodes, format, name, location, geo == 1);
+    if(!recording->open(filename, samplerate, channels, bits))
     {
-        for(int i = 0; i < n; i++)
-            nodes->add(new VLBINode(stream[i], name, nodes->count(), geo == 1));
+        delete recording;
+        return nullptr;
     }
+    return recording;
+}
+
+long vlbi_read_recording(void *recording, double seconds)
+{
+    pfunc;
+    if(recording == nullptr)
+        return 0;
+    return ((VLBIRecording*)recording)->read(seconds);
+}
+
+long vlbi_get_recording_missing_frames(void *recording)
+{
+    pfunc;
+    if(recording == nullptr)
+        return 0;
+    return ((VLBIRecording*)recording)->getMissingFrames();
+}
+
+void vlbi_close_recording(void *recording)
+{
+    pfunc;
+    delete (VLBIRecording*)recording;
+}
+
+int vlbi_add_nodes_from_recording(void *ctx, const char *filename, vlbi_recording_format format, const char *name, dsp_location *location, int geo, double samplerate, int channels, int bits)
+{
+    pfunc;
+    void *recording = vlbi_open_recording(ctx, filename, format, name, location, geo, samplerate, channels, bits);
+    if(recording == nullptr)
+        return 0;
+    while(vlbi_read_recording(recording, 1.0) > 0);
+    long missing = vlbi_get_recording_missing_frames(recording);
+    if(missing > 0)
+        pwarn("%s: %ld missing frames\n", filename, missing);
+    int count = ((VLBIRecording*)recording)->getNodesCount();
+    vlbi_close_recording(recording);
+    return count;
 }
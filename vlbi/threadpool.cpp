@@ -0,0 +1,191 @@
+/*  OpenVLBI - Open Source Very Long Baseline Interferometry
+*   Copyright © 2017-2023  Ilia Platone
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 2 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along
+*   with this program; if not, write to the Free Software Foundation, Inc.,
+*   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "threadpool.h"
+
+VLBIThreadPool::VLBIThreadPool(int threads)
+{
+    pthread_rwlock_init(&workers_lock, nullptr);
+    pthread_mutex_init(&mutex, nullptr);
+    pthread_cond_init(&work_cond, nullptr);
+    pthread_cond_init(&done_cond, nullptr);
+    setThreads(threads);
+}
+
+VLBIThreadPool::~VLBIThreadPool()
+{
+    pthread_rwlock_wrlock(&workers_lock);
+    std::vector<worker*> retired = workers;
+    workers.clear();
+    pthread_rwlock_unlock(&workers_lock);
+    pthread_mutex_lock(&mutex);
+    for(size_t x = 0; x < retired.size(); x++)
+        retired[x]->quit = true;
+    pthread_cond_broadcast(&work_cond);
+    pthread_mutex_unlock(&mutex);
+    for(size_t x = 0; x < retired.size(); x++)
+    {
+        pthread_join(retired[x]->thread, nullptr);
+        pthread_mutex_destroy(&retired[x]->lock);
+        delete retired[x];
+    }
+    pthread_cond_destroy(&done_cond);
+    pthread_cond_destroy(&work_cond);
+    pthread_mutex_destroy(&mutex);
+    pthread_rwlock_destroy(&workers_lock);
+}
+
+VLBIThreadPool::worker *VLBIThreadPool::addWorker()
+{
+    worker *w = new worker();
+    w->pool = this;
+    w->index = (int)workers.size();
+    w->quit = false;
+    pthread_mutex_init(&w->lock, nullptr);
+    pthread_create(&w->thread, nullptr, run, w);
+    return w;
+}
+
+void VLBIThreadPool::setThreads(int threads)
+{
+    std::vector<worker*> retired;
+    if(threads < 1)
+        threads = 1;
+    pthread_rwlock_wrlock(&workers_lock);
+    while((int)workers.size() < threads)
+        workers.push_back(addWorker());
+    while((int)workers.size() > threads)
+    {
+        worker *w = workers.back();
+        workers.pop_back();
+        pthread_mutex_lock(&w->lock);
+        pthread_mutex_lock(&workers[0]->lock);
+        while(!w->jobs.empty())
+        {
+            workers[0]->jobs.push_back(w->jobs.front());
+            w->jobs.pop_front();
+        }
+        pthread_mutex_unlock(&workers[0]->lock);
+        pthread_mutex_unlock(&w->lock);
+        retired.push_back(w);
+    }
+    pthread_rwlock_unlock(&workers_lock);
+    pthread_mutex_lock(&mutex);
+    for(size_t x = 0; x < retired.size(); x++)
+        retired[x]->quit = true;
+    pthread_cond_broadcast(&work_cond);
+    pthread_mutex_unlock(&mutex);
+    for(size_t x = 0; x < retired.size(); x++)
+    {
+        pthread_join(retired[x]->thread, nullptr);
+        pthread_mutex_destroy(&retired[x]->lock);
+        delete retired[x];
+    }
+}
+
+void VLBIThreadPool::push(void *(*func)(void*), void *arg, std::atomic<int> *pending)
+{
+    job j;
+    j.func = func;
+    j.arg = arg;
+    j.pending = pending;
+    if(pending != nullptr)
+        (*pending)++;
+    queued++;
+    pthread_rwlock_rdlock(&workers_lock);
+    worker *w = workers[next++ % workers.size()];
+    pthread_mutex_lock(&w->lock);
+    w->jobs.push_back(j);
+    pthread_mutex_unlock(&w->lock);
+    pthread_rwlock_unlock(&workers_lock);
+    pthread_mutex_lock(&mutex);
+    pthread_cond_signal(&work_cond);
+    pthread_mutex_unlock(&mutex);
+}
+
+void VLBIThreadPool::wait(std::atomic<int> *pending)
+{
+    pthread_mutex_lock(&mutex);
+    while(*pending > 0)
+        pthread_cond_wait(&done_cond, &mutex);
+    pthread_mutex_unlock(&mutex);
+}
+
+bool VLBIThreadPool::getJob(worker *self, job *j)
+{
+    bool found = false;
+    pthread_rwlock_rdlock(&workers_lock);
+    pthread_mutex_lock(&self->lock);
+    if(!self->jobs.empty())
+    {
+        *j = self->jobs.front();
+        self->jobs.pop_front();
+        found = true;
+    }
+    pthread_mutex_unlock(&self->lock);
+    int n = (int)workers.size();
+    for(int x = 1; x <= n && !found; x++)
+    {
+        worker *victim = workers[(self->index + x) % n];
+        if(victim == self)
+            continue;
+        pthread_mutex_lock(&victim->lock);
+        if(!victim->jobs.empty())
+        {
+            *j = victim->jobs.back();
+            victim->jobs.pop_back();
+            found = true;
+        }
+        pthread_mutex_unlock(&victim->lock);
+    }
+    pthread_rwlock_unlock(&workers_lock);
+    if(found)
+        queued--;
+    return found;
+}
+
+void VLBIThreadPool::execute(job *j)
+{
+    j->func(j->arg);
+    if(j->pending != nullptr && --(*j->pending) == 0)
+    {
+        pthread_mutex_lock(&mutex);
+        pthread_cond_broadcast(&done_cond);
+        pthread_mutex_unlock(&mutex);
+    }
+}
+
+void *VLBIThreadPool::run(void *arg)
+{
+    worker *self = (worker*)arg;
+    VLBIThreadPool *pool = self->pool;
+    job j;
+    while(!self->quit)
+    {
+        if(pool->getJob(self, &j))
+        {
+            pool->execute(&j);
+            continue;
+        }
+        pthread_mutex_lock(&pool->mutex);
+        while(pool->queued == 0 && !self->quit)
+            pthread_cond_wait(&pool->work_cond, &pool->mutex);
+        pthread_mutex_unlock(&pool->mutex);
+    }
+    return nullptr;
+}
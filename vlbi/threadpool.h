@@ -0,0 +1,67 @@
+/*  OpenVLBI - Open Source Very Long Baseline Interferometry
+*   Copyright © 2017-2023  Ilia Platone
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 2 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along
+*   with this program; if not, write to the Free Software Foundation, Inc.,
+*   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#ifndef _THREADPOOL_H
+#define _THREADPOOL_H
+
+#include <pthread.h>
+#include <atomic>
+#include <deque>
+#include <vector>
+
+class VLBIThreadPool
+{
+    public:
+        VLBIThreadPool(int threads);
+        ~VLBIThreadPool();
+        void push(void *(*func)(void*), void *arg, std::atomic<int> *pending);
+        void wait(std::atomic<int> *pending);
+        void setThreads(int threads);
+        inline int getThreads() { return (int)workers.size(); }
+
+    private:
+        struct job
+        {
+            void *(*func)(void*);
+            void *arg;
+            std::atomic<int> *pending;
+        };
+        struct worker
+        {
+            VLBIThreadPool *pool;
+            pthread_t thread;
+            pthread_mutex_t lock;
+            std::deque<job> jobs;
+            int index;
+            std::atomic<bool> quit;
+        };
+        static void *run(void *arg);
+        bool getJob(worker *self, job *j);
+        void execute(job *j);
+        worker *addWorker();
+
+        std::vector<worker*> workers;
+        pthread_rwlock_t workers_lock;
+        pthread_mutex_t mutex;
+        pthread_cond_t work_cond;
+        pthread_cond_t done_cond;
+        std::atomic<int> queued { 0 };
+        std::atomic<unsigned int> next { 0 };
+};
+
+#endif //_THREADPOOL_H
@@ -24,6 +24,8 @@ timespec_t vlbi_time_mktimespec(int year, int month, int dom, int hour, int minu
     timespec_t ret;
     struct tm t_tm;
     time_t t_time;
+    memset(&t_tm, 0, sizeof(struct tm));
+    t_tm.tm_isdst = 0;
     t_tm.tm_sec = second;
     t_tm.tm_min = minute;
     t_tm.tm_hour = hour;
@@ -0,0 +1,129 @@
+/*  OpenVLBI - Open Source Very Long Baseline Interferometry
+*   Copyright © 2017-2023  Ilia Platone
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 2 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along
+*   with this program; if not, write to the Free Software Foundation, Inc.,
+*   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "visibilitytable.h"
+
+VLBIVisibilityTable::VLBIVisibilityTable()
+{
+}
+
+VLBIVisibilityTable::~VLBIVisibilityTable()
+{
+    clear();
+}
+
+void VLBIVisibilityTable::clear()
+{
+    time.clear();
+    baseline.clear();
+    channel.clear();
+    u.clear();
+    v.clear();
+    w.clear();
+    visibility.clear();
+    weight.clear();
+    flags.clear();
+    model.clear();
+    baselines.clear();
+    first.clear();
+    second.clear();
+    stations.clear();
+    intervals.clear();
+    gains.clear();
+    key.spans.clear();
+    valid = false;
+}
+
+void VLBIVisibilityTable::reserve(int rows)
+{
+    time.reserve((size_t)rows);
+    baseline.reserve((size_t)rows);
+    channel.reserve((size_t)rows);
+    u.reserve((size_t)rows);
+    v.reserve((size_t)rows);
+    w.reserve((size_t)rows);
+    visibility.reserve((size_t)rows * 2);
+    weight.reserve((size_t)rows);
+    flags.reserve((size_t)rows);
+}
+
+int VLBIVisibilityTable::addBaseline(const char *name, const char *first, const char *second)
+{
+    for(int id = (int)baselines.size() - 1; id >= 0; id--)
+    {
+        if(baselines[id] == name)
+            return id;
+    }
+    baselines.push_back(name);
+    this->first.push_back(first != nullptr ? addStation(first) : -1);
+    this->second.push_back(second != nullptr ? addStation(second) : -1);
+    return (int)baselines.size() - 1;
+}
+
+int VLBIVisibilityTable::addStation(const char *name)
+{
+    int id = getStation(name);
+    if(id >= 0)
+        return id;
+    stations.push_back(name);
+    return (int)stations.size() - 1;
+}
+
+int VLBIVisibilityTable::getStation(const char *name)
+{
+    for(int id = 0; id < (int)stations.size(); id++)
+    {
+        if(stations[id] == name)
+            return id;
+    }
+    return -1;
+}
+
+void VLBIVisibilityTable::setGains(int count, double *start, complex_t *solutions)
+{
+    intervals.assign(start, start + count);
+    gains.assign((double*)solutions, (double*)solutions + (size_t)count * stations.size() * 2);
+}
+
+void VLBIVisibilityTable::append(double t, int id, double U, double V, double W, double re, double im, double wt, int ch)
+{
+    time.push_back(t);
+    baseline.push_back(id);
+    channel.push_back(ch);
+    u.push_back(U);
+    v.push_back(V);
+    w.push_back(W);
+    visibility.push_back(re);
+    visibility.push_back(im);
+    weight.push_back(wt);
+    flags.push_back(0);
+}
+
+const char *VLBIVisibilityTable::getBaselineName(int id)
+{
+    if(id < 0 || id >= (int)baselines.size())
+        return nullptr;
+    return baselines[id].c_str();
+}
+
+const char *VLBIVisibilityTable::getStationName(int id)
+{
+    if(id < 0 || id >= (int)stations.size())
+        return nullptr;
+    return stations[id].c_str();
+}
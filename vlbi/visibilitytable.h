@@ -0,0 +1,124 @@
+/*  OpenVLBI - Open Source Very Long Baseline Interferometry
+*   Copyright © 2017-2023  Ilia Platone
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 2 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along
+*   with this program; if not, write to the Free Software Foundation, Inc.,
+*   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#ifndef _VISIBILITYTABLE_H
+#define _VISIBILITYTABLE_H
+
+#include <vlbi.h>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+* The parameters a visibility table has been correlated with, the locations of the station and of the nodes,
+* and the time span of each baseline, by name.
+*/
+struct vlbi_visibility_key
+{
+    int u;
+    int v;
+    double target[3];
+    double freq;
+    double sr;
+    bool nodelay;
+    bool moving_baseline;
+    vlbi_func2_t delegate;
+    vlbi_func_block_t block_delegate;
+    double averaging;
+    std::vector<double> subbands;
+    bool cube;
+    dsp_location station;
+    std::vector<double> locations;
+    std::map<std::string, std::pair<double, double>> spans;
+    bool operator==(const vlbi_visibility_key &key) const
+    {
+        return u == key.u && v == key.v && !memcmp(target, key.target, sizeof(double) * 3) && freq == key.freq && sr == key.sr &&
+               nodelay == key.nodelay && moving_baseline == key.moving_baseline && delegate == key.delegate &&
+               block_delegate == key.block_delegate && averaging == key.averaging && subbands == key.subbands && cube == key.cube &&
+               !memcmp(&station, &key.station, sizeof(dsp_location)) && locations == key.locations && spans == key.spans;
+    }
+};
+
+/**
+* Columnar table of the correlated visibilities of a context.
+* Each column is a contiguous array, one row per visibility, u, v and w are in cells of the UV plane
+* from its center, the channel column holds the sub-band of each row of a multi-frequency plot. The table is filled by a gridded plot and reused by the next ones with the same key,
+* the model column holds the visibilities last predicted from a model image.
+* Each baseline refers to the pair of stations it is made of, the gains solved for each station
+* are kept by solution interval, the stations of each interval are contiguous.
+*/
+class VLBIVisibilityTable
+{
+    public:
+        VLBIVisibilityTable();
+        ~VLBIVisibilityTable();
+        void clear();
+        void reserve(int rows);
+        int addBaseline(const char *name, const char *first = nullptr, const char *second = nullptr);
+        int addStation(const char *name);
+        void append(double t, int id, double U, double V, double W, double re, double im, double wt, int ch = 0);
+        const char *getBaselineName(int id);
+        const char *getStationName(int id);
+        int getStation(const char *name);
+        void setGains(int intervals, double *start, complex_t *solutions);
+        inline int count() { return (int)time.size(); }
+        inline int getBaselinesCount() { return (int)baselines.size(); }
+        inline int getStationsCount() { return (int)stations.size(); }
+        inline int getFirstStation(int id) { return first[id]; }
+        inline int getSecondStation(int id) { return second[id]; }
+        inline int getIntervalsCount() { return (int)intervals.size(); }
+        inline double *getIntervals() { return intervals.data(); }
+        inline complex_t *getGains() { return (complex_t*)gains.data(); }
+        inline bool isValid(vlbi_visibility_key *k) { return valid && key == *k; }
+        inline void setKey(vlbi_visibility_key *k) { key = *k; valid = true; }
+        inline double getIntegrationTime() { return (valid && key.sr > 0.0 ? 1.0 / key.sr : 0.0); }
+        inline double *getTime() { return time.data(); }
+        inline int *getBaseline() { return baseline.data(); }
+        inline int *getChannel() { return channel.data(); }
+        inline double *getU() { return u.data(); }
+        inline double *getV() { return v.data(); }
+        inline double *getW() { return w.data(); }
+        inline complex_t *getVisibility() { return (complex_t*)visibility.data(); }
+        inline double *getWeight() { return weight.data(); }
+        inline unsigned char *getFlags() { return flags.data(); }
+        inline complex_t *getModel() { return (complex_t*)model.data(); }
+        inline bool hasModel() { return !time.empty() && model.size() == time.size() * 2; }
+        inline void resetModel() { model.assign(time.size() * 2, 0.0); }
+
+    private:
+        std::vector<double> time;
+        std::vector<int> baseline;
+        std::vector<int> channel;
+        std::vector<double> u;
+        std::vector<double> v;
+        std::vector<double> w;
+        std::vector<double> visibility;
+        std::vector<double> weight;
+        std::vector<unsigned char> flags;
+        std::vector<double> model;
+        std::vector<std::string> baselines;
+        std::vector<int> first;
+        std::vector<int> second;
+        std::vector<std::string> stations;
+        std::vector<double> intervals;
+        std::vector<double> gains;
+        vlbi_visibility_key key;
+        bool valid { false };
+};
+
+#endif //_VISIBILITYTABLE_H
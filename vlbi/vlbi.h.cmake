@@ -142,9 +142,76 @@ typedef struct {
 */
 typedef double(* vlbi_func2_t)(double, double);
 
+/**
+* \brief The block delegate function type to pass to vlbi_get_uv_plot_block
+*
+* Instead of being called once per element, this function receives whole chunks of the node streams,
+* so it can be vectorized and the call overhead gets paid once per chunk.
+*
+* \param inputs An array of count arrays, one for each node of the baseline, lowest index first
+* \param count The number of input arrays
+* \param output The array where to write the len results
+* \param len The number of elements of each array
+*/
+typedef void(* vlbi_func_block_t)(double **inputs, int count, double *output, int len);
+
 ///the OpenVLBI context object type
 typedef void* vlbi_context;
 
+///How vlbi_get_uv_plot accumulates the baselines into the UV plane
+typedef enum {
+///All threads write into the shared UV plane, serialized by a mutex
+    vlbi_accumulation_shared = 0,
+///Each thread accumulates into a private buffer, all buffers are reduced in parallel once the baselines are done
+    vlbi_accumulation_private = 1,
+} vlbi_accumulation_mode;
+
+///The convolution kernel used by vlbi_get_uv_plot to grid the samples into the UV plane
+typedef enum {
+///No convolution, each sample is accumulated into the nearest cell of the plane
+    vlbi_gridding_none = 0,
+///Kaiser-Bessel kernel
+    vlbi_gridding_kaiser_bessel = 1,
+///Prolate spheroidal wave function kernel, Schwab's rational approximation
+    vlbi_gridding_prolate_spheroidal = 2,
+} vlbi_gridding_kernel;
+
+///The density weighting of the samples gridded by vlbi_get_uv_plot
+typedef enum {
+///All samples weigh the same
+    vlbi_weighting_natural = 0,
+///Each sample is weighted by the inverse of the number of samples falling into its cell
+    vlbi_weighting_uniform = 1,
+///Briggs robust weighting, between uniform and natural weighting
+    vlbi_weighting_briggs = 2,
+} vlbi_weighting_mode;
+
+///The type of the raw samples of a memory mapped or packed node, in host byte order
+typedef enum {
+///Signed 8 bit integer samples
+    vlbi_sample_int8 = 0,
+///Signed 16 bit integer samples
+    vlbi_sample_int16 = 1,
+///32 bit floating point samples
+    vlbi_sample_float = 2,
+///1 bit samples, 8 per byte, unpacked by vlbi_block_unpack
+    vlbi_sample_packed1 = 3,
+///2 bit samples, 4 per byte, unpacked by vlbi_block_unpack
+    vlbi_sample_packed2 = 4,
+///4 bit samples, 2 per byte, unpacked by vlbi_block_unpack
+    vlbi_sample_packed4 = 5,
+///8 bit offset binary samples, unpacked by vlbi_block_unpack
+    vlbi_sample_packed8 = 6,
+} vlbi_sample_type;
+
+///The format of a recording read by vlbi_open_recording
+typedef enum {
+///VDIF, the VLBI Data Interchange Format, real samples of 1, 2, 4 or 8 bits
+    vlbi_recording_vdif = 0,
+///Mark5B, frames of 10000 bytes with 16 bytes headers
+    vlbi_recording_mark5b = 1,
+} vlbi_recording_format;
+
 ///Definition of the timespec_t in a C type, just for convenience
 typedef struct timespec timespec_t;
 /**\}*/
@@ -504,6 +571,7 @@ inline double vlbi_phase_correlator_delegate(double x, double y) {
 
 /**
 * \brief get/set the maximum number of threads allowed
+* The worker pool shared by all the OpenVLBI contexts is resized accordingly.
 * \param value if greater than 1, set a maximum number of threads allowed
 * \return The current or new number of threads allowed during runtime
 */
@@ -527,6 +595,60 @@ DLL_EXPORT vlbi_context vlbi_init(void);
 */
 DLL_EXPORT void vlbi_exit(vlbi_context ctx);
 
+/**
+* \brief Block delegate multiplying all the input arrays together, the vectorized default correlation.
+* \param inputs The input arrays
+* \param count The number of input arrays
+* \param output The products
+* \param len The number of elements of each array
+*/
+DLL_EXPORT void vlbi_block_product(double **inputs, int count, double *output, int len);
+
+/**
+* \brief Block delegate filling the output with ones, used to obtain the UV coverage of the baselines.
+* \param inputs The input arrays, unused
+* \param count The number of input arrays, unused
+* \param output The array to fill
+* \param len The number of elements of the output array
+*/
+DLL_EXPORT void vlbi_block_coverage(double **inputs, int count, double *output, int len);
+
+/**
+* \brief Block delegate multiplying the first input array by the complex conjugate of the second one.
+* The arrays are interleaved real and imaginary parts, like the complex_t type.
+* \param inputs The input arrays, only the first two are used
+* \param count The number of input arrays
+* \param output The complex products
+* \param len The number of doubles of each array, twice the number of complex values
+*/
+DLL_EXPORT void vlbi_block_complex_multiply_conjugate(double **inputs, int count, double *output, int len);
+
+/**
+* \brief Find the element with the largest absolute value of an array, with the runtime selected instruction set.
+* \param buf The array
+* \param len The number of elements of the array
+* \return The index of the first element with the largest absolute value, -1 if there is none
+*/
+DLL_EXPORT int vlbi_block_find_peak(double *buf, int len);
+
+/**
+* \brief Unpack quantized samples into doubles through lookup tables, a whole byte of samples at a time.
+* Samples are packed least significant bits first, 1 bit samples are -1 or +1, 2 bit samples are
+* -3.3359, -1, +1 or +3.3359 as in VDIF, 4 and 8 bit samples are offset binary, 8 and 128 are subtracted.
+* \param in The packed samples
+* \param bits The bits per sample, 1, 2, 4 or 8
+* \param first The index of the first sample to unpack
+* \param output The unpacked samples
+* \param len The number of samples to unpack
+*/
+DLL_EXPORT void vlbi_block_unpack(const unsigned char *in, int bits, long first, double *output, int len);
+
+/**
+* \brief Get the instruction set of the built-in block delegates, selected at runtime on the current CPU.
+* \return "avx512f", "avx2" or "generic"
+*/
+DLL_EXPORT const char *vlbi_block_kernels_isa(void);
+
 /**\}*/
 /**
  * \defgroup VLBI_Nodes Nodes API
@@ -542,6 +664,37 @@ DLL_EXPORT void vlbi_exit(vlbi_context ctx);
 */
 DLL_EXPORT void vlbi_add_node(vlbi_context ctx, dsp_stream_p Stream, const char *name, int geographic_coordinates);
 
+/**
+* \brief Add a node whose samples are memory mapped from a raw file, in their native type.
+* The samples are never copied into the node stream, they are converted in chunks by the correlator
+* when read, so nodes larger than the available memory can be correlated.
+* The node stream holds one sample only: the sample rate, start time, target, wavelength and
+* the first location of the passed stream describe the node.
+* Memory mapped nodes are read only, samples cannot be appended and their retention is ignored.
+* \param ctx The OpenVLBI context
+* \param Stream The OpenDSP stream carrying the metadata of the node
+* \param filename The raw samples file
+* \param offset The offset of the first sample into the file, in bytes
+* \param type The type of the samples
+* \param len The number of samples to map, 0 maps all the samples past offset
+* \param name A friendly name of this stream
+* \param geographic_coordinates Whether to use geographic coordinates
+*/
+DLL_EXPORT void vlbi_add_node_mmap(vlbi_context ctx, dsp_stream_p Stream, const char *filename, off_t offset, vlbi_sample_type type, long len, const char *name, int geographic_coordinates);
+
+/**
+* \brief Add a node keeping its samples in their native or packed type, 1 or 2 bit recordings take 32 to 64 times less memory than a stream.
+* The samples are copied as they are and converted in chunks by the correlator when read, like vlbi_add_node_mmap.
+* \param ctx The OpenVLBI context
+* \param Stream The OpenDSP stream carrying the metadata of the node
+* \param buf The samples
+* \param type The type of the samples
+* \param len The number of samples
+* \param name A friendly name of this stream
+* \param geographic_coordinates Whether to use geographic coordinates
+*/
+DLL_EXPORT void vlbi_add_node_packed(vlbi_context ctx, dsp_stream_p Stream, const void *buf, vlbi_sample_type type, long len, const char *name, int geographic_coordinates);
+
 /**
 * \brief Copy a node into a new one.
 * \param ctx The OpenVLBI context
@@ -551,7 +704,8 @@ DLL_EXPORT void vlbi_add_node(vlbi_context ctx, dsp_stream_p Stream, const char
 DLL_EXPORT void vlbi_copy_node(void *ctx, const char *name, const char *node);
 
 /**
-* \brief Get a stream from the current OpenVLBI context.
+* Memory mapped and packed nodes hold no samples into their stream, NULL is returned for them and for missing nodes.
+* Memory mapped and packed nodes hold no samples into their stream, NULL is returned for them.
 * \param ctx The OpenVLBI context
 * \param name The name of this stream
 * \return The OpenDSP stream representing this node
@@ -573,6 +727,28 @@ DLL_EXPORT int vlbi_has_node(void *ctx, const char *name);
 */
 DLL_EXPORT void vlbi_del_node(vlbi_context ctx, const char *name);
 
+/**
+* \brief Append samples to the stream of a node, without rebuilding the baselines.
+* The node stream grows by doubling its storage, so appending costs about the number of new samples.
+* Do not append while plotting from another thread.
+* \param ctx The OpenVLBI context
+* \param name The name of the node
+* \param buf The new samples
+* \param len The number of new samples
+* \param locations The location of the node at each new sample for moving baselines, or NULL to keep the last known location
+*/
+DLL_EXPORT void vlbi_append_node_samples(void *ctx, const char *name, dsp_t *buf, int len, dsp_location *locations);
+
+/**
+* \brief Bound the samples retained by a node, for long running captures fed by vlbi_append_node_samples.
+* Once the node holds half a window more than the retention, the oldest samples are dropped
+* and the start time of the node advances accordingly, so memory stays constant.
+* \param ctx The OpenVLBI context
+* \param name The name of the node
+* \param seconds The retention window in seconds, 0 retains all the samples
+*/
+DLL_EXPORT void vlbi_set_node_retention(void *ctx, const char *name, double seconds);
+
 /**
 * \brief List all nodes of the current OpenVLBI context.
 * \param ctx The OpenVLBI context
@@ -590,15 +766,95 @@ DLL_EXPORT int vlbi_get_nodes(void *ctx, vlbi_node** nodes);
 */
 DLL_EXPORT void vlbi_add_node_from_fits(void *ctx, char *filename, const char *name, int geo);
 
+/**
+* \brief Add a node from a 2d image fits file already loaded into memory.
+* \param ctx The OpenVLBI context
+* \param buf The memory buffer containing the fits file
+* \param len The size in bytes of the fits file
+* \param name The name of the newly created model
+* \param geo whether to consider the file coordinates as geographic or relative to the context station
+*/
+DLL_EXPORT void vlbi_add_node_from_fits_memory(void *ctx, void *buf, size_t len, const char *name, int geo);
+
 /**
 * \brief Add nodes from each row of a single dish fits -SDFITS- file.
+* The rows are read in batches, each node is named name_row with row counted from 0, or just name if the file has a single row.
+* The node stream has the shape of the DATA column, its TDIM axes or its repeat count, without the leading width and repeat dimensions of the older releases.
 * \param ctx The OpenVLBI context
 * \param filename The filename of the sdfits to read
-* \param name The name of the newly created model
+* \param name The name prefix of the newly created nodes
 * \param geo whether to consider the file coordinates as geographic or relative to the context station
 */
 DLL_EXPORT void vlbi_add_nodes_from_sdfits(void *ctx, char *filename, const char *name, int geo);
 
+/**
+* \brief Add nodes from each row of a single dish fits -SDFITS- file already loaded into memory.
+* The nodes are named and shaped as by vlbi_add_nodes_from_sdfits.
+* \param ctx The OpenVLBI context
+* \param buf The memory buffer containing the sdfits file
+* \param len The size in bytes of the sdfits file
+* \param name The name prefix of the newly created nodes
+* \param geo whether to consider the file coordinates as geographic or relative to the context station
+*/
+DLL_EXPORT void vlbi_add_nodes_from_sdfits_memory(void *ctx, void *buf, size_t len, const char *name, int geo);
+
+/**
+* \brief Open a VDIF or Mark5B recording, to be read into nodes by vlbi_read_recording.
+* The frame headers of the first two seconds are scanned for the frame rate, the threads and the channels.
+* Each thread and channel is read into its own node, named name_thread_channel, or just name
+* when the recording holds one thread of one channel.
+* \param ctx The OpenVLBI context
+* \param filename The file name of the recording
+* \param format The format of the recording
+* \param name The name of the nodes to create
+* \param location The location of the station, or NULL
+* \param geo Whether the location is geographic or relative to the context station
+* \param samplerate The sample rate of each channel, 0 infers it from the frame numbers of the first complete second
+* \param channels The number of channels of a Mark5B recording, VDIF recordings carry it into their headers
+* \param bits The bits per sample of a Mark5B recording, VDIF recordings carry it into their headers
+* \return The recording handle, NULL if the file could not be opened or is not supported
+*/
+DLL_EXPORT void *vlbi_open_recording(void *ctx, const char *filename, vlbi_recording_format format, const char *name, dsp_location *location, int geo, double samplerate, int channels, int bits);
+
+/**
+* \brief Read the next frames of a recording and append their samples to its nodes, the nodes are created by the first read.
+* Missing and invalid frames are replaced by zeros. A frame more than four seconds ahead of its thread is skipped
+* as corrupt, unless the next frame confirms the jump, then the gap is zero filled as well.
+* A partial frame at the end of the file is left to a later read, so a recording still being written can be followed.
+* \param recording The recording handle
+* \param seconds The time to read, 0 reads up to the end of the file
+* \return The number of samples appended to each node
+*/
+DLL_EXPORT long vlbi_read_recording(void *recording, double seconds);
+
+/**
+* \brief Get the number of missing or invalid frames found into a recording, replaced by zeros.
+* \param recording The recording handle
+* \return The number of missing frames read so far
+*/
+DLL_EXPORT long vlbi_get_recording_missing_frames(void *recording);
+
+/**
+* \brief Close a recording, its nodes are kept into the context.
+* \param recording The recording handle
+*/
+DLL_EXPORT void vlbi_close_recording(void *recording);
+
+/**
+* \brief Add the nodes of a whole VDIF or Mark5B recording, read in chunks of one second.
+* \param ctx The OpenVLBI context
+* \param filename The file name of the recording
+* \param format The format of the recording
+* \param name The name of the nodes to create
+* \param location The location of the station, or NULL
+* \param geo Whether the location is geographic or relative to the context station
+* \param samplerate The sample rate of each channel, 0 infers it from the frame numbers
+* \param channels The number of channels of a Mark5B recording
+* \param bits The bits per sample of a Mark5B recording
+* \return The number of nodes added
+*/
+DLL_EXPORT int vlbi_add_nodes_from_recording(void *ctx, const char *filename, vlbi_recording_format format, const char *name, dsp_location *location, int geo, double samplerate, int channels, int bits);
+
 /**
 * \brief Apply a low pass filter on the node buffer.
 * \param ctx The OpenVLBI context
@@ -703,6 +959,75 @@ DLL_EXPORT void vlbi_unlock_baseline(void *ctx, const char**nodes);
 */
 DLL_EXPORT void vlbi_set_baseline_stream(void *ctx, const char**nodes, dsp_stream_p stream);
 
+/**
+* \brief Correlate all the baselines in FX mode, filling their streams with a time x channel visibility matrix.
+* The streams of the nodes are channelized by FFT, each spectrum gets a fractional delay and fringe rotation from the delay model,
+* then it is multiplied by the conjugated spectrum of the other node and integrated.
+* The complex visibilities of each baseline are stored into dft.pairs of its stream, sized channels x integrations,
+* their magnitude into buf and into the magnitude and phase children streams. Each stream's samplerate is the integration rate.
+* \param ctx The OpenVLBI context
+* \param channels The number of spectral channels, the FFT size is twice this value
+* \param integration The accumulation period in seconds, rounded down to a multiple of the FFT size
+* \param target The target position int Ra/Dec/Dist celestial coordinates
+* \param freq The sky frequency of the first channel in Hz, used for fringe rotation. 0 applies only the fractional delay
+* \param nodelay if 1 no delay calculation should be done. streams entered are already synced.
+* \param interrupt If the value pointed by this parameter changes to 1, then abort the correlation.
+* \sa vlbi_get_baseline_stream
+*/
+DLL_EXPORT void vlbi_get_fx_correlation(void *ctx, int channels, double integration, double *target, double freq, int nodelay, int *interrupt);
+
+/**
+* \brief Correlate all the baselines in FX mode like vlbi_get_fx_correlation and stream the visibilities into a FITS-IDI file.
+* The ARRAY_GEOMETRY, SOURCE and FREQUENCY tables are written from the nodes and the target before correlating,
+* each baseline appends its UV_DATA rows in batches while it integrates, so the full table is never held in memory.
+* One row per baseline and integration with its uvw coordinates in seconds, sorted by time then baseline when the file is closed.
+* \param ctx The OpenVLBI context
+* \param filename The FITS-IDI file name, overwritten if existing
+* \param channels The number of spectral channels, the FFT size is twice this value
+* \param integration The accumulation period in seconds, rounded down to a multiple of the FFT size
+* \param target The target position int Ra/Dec/Dist celestial coordinates
+* \param freq The sky frequency of the first channel in Hz, the reference frequency of the file. Must be greater than 0
+* \param nodelay if 1 no delay calculation should be done. streams entered are already synced.
+* \param interrupt If the value pointed by this parameter changes to 1, then abort the correlation.
+* \return The number of UV_DATA rows written, -1 on error
+* \sa vlbi_get_fx_correlation
+*/
+DLL_EXPORT long vlbi_get_fx_correlation_to_fitsidi(void *ctx, const char *filename, int channels, double integration, double *target, double freq, int nodelay, int *interrupt);
+
+/**
+* \brief Search the fringes of the baselines correlated by vlbi_get_fx_correlation and correct the delay model.
+* The time x channel visibilities of each baseline are zero padded and transformed in two dimensions, the peak of the
+* delay x fringe rate plane is refined by parabolic interpolation. All baselines are searched in parallel.
+* The residual delay and delay rate of each node, referred to the first node, are then solved by least squares weighted
+* by the SNR of each baseline, and added to the delay model used by the next correlations. The visibility table is emptied.
+* \param ctx The OpenVLBI context
+* \param freq The sky frequency in Hz the correlation was done at, used to convert the fringe rate into a delay rate.
+* 0 solves for the delay only
+* \param oversampling The zero padding factor of each axis, 2 or more gives a finer peak
+* \param snr The minimum SNR for a baseline to be used by the station solution
+* \param interrupt If the value pointed by this parameter changes to 1, then abort the search, the delay model is left unchanged.
+* \return The number of baselines searched
+* \sa vlbi_get_fringe
+*/
+DLL_EXPORT int vlbi_fringe_search(void *ctx, double freq, int oversampling, double snr, int *interrupt);
+
+/**
+* \brief Obtain the fringe found on a baseline by vlbi_fringe_search.
+* \param ctx The OpenVLBI context
+* \param baseline The name of the baseline
+* \param delay The residual delay in seconds, of the first node relative to the second one
+* \param rate The residual delay rate in seconds per second
+* \param snr The peak of the fringe over the RMS of the delay x fringe rate plane
+* \return 1 if the baseline exists, any of the pointers can be NULL
+*/
+DLL_EXPORT int vlbi_get_fringe(void *ctx, const char *baseline, double *delay, double *rate, double *snr);
+
+/**
+* \brief Remove the residual delays added to the delay model by vlbi_fringe_search.
+* \param ctx The OpenVLBI context
+*/
+DLL_EXPORT void vlbi_clear_delay_residuals(void *ctx);
+
 /**
 * \brief Set the location of the reference station.
 * \param ctx The OpenVLBI context
@@ -714,6 +1039,7 @@ DLL_EXPORT void vlbi_set_location(void *ctx, double lat, double lon, double el);
 
 /**
 * \brief Get the offset of a single node to the farest node to the target.
+* This is the delay a plot without nodelay applies to the node, including the residuals found by fringe fitting.
 * \param ctx The OpenVLBI context
 * \param J2000Time The time of the calculation
 * \param node The name of the node
@@ -740,12 +1066,299 @@ DLL_EXPORT double vlbi_get_offset(vlbi_context ctx, double J2000Time, const char
 * \param freq The frequency observed. This parameter will scale the plot inverserly.
 * \param sr The sampling rate per second. This parameter will be used as meter for the elements of the streams.
 * \param nodelay if 1 no delay calculation should be done. streams entered are already synced.
+* If 0 each node is shifted by its geometric delay to the farthest station, as returned by vlbi_get_offset.
+* Up to release 3.0.4 no delay was applied in this case either, so plots made with nodelay 0 differ from those of earlier releases.
 * \param moving_baseline if 1 the location field of all the dsp_stream_p is an array of dsp_location for each element of the dsp_stream_p->buf array.
 * \param interrupt If the value pointed by this parameter changes to 1, then abort plotting.
 * \param delegate The delegate function to be executed on each node stream buffer element.
 */
 DLL_EXPORT void vlbi_get_uv_plot(void *ctx, const char *name, int u, int v, double *target, double freq, double sr, int nodelay, int moving_baseline, vlbi_func2_t delegate, int *interrupt);
 
+/**
+* \brief Fill a fourier plane like vlbi_get_uv_plot, passing the node streams to the delegate in chunks.
+* Samples falling outside the node streams correlate to zero.
+* \param ctx The OpenVLBI context
+* \param name The name of the new model
+* \param u The U size of the resulting UV plot
+* \param v The V size of the resulting UV plot
+* \param target The target position int Ra/Dec/Dist celestial coordinates
+* \param freq The frequency observed. This parameter will scale the plot inverserly.
+* \param sr The sampling rate per second. This parameter will be used as meter for the elements of the streams.
+* \param nodelay if 1 no delay calculation should be done. streams entered are already synced.
+* \param moving_baseline if 1 the location field of all the dsp_stream_p is an array of dsp_location for each element of the dsp_stream_p->buf array.
+* \param delegate The block delegate function, vlbi_block_product and vlbi_block_coverage are built in.
+* \param interrupt If the value pointed by this parameter changes to 1, then abort plotting.
+*/
+DLL_EXPORT void vlbi_get_uv_plot_block(void *ctx, const char *name, int u, int v, double *target, double freq, double sr, int nodelay, int moving_baseline, vlbi_func_block_t delegate, int *interrupt);
+
+/**
+* \brief Image a wide field with w-stacking, keeping the w term discarded by vlbi_get_uv_plot.
+* The samples of all baselines are binned by w into wplanes planes, each plane is gridded with the gridding
+* kernel and weighting of the context and Fourier transformed in parallel, then the planes are multiplied
+* by their phase screen and summed into the image. The image is centered on the middle pixel.
+* \param ctx The OpenVLBI context
+* \param name The name of the new image model
+* \param u The width of the resulting image
+* \param v The height of the resulting image
+* \param target The target position int Ra/Dec/Dist celestial coordinates
+* \param freq The frequency observed. This parameter will scale the plot inverserly.
+* \param sr The sampling rate per second. This parameter will be used as meter for the elements of the streams.
+* \param nodelay if 1 no delay calculation should be done. streams entered are already synced.
+* \param moving_baseline if 1 the location field of all the dsp_stream_p is an array of dsp_location for each element of the dsp_stream_p->buf array.
+* \param delegate The delegate function to be executed on each node stream buffer element.
+* \param wplanes The number of w-planes
+* \param interrupt If the value pointed by this parameter changes to 1, then abort imaging.
+*/
+DLL_EXPORT void vlbi_get_wstack_image(void *ctx, const char *name, int u, int v, double *target, double freq, double sr, int nodelay, int moving_baseline, vlbi_func2_t delegate, int wplanes, int *interrupt);
+
+/**
+* \brief Obtain the columns of the visibility table of the context.
+* A gridded plot or a w-stacked image fills the table once, with one row for each correlated sample, and the next
+* ones with the same plot size, target, frequency, sample rate, delegate, averaging, locations and baselines time span
+* grid it again without correlating. The columns are owned by the context and stay valid until the next plot that
+* correlates or until vlbi_clear_visibilities. Flags can be changed in place, flagged rows are not gridded.
+* \param ctx The OpenVLBI context
+* \param times The time column, in seconds since the epoch
+* \param baseline The baseline column, the names are returned by vlbi_get_visibility_baseline
+* \param u The u column, in cells of the UV plane from its center
+* \param v The v column, in cells of the UV plane from its center
+* \param w The w column, in cells of the UV plane
+* \param visibility The complex visibility column
+* \param weight The weight column
+* \param flags The flags column, nonzero for flagged rows
+* \return The number of rows of the table, any of the column pointers can be NULL
+*/
+DLL_EXPORT int vlbi_get_visibilities(void *ctx, double **times, int **baseline, double **u, double **v, double **w, complex_t **visibility, double **weight, unsigned char **flags);
+
+/**
+* \brief Obtain the name of a baseline of the visibility table.
+* \param ctx The OpenVLBI context
+* \param id The baseline id, as found into the baseline column
+* \return The name of the baseline, NULL if the id is not into the table
+*/
+DLL_EXPORT const char *vlbi_get_visibility_baseline(void *ctx, int id);
+
+/**
+* \brief Empty the visibility table, the next gridded plot correlates again.
+* \param ctx The OpenVLBI context
+*/
+DLL_EXPORT void vlbi_clear_visibilities(void *ctx);
+
+/**
+* \brief Predict the visibilities of a model image at each row of the visibility table.
+* The model is corrected for the taper of the gridding kernel of the context and Fourier transformed once,
+* then each row is interpolated from the transform with the same kernel, all rows in parallel.
+* The model is centered on its middle pixel, like the images of vlbi_get_wstack_image, and the w term is not applied.
+* Subtracting the prediction from the visibility column in place removes the model from the next gridded plots.
+* \param ctx The OpenVLBI context
+* \param model The name of the model image
+* \param prediction The predicted visibilities, one for each row of the table, owned by the context
+* \return The number of rows predicted, 0 if there is no such model or the table is empty
+*/
+DLL_EXPORT int vlbi_predict_visibilities(void *ctx, const char *model, complex_t **prediction);
+
+/**
+* \brief Deconvolve an image with the Högbom CLEAN algorithm.
+* At each iteration the peak of the residual is found and the PSF, scaled by the gain and centered on the peak,
+* is subtracted from the residual within a window. Both the peak search and the subtraction run on the thread pool.
+* The PSF is obtained from the inverse Fourier transform of a plot made with a coverage delegate.
+* \param ctx The OpenVLBI context
+* \param name The name of the model where to store the CLEAN components
+* \param residual The name of the model where to store the residual image
+* \param dirty The name of the dirty image model
+* \param psf The name of the PSF model, its peak is taken as its center
+* \param gain The loop gain, usually 0.1
+* \param threshold Stop when the absolute peak of the residual falls below this value
+* \param iterations The maximum number of components
+* \param window The half size of the subtracted portion of the PSF, 0 subtracts the whole PSF
+* \param interrupt If the value pointed by this parameter changes to 1, then stop cleaning.
+* \return The number of components found
+*/
+DLL_EXPORT int vlbi_clean_hogbom(void *ctx, const char *name, const char *residual, const char *dirty, const char *psf, double gain, double threshold, int iterations, int window, int *interrupt);
+
+/**
+* \brief Deconvolve the visibility table with the Cotton-Schwab CLEAN algorithm.
+* Each major cycle images the residual visibilities with the gridder of the context, CLEANs the residual image
+* with the Högbom algorithm until its peak falls to a tenth of its starting value, then subtracts the visibilities
+* predicted from all the components found so far. The PSF is the image of the table with all visibilities set to 1.
+* Only the inner half of the images on each axis is cleaned, as the gridding correction amplifies aliasing toward the edges.
+* The table must have been filled by a gridded plot, a gridding kernel makes the prediction accurate.
+* \param ctx The OpenVLBI context
+* \param name The name of the model where to store the CLEAN components
+* \param residual The name of the model where to store the residual image
+* \param u The width of the images
+* \param v The height of the images
+* \param gain The loop gain, usually 0.1
+* \param threshold Stop when the absolute peak of the residual falls below this value
+* \param iterations The maximum number of components
+* \param cycles The maximum number of major cycles
+* \param window The half size of the subtracted portion of the PSF, 0 subtracts the whole PSF
+* \param interrupt If the value pointed by this parameter changes to 1, then stop cleaning.
+* \return The number of components found
+*/
+DLL_EXPORT int vlbi_clean_cotton_schwab(void *ctx, const char *name, const char *residual, int u, int v, double gain, double threshold, int iterations, int cycles, int window, int *interrupt);
+
+/**
+* \brief Solve the complex gain of each station of the visibility table.
+* The rows are split into solution intervals and the gains of each interval are solved with the StEFCal
+* iterative least squares algorithm, so that each visibility equals the gain of its first node times the
+* conjugate gain of its second node times the visibility predicted by vlbi_predict_visibilities, or 1 when
+* no model was predicted. The phase of the first station is the reference. The intervals are solved in parallel.
+* Only baselines of correlation order 2 are calibrated.
+* \param ctx The OpenVLBI context
+* \param interval The length of each solution interval in seconds, 0 solves a single interval
+* \param iterations The maximum number of iterations for each interval
+* \param tolerance The relative change of the gains under which an interval is converged
+* \return The number of solution intervals
+*/
+DLL_EXPORT int vlbi_solve_gains(void *ctx, double interval, int iterations, double tolerance);
+
+/**
+* \brief Obtain the gains last solved by vlbi_solve_gains.
+* The arrays are owned by the context and stay valid until the visibility table is emptied.
+* \param ctx The OpenVLBI context
+* \param times The start time of each solution interval, in seconds since the epoch
+* \param gains The complex gains, stations of the same interval are contiguous
+* \param stations The number of stations of each interval, their names are returned by vlbi_get_gain_station
+* \return The number of solution intervals, any of the pointers can be NULL
+*/
+DLL_EXPORT int vlbi_get_gains(void *ctx, double **times, complex_t **gains, int *stations);
+
+/**
+* \brief Obtain the name of a station of the gain solutions.
+* \param ctx The OpenVLBI context
+* \param id The station index into each solution interval
+* \return The name of the node, NULL if the index is not valid
+*/
+DLL_EXPORT const char *vlbi_get_gain_station(void *ctx, int id);
+
+/**
+* \brief Divide each visibility of the table by the gains of its nodes.
+* The visibilities are calibrated in place, so the next gridded plots with the same parameters image the calibrated table.
+* \param ctx The OpenVLBI context
+*/
+DLL_EXPORT void vlbi_apply_gains(void *ctx);
+
+/**
+* \brief Compute the closure phases and the closure amplitudes of the visibility table.
+* The visibilities of each order-2 baseline are vector averaged into snapshots, then all the triangles and
+* quadrangles of stations whose baselines are into the table get closed together, in parallel.
+* Only the snapshots holding unflagged visibilities are returned, snapshots where a baseline has no unflagged
+* visibility give NaN closures.
+* \param ctx The OpenVLBI context
+* \param interval The length of each snapshot in seconds, 0 uses the integration time of the table, the inverse of the
+* sample rate of the plot that filled it
+* \param times The center time of each snapshot, in seconds since the epoch
+* \return The number of snapshots
+*/
+DLL_EXPORT int vlbi_get_closures(void *ctx, double interval, double **times);
+
+/**
+* \brief Obtain the closure phases computed by vlbi_get_closures.
+* The phase of triangle i, j, k is the phase of V(i,j) V(j,k) V(k,i) in radians, wrapped to [-PI, PI).
+* The arrays are owned by the context and stay valid until the next call to vlbi_get_closures.
+* \param ctx The OpenVLBI context
+* \param triangles Three station indexes for each triangle, the names are returned by vlbi_get_gain_station
+* \param phases The closure phases, the snapshots of the same triangle are contiguous
+* \return The number of triangles, any of the pointers can be NULL
+*/
+DLL_EXPORT int vlbi_get_closure_phases(void *ctx, int **triangles, double **phases);
+
+/**
+* \brief Obtain the closure amplitudes computed by vlbi_get_closures.
+* The amplitude of quadrangle a, b, c, d is |V(a,b)| |V(c,d)| / (|V(a,c)| |V(b,d)|), two independent quadrangles
+* are returned for each set of four stations.
+* The arrays are owned by the context and stay valid until the next call to vlbi_get_closures.
+* \param ctx The OpenVLBI context
+* \param quadrangles Four station indexes for each quadrangle, the names are returned by vlbi_get_gain_station
+* \param amplitudes The closure amplitudes, the snapshots of the same quadrangle are contiguous
+* \return The number of quadrangles, any of the pointers can be NULL
+*/
+DLL_EXPORT int vlbi_get_closure_amplitudes(void *ctx, int **quadrangles, double **amplitudes);
+
+/**
+* \brief Set how vlbi_get_uv_plot accumulates the baselines into the UV plane.
+* With vlbi_accumulation_private no lock is taken while plotting, and the resulting plane
+* is the same one that a single threaded vlbi_accumulation_shared plot would produce.
+* \param ctx The OpenVLBI context
+* \param mode The accumulation mode
+*/
+DLL_EXPORT void vlbi_set_accumulation_mode(void *ctx, vlbi_accumulation_mode mode);
+
+/**
+* \brief Split the time range of each baseline into chunks plotted as separate jobs by vlbi_get_uv_plot.
+* Long baselines get spread across the threads of the pool, the sampling step of the plot restarts at each chunk.
+* \param ctx The OpenVLBI context
+* \param seconds The duration of each chunk in seconds, 0 plots each baseline as a single job
+*/
+DLL_EXPORT void vlbi_set_plot_chunk_size(void *ctx, double seconds);
+
+/**
+* \brief Make vlbi_get_uv_plot and vlbi_get_uv_plot_block resume the existing model with the same name.
+* The context remembers up to which time each baseline has been plotted, and accumulates into the model only
+* the samples arrived since then, when the plot parameters didn't change. Any other call plots from scratch.
+* The new samples of each baseline are stacked over the existing plane, baseline after baseline.
+* \param ctx The OpenVLBI context
+* \param incremental 1 to enable the incremental plotting, 0 to plot the whole observation each time
+*/
+DLL_EXPORT void vlbi_set_plot_incremental(void *ctx, int incremental);
+
+/**
+* \brief Make vlbi_get_uv_plot and vlbi_get_uv_plot_block convolve each sample into the UV plane.
+* Each sample is gridded at its exact UV position with an oversampled kernel read from a lookup table,
+* the plane is split into tiles gridded in parallel, and is normalized by the sum of the weights.
+* Incremental plotting applies only to plots without gridding kernel.
+* \param ctx The OpenVLBI context
+* \param kernel The gridding kernel, vlbi_gridding_none restores the nearest cell accumulation
+* \param support The width of the kernel in cells, 6 if less than 1
+* \param oversampling The number of lookup table entries per cell, 128 if less than 1
+*/
+DLL_EXPORT void vlbi_set_plot_gridding(void *ctx, vlbi_gridding_kernel kernel, int support, int oversampling);
+
+/**
+* \brief Average consecutive samples of each baseline before they get gridded.
+* The number of samples of each bin is chosen from the baseline length, so that the UV track moves
+* by at most 0.2 / fov cells across a bin, keeping the smearing within a tenth of a turn at the edge of the field.
+* Each bin is correlated and emitted as a single sample at its mean time. Averaging applies only to gridded plots
+* and to vlbi_get_wstack_image, and never to moving baselines.
+* \param ctx The OpenVLBI context
+* \param fov The field of view to keep free of smearing, as a fraction of the image width, 0 disables averaging
+*/
+DLL_EXPORT void vlbi_set_plot_averaging(void *ctx, double fov);
+
+/**
+* \brief Plot many sub-bands at once with multi-frequency synthesis.
+* The geometry and the correlation of each sample are computed once at the highest sub-band frequency,
+* then the sample is gridded once for each sub-band with u, v and w scaled by the ratio of the frequencies.
+* While sub-bands are set, the freq parameter of the plotting functions is ignored and the plots are always gridded,
+* with the kernel set by vlbi_set_plot_gridding, so a single pass over the node streams fills all the sub-bands.
+* \param ctx The OpenVLBI context
+* \param freqs The frequency of each sub-band in Hz
+* \param count The number of sub-bands, 0 restores the single frequency plots
+* \param cube If 1 each sub-band is also gridded into a model of its own, named after the plot and the index of the sub-band,
+* as name_0, name_1 and so on
+*/
+DLL_EXPORT void vlbi_set_plot_subbands(void *ctx, double *freqs, int count, int cube);
+
+/**
+* \brief Set the density weighting of the samples gridded by vlbi_get_uv_plot.
+* \param ctx The OpenVLBI context
+* \param mode The weighting mode
+* \param robust The Briggs robustness, from -2 (close to uniform) to 2 (close to natural)
+*/
+DLL_EXPORT void vlbi_set_plot_weighting(void *ctx, vlbi_weighting_mode mode, double robust);
+
+/**
+* \brief Create a model with the gridding correction of the current gridding kernel.
+* Multiply the image obtained from a gridded UV plot with this model, using vlbi_apply_mask,
+* to remove the taper of the gridding kernel. The correction is centered on the middle pixel.
+* \param ctx The OpenVLBI context
+* \param name The name of the new model
+* \param u The width of the image
+* \param v The height of the image
+*/
+DLL_EXPORT void vlbi_get_grid_correction(void *ctx, const char *name, int u, int v);
+
 /**
 * \brief Add a model into the current OpenVLBI context.
 * \param ctx The OpenVLBI context
@@ -886,6 +1499,15 @@ DLL_EXPORT void vlbi_add_model_from_jpeg(void *ctx, char *filename, const char *
 */
 DLL_EXPORT void vlbi_add_model_from_fits(void *ctx, char *filename, const char *name);
 
+/**
+* \brief Add a model from a fits file already loaded into memory.
+* \param ctx The OpenVLBI context
+* \param buf The memory buffer containing the fits file
+* \param len The size in bytes of the fits file
+* \param name The name of the newly created model.
+*/
+DLL_EXPORT void vlbi_add_model_from_fits_memory(void *ctx, void *buf, size_t len, const char *name);
+
 /**
 * \brief Write a model to a png file.
 * \param ctx The OpenVLBI context
@@ -1232,6 +1854,14 @@ DLL_EXPORT double vlbi_astro_redshift_adjust(double distance, double redshift);
  */
 DLL_EXPORT dsp_stream_p vlbi_file_read_fits(char *filename);
 
+/**
+ * \brief Read a FITS file already loaded into memory, without going through the filesystem
+ * \param buf The memory buffer containing the FITS file, not modified nor freed
+ * \param len The size in bytes of the FITS file
+ * \return A pointer to a dsp_stream filled with the needed data contained into the FITS file
+ */
+DLL_EXPORT dsp_stream_p vlbi_file_read_fits_memory(void *buf, size_t len);
+
 /**
  * \brief Returns the distance of a far object adjusted with its measured redshift
  * \param filename The file name of the FITS file to open
@@ -1240,6 +1870,41 @@ DLL_EXPORT dsp_stream_p vlbi_file_read_fits(char *filename);
  */
 DLL_EXPORT dsp_stream_p *vlbi_file_read_sdfits(char * filename, long *n);
 
+/**
+ * \brief Open an SDFITS file for reading its rows in batches with vlbi_file_read_sdfits_rows
+ * The columns are looked up once, the DATA column shape is taken from its TDIM keyword or its repeat count,
+* and each row stream gets exactly these dimensions.
+ * \param filename The file name of the SDFITS file to open
+ * \param n the number of rows of the SINGLE DISH table
+ * \return The SDFITS reader, NULL on failure
+ */
+DLL_EXPORT void *vlbi_file_open_sdfits(char *filename, long *n);
+
+/**
+ * \brief Open an SDFITS file already loaded into memory like vlbi_file_open_sdfits
+ * \param buf The memory buffer containing the SDFITS file, it must stay valid until vlbi_file_close_sdfits
+ * \param len The size in bytes of the SDFITS file
+ * \param n the number of rows of the SINGLE DISH table
+ * \return The SDFITS reader, NULL on failure
+ */
+DLL_EXPORT void *vlbi_file_open_sdfits_memory(void *buf, size_t len, long *n);
+
+/**
+ * \brief Read the next batch of rows of an SDFITS file
+ * Each column is read for the whole batch in one call, then the rows are decoded in parallel into new dsp_stream structs.
+ * \param sdfits The reader returned by vlbi_file_open_sdfits
+ * \param max the maximum number of rows to read
+ * \param n the number of rows read, 0 at the end of the table
+ * \return A pointer array to the dsp_stream structs of the rows read, to be freed by the caller
+ */
+DLL_EXPORT dsp_stream_p *vlbi_file_read_sdfits_rows(void *sdfits, long max, long *n);
+
+/**
+ * \brief Close an SDFITS file opened with vlbi_file_open_sdfits
+ * \param sdfits The reader returned by vlbi_file_open_sdfits
+ */
+DLL_EXPORT void vlbi_file_close_sdfits(void *sdfits);
+
 /**\}*/
 /**\defgroup Server*/
 /**\defgroup DSP*/
@@ -78,41 +78,25 @@ static double default_delegate(double x, double y)
 
 void VLBI::Server::addNode(const char *name, char *b64)
 {
-    char filename[128];
-    strcpy(filename, tmpdir);
-    strcat(filename, "/tmp_nodeXXXXXX");
-    int fd = mkstemp(filename);
-    if(fd > -1)
+    size_t b64len = strlen(b64);
+    if(b64len > 0)
     {
-        size_t b64len = strlen(b64);
         char* buf = (char*)malloc(b64len * 3 / 4 + 4);
         size_t len = (size_t)from64tobits_fast(buf, b64, (int)b64len);
-        ssize_t written = write(fd, buf, len);
-        (void)written;
+        vlbi_add_node_from_fits_memory(getContext(), buf, len, name, true);
         free(buf);
-        close(fd);
-        vlbi_add_node_from_fits(getContext(), filename, name, true);
-        unlink(filename);
     }
 }
 
 void VLBI::Server::addNodes(const char *name, char *b64)
 {
-    char filename[128];
-    strcpy(filename, tmpdir);
-    strcat(filename, "/tmp_nodeXXXXXX");
-    int fd = mkstemp(filename);
-    if(fd > -1)
+    size_t b64len = strlen(b64);
+    if(b64len > 0)
     {
-        size_t b64len = strlen(b64);
         char* buf = (char*)malloc(b64len * 3 / 4 + 4);
         size_t len = (size_t)from64tobits_fast(buf, b64, (int)b64len);
-        ssize_t written = write(fd, buf, len);
-        (void)written;
+        vlbi_add_nodes_from_sdfits_memory(getContext(), buf, len, name, true);
         free(buf);
-        close(fd);
-        vlbi_add_nodes_from_sdfits(getContext(), filename, name, true);
-        unlink(filename);
     }
 }
 
@@ -158,8 +142,13 @@ void VLBI::Server::delNode(const char *name)
 void VLBI::Server::Plot(const char *name, int flags)
 {
     double coords[3] = { Ra, Dec, DBL_MAX };
+    vlbi_set_plot_incremental(getContext(), (flags & plot_flags_incremental) != 0);
     if((flags & plot_flags_custom_delegate) == 0) {
         setDelegate((flags & plot_flags_uv_coverage) != 0 ? coverage_delegate : default_delegate);
+        vlbi_get_uv_plot_block(getContext(), name, w, h, coords, Freq, SampleRate, (flags & plot_flags_synced) != 0,
+                               (flags & plot_flags_moving_baseline) != 0,
+                               (flags & plot_flags_uv_coverage) != 0 ? vlbi_block_coverage : vlbi_block_product, nullptr);
+        return;
     }
     vlbi_get_uv_plot(getContext(), name, w, h, coords, Freq, SampleRate, (flags & plot_flags_synced) != 0,
                      (flags & plot_flags_moving_baseline) != 0,
@@ -251,21 +240,31 @@ char* VLBI::Server::getModel(const char *name, char *format)
     ssize_t outlen = 0;
     unsigned char *buf = nullptr;
     unsigned char *b64 = nullptr;
-    strcpy(filename, tmpdir);
-    strcat(filename, "/tmp_modelXXXXXX");
-    fd = mkstemp(filename);
     dsp_stream_p model = vlbi_get_model(getContext(), name);
     dsp_stream_p *stream = (dsp_stream_p*)malloc(sizeof(dsp_stream_p) * (size_t)(channels + 1));
     for(int c = 0; c <= channels; c++)
         stream[c] = dsp_stream_copy(model);
+    if(!strcmp(format, "fits"))
+    {
+        size_t size = 0;
+        buf = (unsigned char*)dsp_file_write_fits_composite_memory(channels, 16, stream, &size);
+        if(buf == nullptr)
+            return nullptr;
+        outlen = (ssize_t)(size * 4 / 3 + 4);
+        b64 = (unsigned char*)malloc((size_t)outlen);
+        to64frombits(b64, buf, (int)size);
+        free(buf);
+        return (char*)b64;
+    }
+    strcpy(filename, tmpdir);
+    strcat(filename, "/tmp_modelXXXXXX");
+    fd = mkstemp(filename);
     if(fd > -1)
     {
         if(!strcmp(format, "jpeg"))
             dsp_file_write_jpeg_composite(filename, channels, 100, stream);
         if(!strcmp(format, "png"))
             dsp_file_write_png_composite(filename, channels, 9, stream);
-        if(!strcmp(format, "fits"))
-            dsp_file_write_fits_composite(filename, channels, 16, stream);
         FILE* f = fdopen(fd, "rb+");
         fseek(f, 0, SEEK_END);
         len = ftell(f);
@@ -312,12 +311,20 @@ void VLBI::Server::addModel(const char *name, char *format, char *b64)
     int fd = -1;
     size_t b64len = 0;
     char *buf = nullptr;
-    strcpy(filename, tmpdir);
-    strcat(filename, "/tmp_modelXXXXXX");
-    fd = mkstemp(filename);
     b64len = strlen(b64);
     if(b64len > 0)
     {
+        if(!strcmp(format, "fits"))
+        {
+            buf = (char*)malloc(b64len * 3 / 4 + 4);
+            size_t len = (size_t)from64tobits_fast(buf, b64, (int)b64len);
+            vlbi_add_model_from_fits_memory(getContext(), buf, len, name);
+            free(buf);
+            return;
+        }
+        strcpy(filename, tmpdir);
+        strcat(filename, "/tmp_modelXXXXXX");
+        fd = mkstemp(filename);
         if(fd > -1)
         {
             buf = (char*)malloc(b64len * 3 / 4 + 4);
@@ -326,10 +333,6 @@ void VLBI::Server::addModel(const char *name, char *format, char *b64)
             (void)written;
             free(buf);
             close(fd);
-            if(!strcmp(format, "fits"))
-            {
-                vlbi_add_model_from_fits(getContext(), filename, name);
-            }
             if(!strcmp(format, "jpeg"))
             {
                 vlbi_add_model_from_jpeg(getContext(), filename, name);
@@ -593,6 +596,11 @@ void VLBI::Server::Parse()
                 {
                     return;
                 }
+                t = strtok(nullptr, ",");
+                if(t != nullptr && !strcmp(t, "incremental"))
+                {
+                    flags |= plot_flags_incremental;
+                }
                 Plot(name, flags);
             }
             else if(!strcmp(arg, "idft"))
@@ -57,6 +57,8 @@ typedef enum
     plot_flags_synced = 4,
     ///This will use a custom visibility delegate
     plot_flags_custom_delegate = 8,
+    ///This will accumulate only the samples arrived since the last plot with the same name
+    plot_flags_incremental = 16,
 } vlbi_plot_flags;
 
 /**
@@ -169,7 +171,9 @@ class Server
 
         /**
         * \brief Create as many nodes as the rows number of an SDFITS file, give it a name and add it to the current context.
-        * \param name The name of the new node
+        * Each node is named name_row with row counted from 0, or just name if the file has a single row,
+        * and its stream has the shape of the DATA column, see vlbi_add_nodes_from_sdfits.
+        * \param name The name prefix of the new nodes
         * \param b64 The file buffer base64 encoded
         */
         void addNodes(const char *name, char *b64);
@@ -4,6 +4,7 @@ INDIServer::INDIServer()
     : INDI::BaseClient()
     , VLBI::Server::Server()
 {
+    pthread_mutex_init(&BlobsMutex, NULL);
 }
 
 int INDIServer::Init(int argc, char** argv)
@@ -26,6 +27,12 @@ int INDIServer::Init(int argc, char** argv)
 INDIServer::~INDIServer()
 {
     disconnectServer();
+    for(blob &b : Blobs)
+    {
+        dsp_stream_free_buffer(b.stream);
+        dsp_stream_free(b.stream);
+    }
+    pthread_mutex_destroy(&BlobsMutex);
 }
 
 void INDIServer::SetCapture(double seconds)
@@ -267,15 +274,18 @@ void INDIServer::newBLOB(IBLOB *bp)
         return;
     if(!strcmp(bp->name, "DATA"))
     {
-        if(GetContext() != NULL)
+        if(getContext() != NULL)
         {
             std::string nodename = "";
             nodename.append(bp->bvp->device);
             nodename.append("_");
             nodename.append(bp->name);
-            nodename.append("_");
-            nodename.append(bp->bvp->timestamp);
-            AddNode((char*)nodename.c_str(), (char*)bp->blob);
+            dsp_stream_p stream = vlbi_file_read_fits_memory(bp->blob, (size_t)bp->bloblen);
+            if(stream == NULL)
+                return;
+            pthread_mutex_lock(&BlobsMutex);
+            Blobs.push_back({ getContext(), nodename, stream });
+            pthread_mutex_unlock(&BlobsMutex);
         }
         else
         {
@@ -285,6 +295,55 @@ void INDIServer::newBLOB(IBLOB *bp)
     INDI_UNUSED(bp);
 }
 
+void INDIServer::AddBlobs()
+{
+    std::vector<blob> blobs;
+    pthread_mutex_lock(&BlobsMutex);
+    blobs.swap(Blobs);
+    pthread_mutex_unlock(&BlobsMutex);
+    for(blob &b : blobs)
+    {
+        dsp_stream_p stream = b.stream;
+        const char *name = b.name.c_str();
+        if(!vlbi_has_node(b.context, name))
+        {
+            vlbi_add_node(b.context, stream, name, true);
+            continue;
+        }
+        dsp_stream_p node = vlbi_get_node(b.context, name);
+        double sr = stream->samplerate;
+        long gap = 0;
+        if(node == NULL || sr <= 0.0 || sr != node->samplerate)
+        {
+            pwarn("%s: BLOB sampled at %lf Hz, the node at %lf Hz, discarded\n", name, sr, node != NULL ? node->samplerate : 0.0);
+        }
+        else if((gap = (long)round((vlbi_time_timespec_to_J2000time(stream->starttimeutc) -
+                                    vlbi_time_timespec_to_J2000time(node->starttimeutc)) * sr) - node->len) < 0)
+        {
+            pwarn("%s: BLOB overlaps the node by %ld samples, discarded\n", name, -gap);
+        }
+        else if(gap > (long)Min(max_gap_seconds * sr, (double)INT_MAX))
+        {
+            pwarn("%s: %ld samples missing, the node restarts from this BLOB\n", name, gap);
+            vlbi_del_node(b.context, name);
+            vlbi_add_node(b.context, stream, name, true);
+            continue;
+        }
+        else
+        {
+            if(gap > 0)
+            {
+                pwarn("%s: %ld samples missing, zero padded\n", name, gap);
+                std::vector<dsp_t> zeros((size_t)gap, 0.0);
+                vlbi_append_node_samples(b.context, name, zeros.data(), (int)gap, NULL);
+            }
+            vlbi_append_node_samples(b.context, name, stream->buf, stream->len, NULL);
+        }
+        dsp_stream_free_buffer(stream);
+        dsp_stream_free(stream);
+    }
+}
+
 void INDIServer::newSwitch(ISwitchVectorProperty *svp)
 {
     if(!isServerConnected())
@@ -368,6 +427,7 @@ void INDIServer::Parse()
     char *value = nullptr;
     char *str = nullptr;
     ssize_t nchars = getdelim(&str, &len, (int)'\n', f);
+    AddBlobs();
     if(nchars < 0)
         return;
     *strrchr(str, '\n') = 0;
@@ -468,6 +528,7 @@ void INDIServer::Parse()
                 AbortExposure();
         }
     }
+    AddBlobs();
     VLBI::Server::Parse();
 }
 
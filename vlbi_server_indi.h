@@ -29,6 +29,10 @@
 #include <inditelescope.h>
 #include <baseclient.h>
 #include <fitsio.h>
+#include <climits>
+#include <pthread.h>
+#include <string>
+#include <vector>
 
 using namespace VLBI;
 
@@ -73,6 +77,20 @@ class INDIServer : private INDI::BaseClient, public VLBI::Server
         void Parse() override;
 
     private:
+        /**
+        * A BLOB decoded by the INDI client thread, appended to its node by the thread calling Parse().
+        */
+        struct blob
+        {
+            vlbi_context context;
+            std::string name;
+            dsp_stream_p stream;
+        };
+        void AddBlobs();
+        ///Longer gaps between the BLOBs of a device restart its node instead of being zero padded
+        const double max_gap_seconds { 60.0 };
+        pthread_mutex_t BlobsMutex;
+        std::vector<blob> Blobs;
         double Gain;
         char* Address;
         char* Savedir;
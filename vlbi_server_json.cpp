@@ -311,6 +311,14 @@ void JSONServer::Parse()
                     }
                     mask |= 1 << 7;
                 }
+                if(!strcmp(values[y].name, "incremental"))
+                {
+                    flags &= ~plot_flags_incremental;
+                    if(!strcmp(values[y].value->u.string.ptr, "true"))
+                        flags |= plot_flags_incremental;
+                    if(!strcmp(values[y].value->u.string.ptr, "1"))
+                        flags |= plot_flags_incremental;
+                }
                 if(!strcmp(values[y].name, "adjust_delays"))
                 {
                     flags |= plot_flags_synced;